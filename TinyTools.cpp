@@ -31,8 +31,31 @@
 #include <unistd.h>
 #include <dirent.h>
 #include <poll.h>
+#include <sys/epoll.h>
+#include <limits.h>
+#include <sys/uio.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+#include <sys/sendfile.h>
+#include <termios.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <ifaddrs.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/neighbour.h>
+#include <net/if_arp.h>
+#include <linux/futex.h>
+#include <linux/membarrier.h>
+#include <sys/mman.h>
+#include <sched.h>
+#include <sys/syscall.h>
 
 #include <vector>
+#include <deque>
+#include <algorithm>
+#include <iterator>
 #include <string>
 #include <map>
 #include <functional>
@@ -44,6 +67,13 @@
 #include <chrono>
 #include <thread>
 #include <condition_variable>
+#include <atomic>
+#include <mutex>
+
+#if defined(__x86_64__) || defined(__i386__)
+	#define TINYTOOLS_X86_SIMD
+	#include <immintrin.h>
+#endif
 
 #include "TinyTools.h"
 
@@ -263,28 +293,147 @@ std::string GetHostName()
 	return std::string(buf);
 }
 
-std::string GetNameFromIPv4(const std::string& pAddress)
+/**
+ * @brief The text of each octet value, up to three digits with the length in the last byte.
+ * Always copying three chars and then moving on by the length means there is no branching on how big the value is.
+ */
+struct IPv4OctetTable
 {
-    sockaddr_in deviceIP;
-	memset(&deviceIP, 0, sizeof deviceIP);
+	char mChars[256][4];
 
-	const int ret = inet_pton(AF_INET,pAddress.c_str(),&deviceIP.sin_addr);
-	 if (ret <= 0)
-	 {
-		if (ret == 0)
-			return "Not in presentation format";
-		return "inet_pton failed";
+	constexpr IPv4OctetTable():mChars()
+	{
+		for( int n = 0 ; n < 256 ; n++ )
+		{
+			int length = 0;
+			if( n >= 100 )
+			{
+				mChars[n][length++] = char('0' + n / 100);
+			}
+			if( n >= 10 )
+			{
+				mChars[n][length++] = char('0' + (n / 10) % 10);
+			}
+			mChars[n][length++] = char('0' + n % 10);
+			mChars[n][3] = char(length);
+		}
 	}
+};
 
-	deviceIP.sin_family = AF_INET;
+static constexpr IPv4OctetTable IPV4_OCTETS;
 
-	char hbuf[NI_MAXHOST];
-	hbuf[0] = 0;
+/**
+ * @brief The value of each decimal digit character, 0xff if it's not one.
+ */
+struct DecimalDigitTable
+{
+	uint8_t mValue[256];
+
+	constexpr DecimalDigitTable():mValue()
+	{
+		for( int n = 0 ; n < 256 ; n++ )
+		{
+			mValue[n] = 0xff;
+		}
+		for( int n = 0 ; n < 10 ; n++ )
+		{
+			mValue['0' + n] = (uint8_t)n;
+		}
+	}
+};
 
+static constexpr DecimalDigitTable DECIMAL_DIGITS;
 
-	getnameinfo((struct sockaddr*)&deviceIP,sizeof(deviceIP),hbuf, sizeof(hbuf), NULL,0, NI_NAMEREQD);
-	const std::string name = hbuf;
-	return name;
+char* IPv4ToChars(uint32_t pIPv4,char* rBuffer)
+{
+	// Network byte order, so the first octet is the low byte.
+	for( int n = 0 ; n < 3 ; n++, pIPv4 >>= 8 )
+	{
+		const char* octet = IPV4_OCTETS.mChars[pIPv4 & 0xff];
+		memcpy(rBuffer,octet,3);
+		rBuffer += octet[3];
+		*rBuffer++ = '.';
+	}
+
+	const char* octet = IPV4_OCTETS.mChars[pIPv4 & 0xff];
+	memcpy(rBuffer,octet,3);
+	return rBuffer + octet[3];
+}
+
+size_t IPv4ToChars(const uint32_t* pIPv4,size_t pCount,char* rBuffer,char pSeparator)
+{
+	char* out = rBuffer;
+	for( size_t n = 0 ; n < pCount ; n++ )
+	{
+		out = IPv4ToChars(pIPv4[n],out);
+		*out++ = pSeparator;
+	}
+	return out - rBuffer;
+}
+
+bool ParseIPv4(std::string_view pText,uint32_t& rIPv4)
+{
+	const uint8_t* p = (const uint8_t*)pText.data();
+	const uint8_t* end = p + pText.size();
+	uint32_t IPv4 = 0;
+
+	for( int octet = 0 ; octet < 4 ; octet++ )
+	{
+		if( octet > 0 )
+		{
+			if( p == end || *p != '.' )
+				return false;
+			p++;
+		}
+
+		if( p == end )
+			return false;
+
+		uint32_t value = DECIMAL_DIGITS.mValue[*p++];
+		if( value > 9 )
+			return false;
+
+		// Up to two more digits. Like inet_pton a leading zero is not allowed, so a zero must be on its own.
+		for( int n = 0 ; n < 2 && p != end && DECIMAL_DIGITS.mValue[*p] <= 9 ; n++ )
+		{
+			if( value == 0 )
+				return false;
+			value = (value * 10) + DECIMAL_DIGITS.mValue[*p++];
+		}
+
+		if( value > 255 )
+			return false;
+
+		IPv4 |= value << (octet * 8);
+	}
+
+	if( p != end )
+		return false;
+
+	rIPv4 = IPv4;
+	return true;
+}
+
+size_t ParseIPv4(const std::string_view* pText,size_t pCount,uint32_t* rIPv4)
+{
+	size_t parsed = 0;
+	for( size_t n = 0 ; n < pCount ; n++ )
+	{
+		rIPv4[n] = 0;
+		parsed += ParseIPv4(pText[n],rIPv4[n]);
+	}
+	return parsed;
+}
+
+std::string GetNameFromIPv4(const std::string& pAddress)
+{
+	uint32_t IPv4;
+	if( ParseIPv4(pAddress,IPv4) == false )
+	{
+		return "Not in presentation format";
+	}
+
+	return GetNameFromIPv4(IPv4);
 }
 
 std::string GetNameFromIPv4(const uint32_t pAddress)
@@ -333,6 +482,328 @@ uint32_t GetIPv4FromName(const std::string& pHostName)
 	return IPv4;
 }
 
+ResolverCache::ResolverCache(std::chrono::milliseconds pPositiveTTL,std::chrono::milliseconds pNegativeTTL,size_t pMaxEntries,bool pBackgroundRefresh):
+	mPositiveTTL(pPositiveTTL),
+	mNegativeTTL(pNegativeTTL),
+	mMaxEntries(std::max<size_t>(1,pMaxEntries))
+{
+	if( pBackgroundRefresh )
+	{
+		mRefreshThread = std::thread([this](){RefreshThread();});
+	}
+}
+
+ResolverCache::~ResolverCache()
+{
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		mKeepGoing = false;
+	}
+	mRefreshWake.notify_one();
+	if( mRefreshThread.joinable() )
+	{
+		mRefreshThread.join();
+	}
+}
+
+std::string ResolverCache::GetNameFromIPv4(uint32_t pAddress)
+{
+	return Lookup(mNames,pAddress,[](uint32_t pKey){return network::GetNameFromIPv4(pKey);});
+}
+
+uint32_t ResolverCache::GetIPv4FromName(const std::string& pHostName)
+{
+	return Lookup(mAddresses,pHostName,[](const std::string& pKey){return network::GetIPv4FromName(pKey);});
+}
+
+size_t ResolverCache::GetSize()
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	return mNames.mEntries.size() + mAddresses.mEntries.size();
+}
+
+void ResolverCache::Clear()
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	mNames = Table<uint32_t,std::string>();
+	mAddresses = Table<std::string,uint32_t>();
+}
+
+template<typename KEY,typename VALUE,typename RESOLVE> VALUE ResolverCache::Lookup(Table<KEY,VALUE>& rTable,const KEY& pKey,RESOLVE pResolve)
+{
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		auto found = rTable.mEntries.find(pKey);
+		if( found != rTable.mEntries.end() )
+		{
+			auto& entry = found->second;
+			rTable.mLRU.splice(rTable.mLRU.begin(),rTable.mLRU,entry.mLRU);
+
+			if( std::chrono::steady_clock::now() < entry.mExpires )
+			{
+				mHits++;
+				return entry.mValue;
+			}
+
+			// Stale, if there is a refresh thread hand back what we have and let it look it up again.
+			if( mRefreshThread.joinable() )
+			{
+				if( entry.mRefreshing == false )
+				{
+					entry.mRefreshing = true;
+					rTable.mRefreshQueue.push_back(pKey);
+					mRefreshWake.notify_one();
+				}
+				mHits++;
+				return entry.mValue;
+			}
+		}
+	}
+
+	// Not locked, lookups can take seconds. If two threads miss on the same key at once both ask, the last one stored wins.
+	mMisses++;
+	const VALUE value = pResolve(pKey);
+	std::unique_lock<std::mutex> lock(mMutex);
+	Store(rTable,pKey,value);
+	return value;
+}
+
+template<typename KEY,typename VALUE> void ResolverCache::Store(Table<KEY,VALUE>& rTable,const KEY& pKey,const VALUE& pValue)
+{
+	const bool found = pValue != VALUE();// Empty name or zero address.
+	const auto expires = std::chrono::steady_clock::now() + (found ? mPositiveTTL : mNegativeTTL);
+
+	auto existing = rTable.mEntries.find(pKey);
+	if( existing != rTable.mEntries.end() )
+	{
+		existing->second.mValue = pValue;
+		existing->second.mExpires = expires;
+		existing->second.mRefreshing = false;
+		return;
+	}
+
+	if( rTable.mEntries.size() >= mMaxEntries )
+	{
+		rTable.mEntries.erase(rTable.mLRU.back());
+		rTable.mLRU.pop_back();
+	}
+
+	rTable.mLRU.push_front(pKey);
+	rTable.mEntries.emplace(pKey,typename Table<KEY,VALUE>::Entry{pValue,expires,false,rTable.mLRU.begin()});
+}
+
+void ResolverCache::RefreshThread()
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	while( mKeepGoing )
+	{
+		if( mNames.mRefreshQueue.size() > 0 )
+		{
+			const uint32_t address = mNames.mRefreshQueue.back();
+			mNames.mRefreshQueue.pop_back();
+			lock.unlock();
+			const std::string name = network::GetNameFromIPv4(address);
+			lock.lock();
+			Store(mNames,address,name);
+		}
+		else if( mAddresses.mRefreshQueue.size() > 0 )
+		{
+			const std::string name = mAddresses.mRefreshQueue.back();
+			mAddresses.mRefreshQueue.pop_back();
+			lock.unlock();
+			const uint32_t address = network::GetIPv4FromName(name);
+			lock.lock();
+			Store(mAddresses,name,address);
+		}
+		else
+		{
+			mRefreshWake.wait(lock);
+		}
+	}
+}
+
+IPv4Range::IPv4Range(uint32_t pFromIPv4,uint32_t pToIPv4):
+	mFirst(ntohl(pFromIPv4)),
+	mLast(ntohl(pToIPv4))
+{
+	if( mLast < mFirst )
+	{
+		TINYTOOLS_THROW("IPv4Range " + IPv4ToString(pFromIPv4) + " is after " + IPv4ToString(pToIPv4));
+	}
+}
+
+IPv4Range IPv4Range::FromCIDR(uint32_t pIPv4,int pPrefixLength)
+{
+	if( pPrefixLength < 0 || pPrefixLength > 32 )
+	{
+		TINYTOOLS_THROW("IPv4Range::FromCIDR prefix length " + std::to_string(pPrefixLength) + " is not 0 to 32");
+	}
+
+	const uint32_t mask = pPrefixLength == 0 ? 0 : 0xffffffffu << (32 - pPrefixLength);
+	IPv4Range range;
+	range.mFirst = ntohl(pIPv4) & mask;
+	range.mLast = range.mFirst | ~mask;
+	return range;
+}
+
+IPv4Range IPv4Range::FromCIDR(const std::string& pCIDR)
+{
+	const size_t slash = pCIDR.find('/');
+	const std::string address = pCIDR.substr(0,slash);
+
+	uint32_t IPv4;
+	if( ParseIPv4(address,IPv4) == false )
+	{
+		TINYTOOLS_THROW("IPv4Range::FromCIDR can't parse the address in " + pCIDR);
+	}
+
+	int prefixLength = 32;
+	if( slash != std::string::npos )
+	{
+		const std::string prefix = pCIDR.substr(slash+1);
+		if( prefix.size() == 0 || prefix.size() > 2 || std::all_of(prefix.begin(),prefix.end(),::isdigit) == false )
+		{
+			TINYTOOLS_THROW("IPv4Range::FromCIDR can't parse the prefix length in " + pCIDR);
+		}
+		prefixLength = std::stoi(prefix);
+	}
+
+	return FromCIDR(IPv4,prefixLength);
+}
+
+IPv4Range IPv4Range::Hosts()const
+{
+	IPv4Range hosts = *this;
+	if( GetCount() > 2 )
+	{
+		hosts.mFirst++;
+		hosts.mLast--;
+	}
+	return hosts;
+}
+
+void IPv4Set::Add(const IPv4Range& pRange)
+{
+	// Find the first range that touches or comes after the new one, then swallow all the ones it touches.
+	auto first = std::lower_bound(mRanges.begin(),mRanges.end(),pRange,[](const IPv4Range& pA,const IPv4Range& pB){return uint64_t(pA.mLast) + 1 < pB.mFirst;});
+	auto last = first;
+	IPv4Range merged = pRange;
+	for( ; last != mRanges.end() && last->mFirst <= uint64_t(merged.mLast) + 1 ; last++ )
+	{
+		merged.mFirst = std::min(merged.mFirst,last->mFirst);
+		merged.mLast = std::max(merged.mLast,last->mLast);
+	}
+
+	if( first == last )
+	{
+		mRanges.insert(first,merged);
+	}
+	else
+	{
+		*first = merged;
+		mRanges.erase(first + 1,last);
+	}
+}
+
+void IPv4Set::Add(const IPv4Set& pOther)
+{
+	// Merge the two sorted lists then join up the ones that touch.
+	std::vector<IPv4Range> all;
+	all.reserve(mRanges.size() + pOther.mRanges.size());
+	std::merge(mRanges.begin(),mRanges.end(),pOther.mRanges.begin(),pOther.mRanges.end(),std::back_inserter(all),[](const IPv4Range& pA,const IPv4Range& pB){return pA.mFirst < pB.mFirst;});
+
+	mRanges.clear();
+	for( const auto& range : all )
+	{
+		if( mRanges.size() > 0 && range.mFirst <= uint64_t(mRanges.back().mLast) + 1 )
+		{
+			mRanges.back().mLast = std::max(mRanges.back().mLast,range.mLast);
+		}
+		else
+		{
+			mRanges.push_back(range);
+		}
+	}
+}
+
+void IPv4Set::Remove(const IPv4Range& pRange)
+{
+	// Find the first range that overlaps, then cut the removed part out of all the ones it overlaps.
+	// At most two bits are left over, the start of the first one and the end of the last one.
+	auto first = std::lower_bound(mRanges.begin(),mRanges.end(),pRange,[](const IPv4Range& pA,const IPv4Range& pB){return pA.mLast < pB.mFirst;});
+	auto last = first;
+	std::vector<IPv4Range> keep;
+	for( ; last != mRanges.end() && last->mFirst <= pRange.mLast ; last++ )
+	{
+		if( last->mFirst < pRange.mFirst )
+		{
+			keep.push_back(*last);
+			keep.back().mLast = pRange.mFirst - 1;
+		}
+		if( last->mLast > pRange.mLast )
+		{
+			keep.push_back(*last);
+			keep.back().mFirst = pRange.mLast + 1;
+		}
+	}
+
+	first = mRanges.erase(first,last);
+	mRanges.insert(first,keep.begin(),keep.end());
+}
+
+void IPv4Set::Remove(const IPv4Set& pOther)
+{
+	// Walk both, what is left of each of ours is trimmed by the others that overlap it.
+	std::vector<IPv4Range> left;
+	auto other = pOther.mRanges.begin();
+	for( IPv4Range range : mRanges )
+	{
+		while( other != pOther.mRanges.end() && other->mLast < range.mFirst )
+		{
+			other++;
+		}
+
+		bool gone = false;
+		for( auto o = other ; o != pOther.mRanges.end() && o->mFirst <= range.mLast ; o++ )
+		{
+			if( o->mFirst > range.mFirst )
+			{
+				left.push_back(range);
+				left.back().mLast = o->mFirst - 1;
+			}
+			if( o->mLast >= range.mLast )
+			{
+				gone = true;
+				break;
+			}
+			range.mFirst = o->mLast + 1;
+		}
+
+		if( gone == false )
+		{
+			left.push_back(range);
+		}
+	}
+	mRanges.swap(left);
+}
+
+bool IPv4Set::Contains(uint32_t pIPv4)const
+{
+	const uint32_t host = ntohl(pIPv4);
+	auto after = std::upper_bound(mRanges.begin(),mRanges.end(),host,[](uint32_t pHost,const IPv4Range& pRange){return pHost < pRange.mFirst;});
+	return after != mRanges.begin() && host <= (after-1)->mLast;
+}
+
+uint64_t IPv4Set::GetCount()const
+{
+	uint64_t count = 0;
+	for( const auto& range : mRanges )
+	{
+		count += range.GetCount();
+	}
+	return count;
+}
+
 void ScanNetworkIPv4(uint32_t pFromIPRange,uint32_t pToIPRange,std::function<bool(const uint32_t pIPv4,const char* pHostName)> pDeviceFound)
 {
 	// Because IP values are in big endian format I need disassemble to iterate over them.
@@ -379,689 +850,4928 @@ void ScanNetworkIPv4(uint32_t pFromIPRange,uint32_t pToIPRange,std::function<boo
 	}
 }
 
-bool IsPortOpen(uint32_t pIPv4,uint16_t pPort)
+/**
+ * @brief Does the reverse lookups for pNumAddresses addresses on pMaxLookupsInFlight worker threads.
+ * The workers take the next index from a shared count and pAddressAt turns it into an address, so nothing is built up front.
+ * pDeviceFound is called on this thread. If it throws the workers are stopped and joined before the exception carries on.
+ */
+static void ScanAddressesIPv4(uint64_t pNumAddresses,const std::function<uint32_t(uint64_t pIndex)>& pAddressAt,size_t pMaxLookupsInFlight,const std::function<bool(const uint32_t pIPv4,const char* pHostName)>& pDeviceFound)
 {
-	int sockfd = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
-    if (sockfd < 0)
+	std::atomic<uint64_t> nextAddress(0);
+	std::atomic<bool> keepGoing(true);
+	std::mutex foundMutex;
+	std::condition_variable foundSignal;
+	std::vector<std::pair<uint32_t,std::string>> found;
+	size_t workersRunning = 0;
+
+	std::vector<std::thread> workers;
+	auto joinWorkers = [&]()
 	{
-		TINYTOOLS_THROW("ERROR opening socket");
-		return false;
-	}
+		for( auto& worker : workers )
+		{
+			worker.join();
+		}
+	};
 
-    sockaddr_in deviceAddress;
-	memset(&deviceAddress, 0, sizeof(deviceAddress));
+	try
+	{
+		for( size_t n = (size_t)std::min<uint64_t>(pMaxLookupsInFlight,pNumAddresses) ; n > 0 ; n-- )
+		{
+			{
+				std::unique_lock<std::mutex> lk(foundMutex);
+				workersRunning++;
+			}
+			workers.emplace_back([&]()
+			{
+				for( uint64_t index = nextAddress++ ; index < pNumAddresses && keepGoing ; index = nextAddress++ )
+				{
+					const uint32_t address = pAddressAt(index);
+					sockaddr_in deviceIP;
+					memset(&deviceIP, 0, sizeof deviceIP);
+					deviceIP.sin_addr.s_addr = address;
+					deviceIP.sin_family = AF_INET;
 
-	deviceAddress.sin_addr.s_addr = pIPv4;
-	deviceAddress.sin_port = htons(pPort);
-	deviceAddress.sin_family = AF_INET;
+					char hbuf[NI_MAXHOST];
+					hbuf[0] = 0;
+					if( getnameinfo((struct sockaddr*)&deviceIP,sizeof(deviceIP),hbuf,sizeof(hbuf),NULL,0,NI_NAMEREQD) == 0 )
+					{
+						std::unique_lock<std::mutex> lk(foundMutex);
+						found.emplace_back(address,hbuf);
+						foundSignal.notify_one();
+					}
+				}
 
-	const bool isOpen = connect(sockfd,(struct sockaddr *) &deviceAddress,sizeof(deviceAddress)) == 0;
-	close(sockfd);
-	return isOpen;
+				std::unique_lock<std::mutex> lk(foundMutex);
+				workersRunning--;
+				foundSignal.notify_one();
+			});
+		}
+
+		// Deliver the results on this thread, the callers code does not have to be thread safe.
+		std::vector<std::pair<uint32_t,std::string>> deliver;
+		std::unique_lock<std::mutex> lk(foundMutex);
+		while( keepGoing )
+		{
+			foundSignal.wait(lk,[&](){return found.size() > 0 || workersRunning == 0;});
+			if( found.size() == 0 && workersRunning == 0 )
+				break;
+
+			deliver.swap(found);
+			lk.unlock();
+			for( const auto& device : deliver )
+			{
+				if( pDeviceFound(device.first,device.second.c_str()) == false )
+				{
+					keepGoing = false;// User asked to end.
+					break;
+				}
+			}
+			deliver.clear();
+			lk.lock();
+		}
+	}
+	catch(...)
+	{
+		keepGoing = false;
+		joinWorkers();
+		throw;
+	}
+	joinWorkers();
 }
 
-size_t Encode7Bit(const uint8_t* p8Bit,size_t p8BitSize,uint8_t** r7Bit)
+void ScanNetworkIPv4(uint32_t pFromIPRange,uint32_t pToIPRange,size_t pMaxLookupsInFlight,std::function<bool(const uint32_t pIPv4,const char* pHostName)> pDeviceFound)
 {
-    size_t newSize = ((p8BitSize+1) * 8) / 7;
-    assert(newSize > 1);
+	if( pMaxLookupsInFlight < 2 )
+	{
+		ScanNetworkIPv4(pFromIPRange,pToIPRange,pDeviceFound);
+		return;
+	}
 
-    uint8_t* out = new uint8_t[newSize];
-    *r7Bit = out;
+	// Same addresses, in the same order, as the single threaded version.
+	const int aFrom = (pFromIPRange&0x000000ff)>>0;
+	const int bFrom = (pFromIPRange&0x0000ff00)>>8;
+	const int cFrom = (pFromIPRange&0x00ff0000)>>16;
+	const int dFrom = std::clamp(int((pFromIPRange&0xff000000)>>24),1,254);
 
-    for( ; p8BitSize > 6 ; p8BitSize -=7 , out += 8, p8Bit += 7 )
-    {
-        assert( out + 7 < (*r7Bit) + newSize );
-        out[0] = (                        (p8Bit[0]>>1) );
-        out[1] = ( ((p8Bit[0]&0x01)<<6) | (p8Bit[1]>>2) );
-        out[2] = ( ((p8Bit[1]&0x03)<<5) | (p8Bit[2]>>3) );
-        out[3] = ( ((p8Bit[2]&0x07)<<4) | (p8Bit[3]>>4) );
-        out[4] = ( ((p8Bit[3]&0x0F)<<3) | (p8Bit[4]>>5) );
-        out[5] = ( ((p8Bit[4]&0x1F)<<2) | (p8Bit[5]>>6) );
-        out[6] = ( ((p8Bit[5]&0x3F)<<1) | (p8Bit[6]>>7) );
-        out[7] = ( ((p8Bit[6]&0x7F)<<0) );        
-    }
+	const int aTo = (pToIPRange&0x000000ff)>>0;
+	const int bTo = (pToIPRange&0x0000ff00)>>8;
+	const int cTo = (pToIPRange&0x00ff0000)>>16;
+	const int dTo = std::clamp(int((pToIPRange&0xff000000)>>24),1,254);
 
-    // And now for the trailing bytes.
-    assert( p8BitSize < 7 );
-    if( p8BitSize > 0 )
-    {
-        uint8_t padding[6] = {0,0,0,0,0,0};
-        for( size_t n = 0 ; n < p8BitSize ; n++ )
-        {
-            padding[n] = p8Bit[n];
-        }
+	const uint64_t aCount = std::max(aTo - aFrom + 1,0);
+	const uint64_t bCount = std::max(bTo - bFrom + 1,0);
+	const uint64_t cCount = std::max(cTo - cFrom + 1,0);
+	const uint64_t dCount = std::max(dTo - dFrom + 1,0);
 
-        *out = (                          (padding[0]>>1) ); out++;
-        *out = ( ((padding[0]&0x01)<<6) | (padding[1]>>2) ); out++;
-        if( p8BitSize > 1 )
-        {
-            *out = ( ((p8Bit[1]&0x03)<<5) | (p8Bit[2]>>3) ); out++;
-            if( p8BitSize > 2 )
-            {
-                *out = ( ((p8Bit[2]&0x07)<<4) | (p8Bit[3]>>4) ); out++;
-                if( p8BitSize > 3 )
-                {
-                    *out = ( ((p8Bit[3]&0x0F)<<3) | (p8Bit[4]>>5) ); out++;
-                    if( p8BitSize > 4 )
-                    {
-                        *out = ( ((p8Bit[4]&0x1F)<<2) | (p8Bit[5]>>6) ); out++;
-                        if( p8BitSize > 5 )
-                        {
-                            *out = ((p8Bit[5]&0x3F)<<1); out++;
-                        }
-                    }
-                }
-            }
-        }
-    }
-    assert( out <= (*r7Bit) + newSize );
+	// The index is the loop counters of the single threaded version packed together, d changing fastest.
+	auto addressAt = [&](uint64_t pIndex)
+	{
+		const int d = dFrom + int(pIndex % dCount);pIndex /= dCount;
+		const int c = cFrom + int(pIndex % cCount);pIndex /= cCount;
+		const int b = bFrom + int(pIndex % bCount);pIndex /= bCount;
+		const int a = aFrom + int(pIndex);
+		return MakeIP4V(a,b,c,d);
+	};
 
-    return out - *r7Bit;
+	ScanAddressesIPv4(aCount * bCount * cCount * dCount,addressAt,pMaxLookupsInFlight,pDeviceFound);
 }
 
-size_t Decode7Bit(const uint8_t* p7Bit,size_t p7BitSize,uint8_t** r8Bit)
+void ScanNetworkIPv4(const IPv4Set& pAddresses,size_t pMaxLookupsInFlight,std::function<bool(const uint32_t pIPv4,const char* pHostName)> pDeviceFound)
 {
-    size_t newSize = (p7BitSize+1) * 7 / 8;
-    assert(newSize > 1);
-
-    uint8_t* out = new uint8_t[newSize];
-    *r8Bit = out;
-
-    for( ; p7BitSize > 7 ; p7BitSize -= 8, p7Bit += 8, out += 7 )
-    {
-        assert( out + 6 < (*r8Bit) + newSize );
-        out[0] = ( p7Bit[0] << 1 | (p7Bit[1]>>6));
-        out[1] = ( p7Bit[1] << 2 | (p7Bit[2]>>5));
-        out[2] = ( p7Bit[2] << 3 | (p7Bit[3]>>4));
-        out[3] = ( p7Bit[3] << 4 | (p7Bit[4]>>3));
-        out[4] = ( p7Bit[4] << 5 | (p7Bit[5]>>2));
-        out[5] = ( p7Bit[5] << 6 | (p7Bit[6]>>1));
-        out[6] = ( p7Bit[6] << 7 | (p7Bit[7]>>0));
-    }
+	if( pMaxLookupsInFlight < 2 )
+	{
+		for( const uint32_t address : pAddresses )
+		{
+			sockaddr_in deviceIP;
+			memset(&deviceIP, 0, sizeof deviceIP);
+			deviceIP.sin_addr.s_addr = address;
+			deviceIP.sin_family = AF_INET;
+
+			char hbuf[NI_MAXHOST];
+			hbuf[0] = 0;
+			if( getnameinfo((struct sockaddr*)&deviceIP,sizeof(deviceIP),hbuf,sizeof(hbuf),NULL,0,NI_NAMEREQD) == 0 && pDeviceFound(address,hbuf) == false )
+			{
+				return;// User asked to end.
+			}
+		}
+		return;
+	}
 
-    if( p7BitSize > 0 )
-    {
-        *out = ( p7Bit[0] << 1 | (p7Bit[1]>>6)); out++;
-        if( p7BitSize > 2 )
-        {
-            *out = ( p7Bit[1] << 2 | (p7Bit[2]>>5)); out++;
-            if( p7BitSize > 3 )
-            {
-                *out = ( p7Bit[2] << 3 | (p7Bit[3]>>4)); out++;
-                if( p7BitSize > 4 )
-                {
-                    *out = ( p7Bit[3] << 4 | (p7Bit[4]>>3)); out++;
-                    if( p7BitSize > 5 )
-                    {
-                        *out = ( p7Bit[4] << 5 | (p7Bit[5]>>2)); out++;
-                        if( p7BitSize > 6 )
-                        {
-                            *out = ( p7Bit[5] << 6 | (p7Bit[6]>>1)); out++;
-                            if( p7BitSize > 7 )
-                            {
-                                *out = ( p7Bit[6] << 7 | (p7Bit[7]>>0)); out++;
-                            }
-                        }
-                    }
-                }
-            }
-        }
-    }
-    assert( out <= (*r8Bit) + newSize );
+	// The count of addresses before each range turns an index back into an address with a binary search.
+	const std::vector<IPv4Range>& ranges = pAddresses.GetRanges();
+	std::vector<uint64_t> rangeStarts;
+	uint64_t numAddresses = 0;
+	for( const auto& range : ranges )
+	{
+		rangeStarts.push_back(numAddresses);
+		numAddresses += range.GetCount();
+	}
+	auto addressAt = [&](uint64_t pIndex)
+	{
+		const size_t r = std::upper_bound(rangeStarts.begin(),rangeStarts.end(),pIndex) - rangeStarts.begin() - 1;
+		return htonl(ranges[r].mFirst + uint32_t(pIndex - rangeStarts[r]));
+	};
 
-    return out - *r8Bit;
+	ScanAddressesIPv4(numAddresses,addressAt,pMaxLookupsInFlight,pDeviceFound);
 }
 
-};// namespace network
-
-///////////////////////////////////////////////////////////////////////////////////////////////////////////
-namespace system{
-
-std::string GetLocalDateTime()
+std::string InterfaceAddress::ToString()const
 {
-	auto t = std::time(nullptr);
-	char mbstr[100];
-	std::strftime(mbstr,sizeof(mbstr), "%d-%m-%Y %H-%M-%S",std::localtime(&t));
-    return mbstr;
+	if( mFamily == AF_INET )
+	{
+		return IPv4ToString(mIPv4);
+	}
+
+	char buffer[INET6_ADDRSTRLEN];
+	if( mFamily == AF_INET6 && inet_ntop(AF_INET6,&mIPv6,buffer,sizeof(buffer)) != nullptr )
+	{
+		return buffer;
+	}
+	return "";
 }
 
 /**
- * @brief Fetches the system uptime in a more human readable format
+ * @brief Counts the bits set in a netmask, it's in network byte order but that does not matter for a count.
  */
-bool GetUptime(uint64_t& rUpDays,uint64_t& rUpHours,uint64_t& rUpMinutes)
+static int NetmaskToPrefixLength(const uint8_t* pNetmask,size_t pSize)
 {
-    rUpDays = 0;
-    rUpHours = 0;
-    rUpMinutes = 0;
-
-    std::ifstream upTimeFile("/proc/uptime");
-    if( upTimeFile.is_open() )
-    {
-        rUpDays = 999;
-        char buf[256];
-        buf[255] = 0;
-        if( upTimeFile.getline(buf,255,' ') )
-        {
-            const uint64_t secondsInADay = 60 * 60 * 24;
-            const uint64_t secondsInAnHour = 60 * 60;
-            const uint64_t secondsInAMinute = 60;
-
-            const uint64_t totalSeconds = std::stoull(buf);
-            rUpDays = totalSeconds / secondsInADay;
-            rUpHours = (totalSeconds - (rUpDays*secondsInADay)) / secondsInAnHour;
-            rUpMinutes = (totalSeconds - (rUpDays*secondsInADay) - (rUpHours * secondsInAnHour) ) / secondsInAMinute;
-            return true;
-        }
-    }
-    return false;
+	int bits = 0;
+	for( size_t n = 0 ; n < pSize ; n++ )
+	{
+		bits += __builtin_popcount(pNetmask[n]);
+	}
+	return bits;
 }
 
-std::string GetUptime()
+static std::shared_ptr<const InterfaceTable> ReadInterfaceTable()
 {
-	uint64_t upDays,upHours,upMinutes;
-	GetUptime(upDays,upHours,upMinutes);
-	std::string upTime;
-	std::string space;
-	if( upDays > 0 )
+	struct ifaddrs* addresses = nullptr;
+	if( getifaddrs(&addresses) != 0 )
 	{
-		if( upDays == 1 )
+		TINYTOOLS_THROW("getifaddrs failed, " + std::string(strerror(errno)));
+	}
+
+	auto table = std::make_shared<InterfaceTable>();
+	for( struct ifaddrs* ifa = addresses ; ifa != nullptr ; ifa = ifa->ifa_next )
+	{
+		// Each address is its own entry, so find the interface it's for. There are only ever a few.
+		auto interface = std::find_if(table->begin(),table->end(),[ifa](const NetworkInterface& pI){return pI.mName == ifa->ifa_name;});
+		if( interface == table->end() )
 		{
-			upTime = "1 Day";
+			table->emplace_back();
+			interface = table->end() - 1;
+			interface->mName = ifa->ifa_name;
+			interface->mIndex = if_nametoindex(ifa->ifa_name);
+			interface->mFlags = ifa->ifa_flags;
 		}
-		else
+
+		if( ifa->ifa_addr == nullptr )
+			continue;
+
+		InterfaceAddress address;
+		address.mFamily = ifa->ifa_addr->sa_family;
+		if( address.mFamily == AF_INET )
 		{
-			upTime = std::to_string(upDays) + " Days";
+			address.mIPv4 = ((const sockaddr_in*)ifa->ifa_addr)->sin_addr.s_addr;
+			if( ifa->ifa_netmask != nullptr )
+			{
+				address.mIPv4Netmask = ((const sockaddr_in*)ifa->ifa_netmask)->sin_addr.s_addr;
+				address.mPrefixLength = NetmaskToPrefixLength((const uint8_t*)&address.mIPv4Netmask,4);
+			}
+			if( (ifa->ifa_flags & IFF_BROADCAST) && ifa->ifa_broadaddr != nullptr )
+			{
+				address.mIPv4Broadcast = ((const sockaddr_in*)ifa->ifa_broadaddr)->sin_addr.s_addr;
+			}
+			interface->mAddresses.push_back(address);
+		}
+		else if( address.mFamily == AF_INET6 )
+		{
+			address.mIPv6 = ((const sockaddr_in6*)ifa->ifa_addr)->sin6_addr;
+			if( ifa->ifa_netmask != nullptr )
+			{
+				address.mPrefixLength = NetmaskToPrefixLength(((const sockaddr_in6*)ifa->ifa_netmask)->sin6_addr.s6_addr,16);
+			}
+			interface->mAddresses.push_back(address);
 		}
-		space = " ";
 	}
 
-	if( upHours > 0 )
+	freeifaddrs(addresses);
+	return table;
+}
+
+InterfaceMonitor::InterfaceMonitor(bool pWatchForChanges)
+{
+	if( pWatchForChanges )
 	{
-		if( upHours == 1 )
+		// Subscribe before the first read so a change that happens in between is not missed.
+		mNetlinkSocket = socket(AF_NETLINK,SOCK_RAW|SOCK_CLOEXEC|SOCK_NONBLOCK,NETLINK_ROUTE);
+		if( mNetlinkSocket < 0 )
 		{
-			upTime += space + "1 Hour";
+			TINYTOOLS_THROW("InterfaceMonitor failed to open netlink socket, " + std::string(strerror(errno)));
 		}
-		else
+
+		struct sockaddr_nl groups;
+		memset(&groups,0,sizeof(groups));
+		groups.nl_family = AF_NETLINK;
+		groups.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR;
+		if( bind(mNetlinkSocket,(struct sockaddr*)&groups,sizeof(groups)) != 0 )
 		{
-			upTime += space + std::to_string(upHours) + " Hours";
+			const std::string error = strerror(errno);
+			close(mNetlinkSocket);
+			TINYTOOLS_THROW("InterfaceMonitor failed to bind netlink socket, " + error);
+		}
+
+		mExitEvent = eventfd(0,EFD_CLOEXEC);
+		if( mExitEvent < 0 )
+		{
+			const std::string error = strerror(errno);
+			close(mNetlinkSocket);
+			TINYTOOLS_THROW("InterfaceMonitor failed to make eventfd, " + error);
 		}
-		space = " ";
 	}
 
-	if( upMinutes == 1 )
+	try
 	{
-		upTime += "1 Minute";
+		Refresh();
+
+		if( pWatchForChanges )
+		{
+			mMonitorThread = std::thread([this](){MonitorThread();});
+		}
 	}
-	else
+	catch(...)
+	{// The destructor will not run, so close what we opened.
+		if( mNetlinkSocket >= 0 ){close(mNetlinkSocket);}
+		if( mExitEvent >= 0 ){close(mExitEvent);}
+		throw;
+	}
+}
+
+InterfaceMonitor::~InterfaceMonitor()
+{
+	if( mMonitorThread.joinable() )
 	{
-		upTime += space + std::to_string(upMinutes) + " Minutes";
+		const uint64_t one = 1;
+		if( write(mExitEvent,&one,sizeof(one)) ){}// Nothing to be done if it fails.
+		mMonitorThread.join();
 	}
 
-	return upTime;
+	if( mNetlinkSocket >= 0 )
+	{
+		close(mNetlinkSocket);
+	}
+	if( mExitEvent >= 0 )
+	{
+		close(mExitEvent);
+	}
 }
 
-bool GetCPULoad(std::map<int,CPULoadTracking>& pTrackingData,int& rTotalSystemLoad,std::map<int,int>& rCoreLoads)
+void InterfaceMonitor::Refresh()
 {
-	// If pTrackingData is empty then we're initalising the state so lets build our starting point.
-	const bool initalising = pTrackingData.size() ==  0;
+	std::unique_lock<std::mutex> lock(mRefreshMutex);
+	const auto table = ReadInterfaceTable();
 
-	std::ifstream statFile("/proc/stat");
-	if( statFile.is_open() )
+	uint32_t IPv4 = 0;
+	for( const auto& interface : *table )
 	{
-		// Written so that it'll read the lines in any order. Easy to do and safe.
-		while( statFile.eof() == false )
+		if( interface.IsUp() && interface.IsLoopback() == false )
 		{
-			std::string what;
-			statFile >> what;
-			if( string::CompareNoCase(what,"cpu") )
+			for( const auto& address : interface.mAddresses )
 			{
-				// The the rest of the bits we want.
-				std::string usertimeSTR, nicetimeSTR, systemtimeSTR, idletimeSTR, ioWaitSTR, irqSTR, softIrqSTR, stealSTR, guestSTR, guestniceSTR;
-				statFile >> usertimeSTR >>
-								 nicetimeSTR >>
-								 systemtimeSTR >>
-								 idletimeSTR >>
-								 ioWaitSTR >>
-								 irqSTR >>
-								 softIrqSTR >>
-								 stealSTR >>
-								 guestSTR >>
-								 guestniceSTR;
-				// Read rest of line.
-				std::string eol;
-				std::getline(statFile,eol,'\n');
-
-				const uint64_t userTime = std::stoull(usertimeSTR);	
-				const uint64_t niceTime = std::stoull(nicetimeSTR);
-				const uint64_t idleTime = std::stoull(idletimeSTR);
-				const uint64_t stealTime = std::stoull(stealSTR);
-				
-				const uint64_t systemAllTime = std::stoull(systemtimeSTR) + std::stoull(irqSTR) + std::stoull(softIrqSTR);
-//				const uint64_t virtualTime = std::stoull(guestSTR) + std::stoull(guestniceSTR); // According to a comment in hot, guest and guest nice are already incorerated in user time.
-				const uint64_t totalTime = userTime + niceTime + systemAllTime + idleTime + stealTime; // No need to add virtualTime, I want that to be part of user time. If not will not see load on CPU from virtual guest.
-
-				int cpuID = -1; // This is the total system load.
-				if( what.size() > 3 )
+				if( address.mFamily == AF_INET )
 				{
-					sscanf(what.data(),"cpu%d",&cpuID);
-					if( cpuID < 0 || cpuID > 128 )
-					{
-						TINYTOOLS_THROW("Error in GetCPULoad, cpu Id read from /proc/stat has a massive index, not going ot happen mate... cpuID == " + std::to_string(cpuID));
-					}
+					IPv4 = address.mIPv4;
+					break;
 				}
+			}
+		}
+		if( IPv4 != 0 )
+			break;
+	}
 
-				if( initalising )
-				{
-					if( pTrackingData.find(cpuID) != pTrackingData.end() )
-					{
-						TINYTOOLS_THROW("Error in GetCPULoad, trying to initalising and found a duplicate CPU id, something went wrong. cpuID == " + std::to_string(cpuID));
-					}
+	std::atomic_store(&mInterfaces,table);
+	mIPv4 = IPv4;
+	mChangeCount++;
+}
 
-					CPULoadTracking info;
-					info.mUserTime		= userTime;
-					info.mTotalTime		= totalTime;
-					pTrackingData.emplace(cpuID,info);
-				}
-				else
-				{
-					// Workout the deltas to get cpu load in percentage.
-					auto core = pTrackingData.find(cpuID);
-					if( core == pTrackingData.end() )
-					{
-						TINYTOOLS_THROW("Error in GetCPULoad, trying to workout load but found a new CPU id, something went wrong. cpuID == " + std::to_string(cpuID));
-					}
+void InterfaceMonitor::MonitorThread()
+{
+	struct pollfd fds[2];
+	fds[0].fd = mNetlinkSocket;
+	fds[0].events = POLLIN;
+	fds[1].fd = mExitEvent;
+	fds[1].events = POLLIN;
+
+	std::vector<uint8_t> buffer(16 * 1024);
+	for(;;)
+	{
+		if( poll(fds,2,-1) < 0 )
+		{
+			if( errno == EINTR )
+				continue;
+			return;
+		}
 
-					// Copied from htop!
-					// Since we do a subtraction (usertime - guest) and cputime64_to_clock_t()
-					// used in /proc/stat rounds down numbers, it can lead to a case where the
-					// integer overflow.
-					#define WRAP_SUBTRACT(a,b) (a > b) ? a - b : 0					
-					const uint64_t deltaUser = WRAP_SUBTRACT(userTime,core->second.mUserTime);
-					const uint64_t deltaTotal = WRAP_SUBTRACT(totalTime,core->second.mTotalTime);
-					#undef WRAP_SUBTRACT
-					core->second.mUserTime = userTime;
-					core->second.mTotalTime = totalTime;
+		if( fds[1].revents != 0 )
+			return;
 
-					if( deltaTotal > 0 )
-					{
-						const uint64_t percentage = deltaUser * 100 / deltaTotal;
-						if( cpuID == -1 )
-						{
-							rTotalSystemLoad = (int)percentage;
-						}
-						else
-						{
-							rCoreLoads[cpuID] = (int)percentage;
-						}
-					}
-					else
-					{
-						if( cpuID == -1 )
-						{
-							rTotalSystemLoad = 0;
-						}
-						else
-						{
-							rCoreLoads[cpuID] = 0;
-						}
-					}
-				}
+		// We don't care what changed, one reread covers however many messages there are. So drain them all first.
+		bool changed = false;
+		for(;;)
+		{
+			const ssize_t got = recv(mNetlinkSocket,buffer.data(),buffer.size(),MSG_DONTWAIT);
+			if( got > 0 )
+			{
+				changed = true;
+			}
+			else if( got < 0 && errno == ENOBUFS )
+			{
+				changed = true;// Missed some, so reread anyway.
+			}
+			else if( got < 0 && errno == EINTR )
+			{
+				continue;
+			}
+			else
+			{
+				break;
 			}
 		}
-		return true;
+
+		if( changed )
+		{
+			try
+			{
+				Refresh();
+			}
+			catch( std::runtime_error& ){}// Keep the last table, the next change will try again.
+		}
 	}
-	return false;
 }
 
-bool GetMemoryUsage(size_t& rMemoryUsedKB,size_t& rMemAvailableKB,size_t& rMemTotalKB,size_t& rSwapUsedKB)
+InterfaceMonitor& GetInterfaceMonitor()
 {
-	std::ifstream memFile("/proc/meminfo");
-	if( memFile.is_open() )
+	static InterfaceMonitor monitor;
+	return monitor;
+}
+
+bool Neighbour::IsAlive()const
+{
+	return (mState & (NUD_REACHABLE|NUD_STALE|NUD_DELAY|NUD_PROBE|NUD_PERMANENT)) != 0;
+}
+
+/**
+ * @brief Dumps the IPv4 neighbour table with rtnetlink.
+ * @return false If netlink could not be used, rNeighbours is then left empty.
+ */
+static bool ReadNeighbourTableNetlink(std::vector<Neighbour>& rNeighbours)
+{
+	const int netlink = socket(AF_NETLINK,SOCK_RAW|SOCK_CLOEXEC,NETLINK_ROUTE);
+	if( netlink < 0 )
+		return false;
+
+	struct
 	{
-		// We'll build a map of the data lines that have key: value combination.
-		std::map<std::string,size_t> keyValues;
-		while( memFile.eof() == false )
+		struct nlmsghdr mHeader;
+		struct ndmsg mNeighbour;
+	}request;
+	memset(&request,0,sizeof(request));
+	request.mHeader.nlmsg_len = NLMSG_LENGTH(sizeof(struct ndmsg));
+	request.mHeader.nlmsg_type = RTM_GETNEIGH;
+	request.mHeader.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+	request.mHeader.nlmsg_seq = 1;
+	request.mNeighbour.ndm_family = AF_INET;
+
+	if( send(netlink,&request,request.mHeader.nlmsg_len,0) < 0 )
+	{
+		close(netlink);
+		return false;
+	}
+
+	// The dump comes back in as many messages as it takes, until NLMSG_DONE.
+	std::vector<uint8_t> buffer(32 * 1024);
+	bool done = false;
+	bool ok = true;
+	while( done == false && ok )
+	{
+		ssize_t got = recv(netlink,buffer.data(),buffer.size(),0);
+		if( got < 0 && errno == EINTR )
+			continue;
+		if( got <= 0 )
 		{
-			std::string memLine;
-			std::getline(memFile,memLine);
-			if( memLine.size() > 0 )
+			ok = false;
+			break;
+		}
+
+		for( const struct nlmsghdr* header = (const struct nlmsghdr*)buffer.data() ; NLMSG_OK(header,(size_t)got) ; header = NLMSG_NEXT(header,got) )
+		{
+			if( header->nlmsg_type == NLMSG_DONE )
 			{
-				std::vector<std::string> memParts = string::SplitString(memLine," ");// Have to do like this as maybe two or three parts. key: value [kb]
-				if( memParts.size() != 2 && memParts.size() != 3 )
+				done = true;
+				break;
+			}
+			if( header->nlmsg_type == NLMSG_ERROR )
+			{
+				ok = false;
+				break;
+			}
+			if( header->nlmsg_type != RTM_NEWNEIGH )
+				continue;
+
+			const struct ndmsg* entry = (const struct ndmsg*)NLMSG_DATA(header);
+			if( entry->ndm_family != AF_INET )
+				continue;
+
+			Neighbour neighbour;
+			neighbour.mInterfaceIndex = entry->ndm_ifindex;
+			neighbour.mState = entry->ndm_state;
+			int attributesSize = (int)RTM_PAYLOAD(header);
+			for( const struct rtattr* attribute = (const struct rtattr*)(((const uint8_t*)entry) + NLMSG_ALIGN(sizeof(struct ndmsg))) ; RTA_OK(attribute,attributesSize) ; attribute = RTA_NEXT(attribute,attributesSize) )
+			{
+				if( attribute->rta_type == NDA_DST && RTA_PAYLOAD(attribute) == 4 )
 				{
-					TINYTOOLS_THROW("Failed to correctly read a line from /proc/meminfo did the format change? Found line \"" + memLine + "\" and split it into " + std::to_string(memParts.size()) + " parts");
+					memcpy(&neighbour.mIPv4,RTA_DATA(attribute),4);
 				}
+				else if( attribute->rta_type == NDA_LLADDR && RTA_PAYLOAD(attribute) == 6 )
+				{
+					memcpy(neighbour.mMAC,RTA_DATA(attribute),6);
+				}
+			}
+			rNeighbours.push_back(neighbour);
+		}
+	}
 
-				if( memParts[0].back() == ':' )
+	close(netlink);
+	if( ok == false )
+	{
+		rNeighbours.clear();
+	}
+	return ok;
+}
+
+/**
+ * @brief The fall back, parses /proc/net/arp. It has no state, just flags for complete and permanent.
+ */
+static void ReadNeighbourTableProc(std::vector<Neighbour>& rNeighbours)
+{
+	std::ifstream arp("/proc/net/arp");
+	std::string line;
+	std::getline(arp,line);// Skip the column titles.
+	while( std::getline(arp,line) )
+	{
+		// IP address, HW type, Flags, HW address, Mask, Device
+		std::istringstream columns(line);
+		std::string address,type,flags,MAC,mask,device;
+		if( !(columns >> address >> type >> flags >> MAC >> mask >> device) )
+			continue;
+
+		Neighbour neighbour;
+		if( ParseIPv4(address,neighbour.mIPv4) == false )
+			continue;
+
+		const unsigned long flagBits = strtoul(flags.c_str(),nullptr,16);
+		neighbour.mState = (flagBits & ATF_PERM) ? NUD_PERMANENT : ((flagBits & ATF_COM) ? NUD_REACHABLE : NUD_INCOMPLETE);
+		neighbour.mInterfaceIndex = if_nametoindex(device.c_str());
+
+		unsigned int bytes[6];
+		if( sscanf(MAC.c_str(),"%x:%x:%x:%x:%x:%x",&bytes[0],&bytes[1],&bytes[2],&bytes[3],&bytes[4],&bytes[5]) == 6 )
+		{
+			for( int n = 0 ; n < 6 ; n++ )
+			{
+				neighbour.mMAC[n] = (uint8_t)bytes[n];
+			}
+		}
+		rNeighbours.push_back(neighbour);
+	}
+}
+
+std::vector<Neighbour> ReadNeighbourTable()
+{
+	std::vector<Neighbour> neighbours;
+	if( ReadNeighbourTableNetlink(neighbours) == false )
+	{
+		ReadNeighbourTableProc(neighbours);
+	}
+	return neighbours;
+}
+
+void ScanNeighboursIPv4(const IPv4Set& pAddresses,int pProbeWaitMS,bool pResolveNames,std::function<bool(const uint32_t pIPv4,const char* pHostName)> pDeviceFound)
+{
+	if( pDeviceFound == nullptr )
+	{
+		TINYTOOLS_THROW("ScanNeighboursIPv4 passed nullptr for the device found callback");
+	}
+
+	if( pProbeWaitMS > 0 )
+	{
+		// A packet to anything on the local network makes the kernel send an ARP request for it, the answers fill the table.
+		// Nothing has to be listening on the port, the datagram is thrown away, it's the ARP reply we want.
+		const int probe = socket(AF_INET,SOCK_DGRAM|SOCK_NONBLOCK|SOCK_CLOEXEC,0);
+		if( probe < 0 )
+		{
+			TINYTOOLS_THROW("ScanNeighboursIPv4 failed to open the probe socket, " + std::string(strerror(errno)));
+		}
+
+		sockaddr_in address;
+		memset(&address,0,sizeof(address));
+		address.sin_family = AF_INET;
+		address.sin_port = htons(9);// Discard
+		const uint8_t nothing = 0;
+		for( const uint32_t IPv4 : pAddresses )
+		{
+			address.sin_addr.s_addr = IPv4;
+			while( sendto(probe,&nothing,1,0,(const struct sockaddr*)&address,sizeof(address)) < 0 && (errno == EAGAIN || errno == ENOBUFS || errno == EINTR) )
+			{
+				// Send buffer full, wait for some room. Other errors, like no route, mean there is nothing to find so move on.
+				struct pollfd wait = {probe,POLLOUT,0};
+				poll(&wait,1,10);
+			}
+		}
+		close(probe);
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(pProbeWaitMS));
+	}
+
+	for( const auto& neighbour : ReadNeighbourTable() )
+	{
+		if( neighbour.IsAlive() && pAddresses.Contains(neighbour.mIPv4) )
+		{
+			char hbuf[NI_MAXHOST];
+			hbuf[0] = 0;
+			if( pResolveNames )
+			{
+				sockaddr_in deviceIP;
+				memset(&deviceIP, 0, sizeof deviceIP);
+				deviceIP.sin_addr.s_addr = neighbour.mIPv4;
+				deviceIP.sin_family = AF_INET;
+				if( getnameinfo((struct sockaddr*)&deviceIP,sizeof(deviceIP),hbuf,sizeof(hbuf),NULL,0,NI_NAMEREQD) != 0 )
 				{
-					memParts[0].pop_back();
-					keyValues[memParts[0]] = std::stoull(memParts[1]);
+					hbuf[0] = 0;
 				}
 			}
+
+			if( pDeviceFound(neighbour.mIPv4,hbuf) == false )
+			{
+				return;// User asked to end.
+			}
 		}
+	}
+}
 
-		try
+bool IsPortOpen(uint32_t pIPv4,uint16_t pPort)
+{
+	int sockfd = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
+    if (sockfd < 0)
+	{
+		TINYTOOLS_THROW("ERROR opening socket");
+		return false;
+	}
+
+    sockaddr_in deviceAddress;
+	memset(&deviceAddress, 0, sizeof(deviceAddress));
+
+	deviceAddress.sin_addr.s_addr = pIPv4;
+	deviceAddress.sin_port = htons(pPort);
+	deviceAddress.sin_family = AF_INET;
+
+	const bool isOpen = connect(sockfd,(struct sockaddr *) &deviceAddress,sizeof(deviceAddress)) == 0;
+	close(sockfd);
+	return isOpen;
+}
+
+void ScanPorts(const std::vector<PortProbe>& pProbes,int pTimeoutMS,size_t pMaxInFlight,std::function<bool(const PortProbe& pProbe,bool pOpen)> pResult)
+{
+	if( pResult == nullptr )
+	{
+		TINYTOOLS_THROW("ScanPorts passed nullptr for the result callback");
+	}
+
+	pMaxInFlight = std::max<size_t>(1,std::min(pMaxInFlight,pProbes.size()));
+
+	// A slot for each connect in flight, the epoll data is the slot index.
+	// All probes have the same timeout so the order they were started is the order they time out, that's kept in the deque.
+	// A slot can finish and be reused while its old entry is still in the deque, the start count tells them apart.
+	struct Slot
+	{
+		int mSocket = -1;
+		size_t mProbe = 0;
+		uint64_t mStartCount = 0;
+		std::chrono::steady_clock::time_point mDeadline;
+	};
+	std::vector<Slot> slots(pMaxInFlight);
+	std::vector<size_t> freeSlots;
+	for( size_t n = pMaxInFlight ; n > 0 ; n-- )
+	{
+		freeSlots.push_back(n - 1);
+	}
+	std::deque<std::pair<size_t,uint64_t>> startOrder;
+	auto inFlight = [&slots](const std::pair<size_t,uint64_t>& pEntry)
+	{
+		return slots[pEntry.first].mSocket >= 0 && slots[pEntry.first].mStartCount == pEntry.second;
+	};
+	size_t nextProbe = 0;
+	bool keepGoing = true;
+
+	// Closes the socket, frees the slot and tells the user.
+	auto finish = [&](size_t pSlot,bool pOpen)
+	{
+		Slot& slot = slots[pSlot];
+		close(slot.mSocket);// Also removes it from epoll.
+		slot.mSocket = -1;
+		freeSlots.push_back(pSlot);
+		if( keepGoing && pResult(pProbes[slot.mProbe],pOpen) == false )
 		{
-			const size_t Buffers = keyValues.at("Buffers");
-			const size_t Cached = keyValues["Cached"];
-			const size_t SReclaimable = keyValues["SReclaimable"];
-			const size_t MemAvailable = keyValues["MemAvailable"];
-			const size_t MemTotal = keyValues["MemTotal"];
-			const size_t MemFree = keyValues["MemFree"];
-			const size_t SwapFree = keyValues["SwapFree"];
-			const size_t SwapTotal = keyValues["SwapTotal"];
+			keepGoing = false;
+		}
+	};
 
-			const size_t mainCached = Cached + SReclaimable;
-			// if kb_main_available is greater than kb_main_total or our calculation of
-			// mem_used overflows, that's symptomatic of running within a lxc container
-			// where such values will be dramatically distorted over those of the host.
-			if (MemAvailable > MemTotal)
+	std::vector<struct epoll_event> events(pMaxInFlight);
+
+	const int epollFD = epoll_create1(EPOLL_CLOEXEC);
+	if( epollFD < 0 )
+	{
+		TINYTOOLS_THROW("ScanPorts failed to create epoll, " + std::string(strerror(errno)));
+	}
+
+	// Closes what is still in flight, for when we stop early or something throws, the users callback included.
+	auto closeAll = [&]()
+	{
+		for( auto& slot : slots )
+		{
+			if( slot.mSocket >= 0 )
 			{
-				rMemAvailableKB = MemFree;
+				close(slot.mSocket);
+				slot.mSocket = -1;
 			}
-			else
+		}
+		close(epollFD);
+	};
+
+	try
+	{
+		while( keepGoing && (nextProbe < pProbes.size() || freeSlots.size() < slots.size()) )
+		{
+			// Start as many as we're allowed.
+			while( keepGoing && nextProbe < pProbes.size() && freeSlots.size() > 0 )
 			{
-				rMemAvailableKB = MemAvailable;
+				const size_t slotIndex = freeSlots.back();
+				freeSlots.pop_back();
+				Slot& slot = slots[slotIndex];
+				slot.mProbe = nextProbe++;
+				slot.mStartCount++;
+				slot.mSocket = socket(AF_INET, SOCK_STREAM|SOCK_NONBLOCK|SOCK_CLOEXEC, IPPROTO_IP);
+				if( slot.mSocket < 0 )
+				{
+					TINYTOOLS_THROW("ScanPorts failed to open a socket, " + std::string(strerror(errno)));
+				}
+
+				sockaddr_in deviceAddress;
+				memset(&deviceAddress, 0, sizeof(deviceAddress));
+				deviceAddress.sin_addr.s_addr = pProbes[slot.mProbe].mIPv4;
+				deviceAddress.sin_port = htons(pProbes[slot.mProbe].mPort);
+				deviceAddress.sin_family = AF_INET;
+
+				if( connect(slot.mSocket,(struct sockaddr *) &deviceAddress,sizeof(deviceAddress)) == 0 )
+				{// Can happen on loopback.
+					finish(slotIndex,true);
+				}
+				else if( errno == EINPROGRESS )
+				{
+					struct epoll_event event;
+					event.events = EPOLLOUT;
+					event.data.u64 = slotIndex;
+					epoll_ctl(epollFD,EPOLL_CTL_ADD,slot.mSocket,&event);
+					slot.mDeadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(pTimeoutMS);
+					startOrder.emplace_back(slotIndex,slot.mStartCount);
+				}
+				else
+				{
+					finish(slotIndex,false);
+				}
 			}
 
-			rMemoryUsedKB = MemTotal - MemFree - mainCached - Buffers;
-			if (rMemoryUsedKB < 0)
+			// Drop the ones at the front that have already finished, their deadlines no longer matter.
+			while( startOrder.size() > 0 && inFlight(startOrder.front()) == false )
 			{
-				rMemoryUsedKB = MemTotal - MemFree;
+				startOrder.pop_front();
 			}
 
-			rMemTotalKB = MemTotal;
-			rSwapUsedKB = SwapTotal - SwapFree;
+			if( startOrder.size() == 0 )
+				continue;
 
-			return true;
+			const auto now = std::chrono::steady_clock::now();
+			const int waitMS = (int)std::max<int64_t>(0,std::chrono::duration_cast<std::chrono::milliseconds>(slots[startOrder.front().first].mDeadline - now).count() + 1);
+			const int numEvents = epoll_wait(epollFD,events.data(),(int)events.size(),waitMS);
+			if( numEvents < 0 && errno != EINTR )
+			{
+				TINYTOOLS_THROW("ScanPorts epoll_wait failed, " + std::string(strerror(errno)));
+			}
+
+			for( int n = 0 ; n < numEvents ; n++ )
+			{
+				const size_t slotIndex = (size_t)events[n].data.u64;
+				int error = 0;
+				socklen_t errorSize = sizeof(error);
+				getsockopt(slots[slotIndex].mSocket,SOL_SOCKET,SO_ERROR,&error,&errorSize);
+				finish(slotIndex,error == 0);
+			}
+
+			// Then anything that has run out of time, skipping the ones that finished above.
+			const auto afterWait = std::chrono::steady_clock::now();
+			while( startOrder.size() > 0 )
+			{
+				const auto entry = startOrder.front();
+				if( inFlight(entry) && slots[entry.first].mDeadline > afterWait )
+					break;
+
+				startOrder.pop_front();
+				if( inFlight(entry) )
+				{
+					finish(entry.first,false);
+				}
+			}
 		}
-		catch( std::out_of_range& e ){std::cerr << " failed to read all the data needed from /proc/meminfo " << e.what();}// We'll return false so they know something went wrong.
 	}
-	return false;
+	catch(...)
+	{
+		closeAll();
+		throw;
+	}
+
+	// Stopped early, close what is left without telling anyone.
+	closeAll();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The codec kernels.
+// Each kernel only does the whole groups that it can do without reading or writing outside of the buffers passed.
+// It returns how many groups it did and the scalar code then finishes off the rest, so the tail is always done
+// by the scalar code and the output is the same whatever kernel is picked.
+// Encode groups are 7 bytes in and 8 out, decode groups are 8 in and 7 out.
+
+#ifdef TINYTOOLS_X86_SIMD
+__attribute__((target("bmi2")))
+static size_t Encode7BitGroupsBMI2(const uint8_t* pIn,size_t pInSize,uint8_t* pOut,size_t pOutSize)
+{
+    size_t groups = 0;
+    // Loads are 8 bytes, one more than a group, hence the > 7.
+    // Byte swap so the first byte is the most significant, then deposit 7 bits into each output byte.
+    for( ; pInSize > 7 && pOutSize >= 8 ; pInSize -= 7, pOutSize -= 8, pIn += 7, pOut += 8, groups++ )
+    {
+        uint64_t in;
+        memcpy(&in,pIn,8);
+        const uint64_t out = __builtin_bswap64(_pdep_u64(__builtin_bswap64(in) >> 8,0x7f7f7f7f7f7f7f7fULL));
+        memcpy(pOut,&out,8);
+    }
+    return groups;
+}
+
+__attribute__((target("bmi2")))
+static size_t Decode7BitGroupsBMI2(const uint8_t* pIn,size_t pInSize,uint8_t* pOut,size_t pOutSize)
+{
+    size_t groups = 0;
+    // Stores are 8 bytes, one more than a group, hence the >= 8 on the output.
+    for( ; pInSize >= 8 && pOutSize >= 8 ; pInSize -= 8, pOutSize -= 7, pIn += 8, pOut += 7, groups++ )
+    {
+        uint64_t in;
+        memcpy(&in,pIn,8);
+        const uint64_t out = __builtin_bswap64(_pext_u64(__builtin_bswap64(in),0x7f7f7f7f7f7f7f7fULL) << 8);
+        memcpy(pOut,&out,8);
+    }
+    return groups;
+}
+
+// Output byte N of an encode group is the 16 bit word (in[N-1]<<8 | in[N]) shifted down by N+1 and masked to 7 bits.
+// There is no per lane shift in SSE so the word is multiplied up by 1<<(7-N) and the high byte is taken instead.
+// The shuffles build those words, -1 gives a zero byte. Second one is for the group starting at byte 7.
+#define ENCODE_7BIT_SHUFFLE_A    0,-1, 1,0, 2,1, 3,2, 4,3, 5,4, 6,5, -1,6
+#define ENCODE_7BIT_SHUFFLE_B    7,-1, 8,7, 9,8, 10,9, 11,10, 12,11, 13,12, -1,13
+#define ENCODE_7BIT_MULTIPLY     128,64,32,16,8,4,2,1
+
+// Output byte N of a decode group is the 16 bit word (in[N]<<8 | in[N+1]<<1) shifted down by 7-N.
+// Done with a high multiply by 1<<(9+N). The in[N+1]<<1 is made by adding the input to its self.
+// Output byte 7 does not exist, multiplied by zero and then squeezed out by the final shuffle.
+#define DECODE_7BIT_SHUFFLE_LOW_A    1,-1, 2,-1, 3,-1, 4,-1, 5,-1, 6,-1, 7,-1, -1,-1
+#define DECODE_7BIT_SHUFFLE_HIGH_A  -1,0, -1,1, -1,2, -1,3, -1,4, -1,5, -1,6, -1,-1
+#define DECODE_7BIT_SHUFFLE_LOW_B    9,-1, 10,-1, 11,-1, 12,-1, 13,-1, 14,-1, 15,-1, -1,-1
+#define DECODE_7BIT_SHUFFLE_HIGH_B  -1,8, -1,9, -1,10, -1,11, -1,12, -1,13, -1,14, -1,-1
+#define DECODE_7BIT_MULTIPLY        (short)(1<<9),(short)(1<<10),(short)(1<<11),(short)(1<<12),(short)(1<<13),(short)(1<<14),(short)(1<<15),0
+#define DECODE_7BIT_COMPACT         0,1,2,3,4,5,6, 8,9,10,11,12,13,14, -1,-1
+
+__attribute__((target("sse4.1")))
+static size_t Encode7BitGroupsSSE41(const uint8_t* pIn,size_t pInSize,uint8_t* pOut,size_t pOutSize)
+{
+    const __m128i shuffleA = _mm_setr_epi8(ENCODE_7BIT_SHUFFLE_A);
+    const __m128i shuffleB = _mm_setr_epi8(ENCODE_7BIT_SHUFFLE_B);
+    const __m128i multiply = _mm_setr_epi16(ENCODE_7BIT_MULTIPLY);
+    const __m128i mask = _mm_set1_epi16(0x7f);
+
+    size_t groups = 0;
+    // Loads 16 bytes but only uses 14, two groups.
+    for( ; pInSize >= 16 && pOutSize >= 16 ; pInSize -= 14, pOutSize -= 16, pIn += 14, pOut += 16, groups += 2 )
+    {
+        const __m128i in = _mm_loadu_si128((const __m128i*)pIn);
+        const __m128i a = _mm_and_si128(_mm_srli_epi16(_mm_mullo_epi16(_mm_shuffle_epi8(in,shuffleA),multiply),8),mask);
+        const __m128i b = _mm_and_si128(_mm_srli_epi16(_mm_mullo_epi16(_mm_shuffle_epi8(in,shuffleB),multiply),8),mask);
+        _mm_storeu_si128((__m128i*)pOut,_mm_packus_epi16(a,b));
+    }
+    return groups;
+}
+
+__attribute__((target("sse4.1")))
+static size_t Decode7BitGroupsSSE41(const uint8_t* pIn,size_t pInSize,uint8_t* pOut,size_t pOutSize)
+{
+    const __m128i lowA = _mm_setr_epi8(DECODE_7BIT_SHUFFLE_LOW_A);
+    const __m128i highA = _mm_setr_epi8(DECODE_7BIT_SHUFFLE_HIGH_A);
+    const __m128i lowB = _mm_setr_epi8(DECODE_7BIT_SHUFFLE_LOW_B);
+    const __m128i highB = _mm_setr_epi8(DECODE_7BIT_SHUFFLE_HIGH_B);
+    const __m128i multiply = _mm_setr_epi16(DECODE_7BIT_MULTIPLY);
+    const __m128i compact = _mm_setr_epi8(DECODE_7BIT_COMPACT);
+    const __m128i mask = _mm_set1_epi16(0xff);
+
+    size_t groups = 0;
+    // Stores 16 bytes but only 14 are valid, two groups.
+    for( ; pInSize >= 16 && pOutSize >= 16 ; pInSize -= 16, pOutSize -= 14, pIn += 16, pOut += 14, groups += 2 )
+    {
+        const __m128i in = _mm_loadu_si128((const __m128i*)pIn);
+        const __m128i doubled = _mm_add_epi8(in,in);
+        const __m128i a = _mm_or_si128(_mm_shuffle_epi8(doubled,lowA),_mm_shuffle_epi8(in,highA));
+        const __m128i b = _mm_or_si128(_mm_shuffle_epi8(doubled,lowB),_mm_shuffle_epi8(in,highB));
+        const __m128i outA = _mm_and_si128(_mm_mulhi_epu16(a,multiply),mask);
+        const __m128i outB = _mm_and_si128(_mm_mulhi_epu16(b,multiply),mask);
+        _mm_storeu_si128((__m128i*)pOut,_mm_shuffle_epi8(_mm_packus_epi16(outA,outB),compact));
+    }
+    return groups;
+}
+
+__attribute__((target("avx2")))
+static size_t Encode7BitGroupsAVX2(const uint8_t* pIn,size_t pInSize,uint8_t* pOut,size_t pOutSize)
+{
+    const __m256i shuffleA = _mm256_setr_epi8(ENCODE_7BIT_SHUFFLE_A,ENCODE_7BIT_SHUFFLE_A);
+    const __m256i shuffleB = _mm256_setr_epi8(ENCODE_7BIT_SHUFFLE_B,ENCODE_7BIT_SHUFFLE_B);
+    const __m256i multiply = _mm256_setr_epi16(ENCODE_7BIT_MULTIPLY,ENCODE_7BIT_MULTIPLY);
+    const __m256i mask = _mm256_set1_epi16(0x7f);
+
+    size_t groups = 0;
+    // Same as the SSE version but each lane is loaded 14 bytes apart, four groups per loop.
+    // The pack interleaves the lanes so the groups come out in the right order.
+    for( ; pInSize >= 30 && pOutSize >= 32 ; pInSize -= 28, pOutSize -= 32, pIn += 28, pOut += 32, groups += 4 )
+    {
+        const __m256i in = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)pIn)),_mm_loadu_si128((const __m128i*)(pIn + 14)),1);
+        const __m256i a = _mm256_and_si256(_mm256_srli_epi16(_mm256_mullo_epi16(_mm256_shuffle_epi8(in,shuffleA),multiply),8),mask);
+        const __m256i b = _mm256_and_si256(_mm256_srli_epi16(_mm256_mullo_epi16(_mm256_shuffle_epi8(in,shuffleB),multiply),8),mask);
+        _mm256_storeu_si256((__m256i*)pOut,_mm256_packus_epi16(a,b));
+    }
+    return groups;
+}
+
+__attribute__((target("avx2")))
+static size_t Decode7BitGroupsAVX2(const uint8_t* pIn,size_t pInSize,uint8_t* pOut,size_t pOutSize)
+{
+    const __m256i lowA = _mm256_setr_epi8(DECODE_7BIT_SHUFFLE_LOW_A,DECODE_7BIT_SHUFFLE_LOW_A);
+    const __m256i highA = _mm256_setr_epi8(DECODE_7BIT_SHUFFLE_HIGH_A,DECODE_7BIT_SHUFFLE_HIGH_A);
+    const __m256i lowB = _mm256_setr_epi8(DECODE_7BIT_SHUFFLE_LOW_B,DECODE_7BIT_SHUFFLE_LOW_B);
+    const __m256i highB = _mm256_setr_epi8(DECODE_7BIT_SHUFFLE_HIGH_B,DECODE_7BIT_SHUFFLE_HIGH_B);
+    const __m256i multiply = _mm256_setr_epi16(DECODE_7BIT_MULTIPLY,DECODE_7BIT_MULTIPLY);
+    const __m256i compact = _mm256_setr_epi8(DECODE_7BIT_COMPACT,DECODE_7BIT_COMPACT);
+    const __m256i mask = _mm256_set1_epi16(0xff);
+
+    size_t groups = 0;
+    // Each lane ends up with 14 valid bytes, so the lanes are stored separately, the second over writing the junk of the first.
+    for( ; pInSize >= 32 && pOutSize >= 30 ; pInSize -= 32, pOutSize -= 28, pIn += 32, pOut += 28, groups += 4 )
+    {
+        const __m256i in = _mm256_loadu_si256((const __m256i*)pIn);
+        const __m256i doubled = _mm256_add_epi8(in,in);
+        const __m256i a = _mm256_or_si256(_mm256_shuffle_epi8(doubled,lowA),_mm256_shuffle_epi8(in,highA));
+        const __m256i b = _mm256_or_si256(_mm256_shuffle_epi8(doubled,lowB),_mm256_shuffle_epi8(in,highB));
+        const __m256i outA = _mm256_and_si256(_mm256_mulhi_epu16(a,multiply),mask);
+        const __m256i outB = _mm256_and_si256(_mm256_mulhi_epu16(b,multiply),mask);
+        const __m256i out = _mm256_shuffle_epi8(_mm256_packus_epi16(outA,outB),compact);
+        _mm_storeu_si128((__m128i*)pOut,_mm256_castsi256_si128(out));
+        _mm_storeu_si128((__m128i*)(pOut + 14),_mm256_extracti128_si256(out,1));
+    }
+    return groups;
+}
+
+#undef ENCODE_7BIT_SHUFFLE_A
+#undef ENCODE_7BIT_SHUFFLE_B
+#undef ENCODE_7BIT_MULTIPLY
+#undef DECODE_7BIT_SHUFFLE_LOW_A
+#undef DECODE_7BIT_SHUFFLE_HIGH_A
+#undef DECODE_7BIT_SHUFFLE_LOW_B
+#undef DECODE_7BIT_SHUFFLE_HIGH_B
+#undef DECODE_7BIT_MULTIPLY
+#undef DECODE_7BIT_COMPACT
+#endif //#ifdef TINYTOOLS_X86_SIMD
+
+static CodecKernel GetBestCodecKernel()
+{
+    // In order of preference. BMI2 last as pdep / pext are micro coded on some AMD parts and very slow.
+    for( CodecKernel kernel : {CodecKernel::AVX2,CodecKernel::SSE41,CodecKernel::BMI2} )
+    {
+        if( IsCodecKernelSupported(kernel) )
+            return kernel;
+    }
+    return CodecKernel::SCALAR;
+}
+
+static std::atomic<CodecKernel>& CurrentCodecKernel()
+{
+    // Function static so it's safe to use the codecs from other static constructors.
+    static std::atomic<CodecKernel> kernel(GetBestCodecKernel());
+    return kernel;
+}
+
+bool IsCodecKernelSupported(CodecKernel pKernel)
+{
+#ifdef TINYTOOLS_X86_SIMD
+    __builtin_cpu_init();
+    switch( pKernel )
+    {
+    case CodecKernel::SCALAR:
+        return true;
+
+    case CodecKernel::BMI2:
+        return __builtin_cpu_supports("bmi2");
+
+    case CodecKernel::SSE41:
+        return __builtin_cpu_supports("sse4.1");
+
+    case CodecKernel::AVX2:
+        return __builtin_cpu_supports("avx2");
+    }
+    return false;
+#else
+    return pKernel == CodecKernel::SCALAR;
+#endif
+}
+
+CodecKernel GetCodecKernel()
+{
+    return CurrentCodecKernel().load(std::memory_order_relaxed);
+}
+
+bool SetCodecKernel(CodecKernel pKernel)
+{
+    if( IsCodecKernelSupported(pKernel) == false )
+        return false;
+
+    CurrentCodecKernel().store(pKernel,std::memory_order_relaxed);
+    return true;
+}
+
+static size_t Encode7BitGroups(const uint8_t* pIn,size_t pInSize,uint8_t* pOut,size_t pOutSize)
+{
+#ifdef TINYTOOLS_X86_SIMD
+    switch( GetCodecKernel() )
+    {
+    case CodecKernel::SCALAR:
+        break;
+
+    case CodecKernel::BMI2:
+        return Encode7BitGroupsBMI2(pIn,pInSize,pOut,pOutSize);
+
+    case CodecKernel::SSE41:
+        return Encode7BitGroupsSSE41(pIn,pInSize,pOut,pOutSize);
+
+    case CodecKernel::AVX2:
+        return Encode7BitGroupsAVX2(pIn,pInSize,pOut,pOutSize);
+    }
+#endif
+    return 0;
+}
+
+static size_t Decode7BitGroups(const uint8_t* pIn,size_t pInSize,uint8_t* pOut,size_t pOutSize)
+{
+#ifdef TINYTOOLS_X86_SIMD
+    switch( GetCodecKernel() )
+    {
+    case CodecKernel::SCALAR:
+        break;
+
+    case CodecKernel::BMI2:
+        return Decode7BitGroupsBMI2(pIn,pInSize,pOut,pOutSize);
+
+    case CodecKernel::SSE41:
+        return Decode7BitGroupsSSE41(pIn,pInSize,pOut,pOutSize);
+
+    case CodecKernel::AVX2:
+        return Decode7BitGroupsAVX2(pIn,pInSize,pOut,pOutSize);
+    }
+#endif
+    return 0;
+}
+
+size_t Encode7Bit(const uint8_t* p8Bit,size_t p8BitSize,uint8_t** r7Bit)
+{
+    *r7Bit = new uint8_t[Encoded7BitSize(p8BitSize)];
+    return Encode7Bit(p8Bit,p8BitSize,*r7Bit,Encoded7BitSize(p8BitSize));
+}
+
+size_t Encode7Bit(const uint8_t* p8Bit,size_t p8BitSize,uint8_t* r7Bit,size_t p7BitBufferSize)
+{
+    const size_t newSize = Encoded7BitSize(p8BitSize);
+    if( newSize > p7BitBufferSize )
+    {
+        TINYTOOLS_THROW("Encode7Bit output buffer is too small, needs " + std::to_string(newSize) + " bytes but was given " + std::to_string(p7BitBufferSize));
+    }
+
+    uint8_t* out = r7Bit;
+
+    // Let the SIMD kernel do as much as it can, then the code below picks up where it left off.
+    const size_t simdGroups = Encode7BitGroups(p8Bit,p8BitSize,out,newSize);
+    p8BitSize -= simdGroups * 7;
+    p8Bit += simdGroups * 7;
+    out += simdGroups * 8;
+
+    for( ; p8BitSize > 6 ; p8BitSize -=7 , out += 8, p8Bit += 7 )
+    {
+        assert( out + 7 < r7Bit + newSize );
+        out[0] = (                        (p8Bit[0]>>1) );
+        out[1] = ( ((p8Bit[0]&0x01)<<6) | (p8Bit[1]>>2) );
+        out[2] = ( ((p8Bit[1]&0x03)<<5) | (p8Bit[2]>>3) );
+        out[3] = ( ((p8Bit[2]&0x07)<<4) | (p8Bit[3]>>4) );
+        out[4] = ( ((p8Bit[3]&0x0F)<<3) | (p8Bit[4]>>5) );
+        out[5] = ( ((p8Bit[4]&0x1F)<<2) | (p8Bit[5]>>6) );
+        out[6] = ( ((p8Bit[5]&0x3F)<<1) | (p8Bit[6]>>7) );
+        out[7] = ( ((p8Bit[6]&0x7F)<<0) );        
+    }
+
+    // And now for the trailing bytes.
+    // Read from the zero padded copy, reading p8Bit here would go past the end of the input.
+    assert( p8BitSize < 7 );
+    if( p8BitSize > 0 )
+    {
+        uint8_t padding[6] = {0,0,0,0,0,0};
+        for( size_t n = 0 ; n < p8BitSize ; n++ )
+        {
+            padding[n] = p8Bit[n];
+        }
+
+        *out = (                          (padding[0]>>1) ); out++;
+        *out = ( ((padding[0]&0x01)<<6) | (padding[1]>>2) ); out++;
+        if( p8BitSize > 1 )
+        {
+            *out = ( ((padding[1]&0x03)<<5) | (padding[2]>>3) ); out++;
+            if( p8BitSize > 2 )
+            {
+                *out = ( ((padding[2]&0x07)<<4) | (padding[3]>>4) ); out++;
+                if( p8BitSize > 3 )
+                {
+                    *out = ( ((padding[3]&0x0F)<<3) | (padding[4]>>5) ); out++;
+                    if( p8BitSize > 4 )
+                    {
+                        *out = ( ((padding[4]&0x1F)<<2) | (padding[5]>>6) ); out++;
+                        if( p8BitSize > 5 )
+                        {
+                            *out = ((padding[5]&0x3F)<<1); out++;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    assert( out == r7Bit + newSize );
+
+    return newSize;
+}
+
+size_t Decode7Bit(const uint8_t* p7Bit,size_t p7BitSize,uint8_t** r8Bit)
+{
+    *r8Bit = new uint8_t[Decoded7BitSize(p7BitSize)];
+    return Decode7Bit(p7Bit,p7BitSize,*r8Bit,Decoded7BitSize(p7BitSize));
+}
+
+size_t Decode7Bit(const uint8_t* p7Bit,size_t p7BitSize,uint8_t* r8Bit,size_t p8BitBufferSize)
+{
+    const size_t newSize = Decoded7BitSize(p7BitSize);
+    if( newSize > p8BitBufferSize )
+    {
+        TINYTOOLS_THROW("Decode7Bit output buffer is too small, needs " + std::to_string(newSize) + " bytes but was given " + std::to_string(p8BitBufferSize));
+    }
+
+    uint8_t* out = r8Bit;
+
+    const size_t simdGroups = Decode7BitGroups(p7Bit,p7BitSize,out,newSize);
+    p7BitSize -= simdGroups * 8;
+    p7Bit += simdGroups * 8;
+    out += simdGroups * 7;
+
+    for( ; p7BitSize > 7 ; p7BitSize -= 8, p7Bit += 8, out += 7 )
+    {
+        assert( out + 6 < r8Bit + newSize );
+        out[0] = ( p7Bit[0] << 1 | (p7Bit[1]>>6));
+        out[1] = ( p7Bit[1] << 2 | (p7Bit[2]>>5));
+        out[2] = ( p7Bit[2] << 3 | (p7Bit[3]>>4));
+        out[3] = ( p7Bit[3] << 4 | (p7Bit[4]>>3));
+        out[4] = ( p7Bit[4] << 5 | (p7Bit[5]>>2));
+        out[5] = ( p7Bit[5] << 6 | (p7Bit[6]>>1));
+        out[6] = ( p7Bit[6] << 7 | (p7Bit[7]>>0));
+    }
+
+    // A single trailing byte only holds 7 bits, not enough for a whole byte, so is ignored. Reading p7Bit[1] for it would go past the end.
+    if( p7BitSize > 1 )
+    {
+        *out = ( p7Bit[0] << 1 | (p7Bit[1]>>6)); out++;
+        if( p7BitSize > 2 )
+        {
+            *out = ( p7Bit[1] << 2 | (p7Bit[2]>>5)); out++;
+            if( p7BitSize > 3 )
+            {
+                *out = ( p7Bit[2] << 3 | (p7Bit[3]>>4)); out++;
+                if( p7BitSize > 4 )
+                {
+                    *out = ( p7Bit[3] << 4 | (p7Bit[4]>>3)); out++;
+                    if( p7BitSize > 5 )
+                    {
+                        *out = ( p7Bit[4] << 5 | (p7Bit[5]>>2)); out++;
+                        if( p7BitSize > 6 )
+                        {
+                            *out = ( p7Bit[5] << 6 | (p7Bit[6]>>1)); out++;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    assert( out == r8Bit + newSize );
+
+    return newSize;
+}
+
+/**
+ * @brief Splits the input on group boundaries and runs pCodec on each chunk, one chunk per thread.
+ * The last chunk gets the trailing partial group, if there is one.
+ */
+static size_t Run7BitParallel(size_t (*pCodec)(const uint8_t*,size_t,uint8_t*,size_t),
+                        size_t pInGroupSize,size_t pOutGroupSize,
+                        const uint8_t* pIn,size_t pInSize,uint8_t* pOut,size_t pOutSize,size_t pOutTotal,
+                        size_t pNumThreads)
+{
+    if( pOutTotal > pOutSize )
+    {
+        TINYTOOLS_THROW("7 bit parallel codec output buffer is too small, needs " + std::to_string(pOutTotal) + " bytes but was given " + std::to_string(pOutSize));
+    }
+
+    const size_t totalGroups = pInSize / pInGroupSize;
+    const size_t groupsPerThread = (totalGroups + pNumThreads - 1) / pNumThreads;
+
+    std::vector<std::thread> workers;
+    workers.reserve(pNumThreads);
+    for( size_t firstGroup = 0 ; firstGroup < totalGroups ; firstGroup += groupsPerThread )
+    {
+        const uint8_t* in = pIn + (firstGroup * pInGroupSize);
+        uint8_t* out = pOut + (firstGroup * pOutGroupSize);
+        const bool lastChunk = firstGroup + groupsPerThread >= totalGroups;
+        const size_t inSize = lastChunk ? pInSize - (firstGroup * pInGroupSize) : groupsPerThread * pInGroupSize;
+        // Must be exact, the SIMD kernels use any slack at the end of the output and that belongs to the next thread.
+        const size_t outSize = lastChunk ? pOutTotal - (firstGroup * pOutGroupSize) : groupsPerThread * pOutGroupSize;
+
+        if( lastChunk )
+        {// The calling thread does the last one, it's the only one with a tail so it may be a little longer.
+            pCodec(in,inSize,out,outSize);
+        }
+        else
+        {
+            workers.emplace_back([pCodec,in,inSize,out,outSize](){pCodec(in,inSize,out,outSize);});
+        }
+    }
+
+    for( auto& worker : workers )
+    {
+        worker.join();
+    }
+
+    return pOutTotal;
+}
+
+static size_t GetNumParallelThreads(size_t pNumThreads)
+{
+    if( pNumThreads == 0 )
+    {
+        pNumThreads = std::thread::hardware_concurrency();
+    }
+    return std::max<size_t>(pNumThreads,1);
+}
+
+size_t Encode7BitParallel(const uint8_t* p8Bit,size_t p8BitSize,uint8_t* r7Bit,size_t p7BitBufferSize,size_t pNumThreads,size_t pThreshold)
+{
+    pNumThreads = GetNumParallelThreads(pNumThreads);
+    if( p8BitSize < pThreshold || p8BitSize < 7 || pNumThreads == 1 )
+    {
+        return Encode7Bit(p8Bit,p8BitSize,r7Bit,p7BitBufferSize);
+    }
+
+    size_t (*encode)(const uint8_t*,size_t,uint8_t*,size_t) = Encode7Bit;
+    return Run7BitParallel(encode,7,8,p8Bit,p8BitSize,r7Bit,p7BitBufferSize,Encoded7BitSize(p8BitSize),pNumThreads);
+}
+
+size_t Decode7BitParallel(const uint8_t* p7Bit,size_t p7BitSize,uint8_t* r8Bit,size_t p8BitBufferSize,size_t pNumThreads,size_t pThreshold)
+{
+    pNumThreads = GetNumParallelThreads(pNumThreads);
+    if( p7BitSize < pThreshold || p7BitSize < 8 || pNumThreads == 1 )
+    {
+        return Decode7Bit(p7Bit,p7BitSize,r8Bit,p8BitBufferSize);
+    }
+
+    size_t (*decode)(const uint8_t*,size_t,uint8_t*,size_t) = Decode7Bit;
+    return Run7BitParallel(decode,8,7,p7Bit,p7BitSize,r8Bit,p8BitBufferSize,Decoded7BitSize(p7BitSize),pNumThreads);
+}
+
+/**
+ * @brief The tables for the slice by 8 CRC32C, built at compile time.
+ * Table 0 is the normal byte at a time table, table N is the CRC of a byte followed by N zero bytes.
+ */
+struct Crc32cTables
+{
+    uint32_t mTable[8][256];
+
+    constexpr Crc32cTables():mTable()
+    {
+        const uint32_t polynomial = 0x82f63b78;// Reversed Castagnoli polynomial.
+        for( uint32_t n = 0 ; n < 256 ; n++ )
+        {
+            uint32_t crc = n;
+            for( int bit = 0 ; bit < 8 ; bit++ )
+            {
+                crc = (crc & 1) ? (crc >> 1) ^ polynomial : crc >> 1;
+            }
+            mTable[0][n] = crc;
+        }
+
+        for( uint32_t n = 0 ; n < 256 ; n++ )
+        {
+            for( int t = 1 ; t < 8 ; t++ )
+            {
+                mTable[t][n] = (mTable[t-1][n] >> 8) ^ mTable[0][mTable[t-1][n] & 0xff];
+            }
+        }
+    }
+};
+
+static constexpr Crc32cTables CRC32C_TABLES;
+
+static bool HasCrc32cInstruction()
+{
+#ifdef TINYTOOLS_X86_SIMD
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.2");
+#else
+    return false;
+#endif
+}
+
+static std::atomic<bool>& UseCrc32cInstruction()
+{
+    // Function static for the same reason as CurrentCodecKernel.
+    static std::atomic<bool> use(HasCrc32cInstruction());
+    return use;
+}
+
+bool SetCrc32cHardware(bool pUseHardware)
+{
+    if( pUseHardware && HasCrc32cInstruction() == false )
+        return false;
+
+    UseCrc32cInstruction() = pUseHardware;
+    return true;
+}
+
+static uint32_t Crc32cSliceBy8(const uint8_t* pData,size_t pSize,uint32_t pCrc)
+{
+    const auto& t = CRC32C_TABLES.mTable;
+    for( ; pSize >= 8 ; pSize -= 8, pData += 8 )
+    {
+        uint32_t low,high;
+        memcpy(&low,pData,4);
+        memcpy(&high,pData + 4,4);
+        low ^= pCrc;
+        pCrc =  t[7][low & 0xff] ^ t[6][(low >> 8) & 0xff] ^ t[5][(low >> 16) & 0xff] ^ t[4][low >> 24] ^
+                t[3][high & 0xff] ^ t[2][(high >> 8) & 0xff] ^ t[1][(high >> 16) & 0xff] ^ t[0][high >> 24];
+    }
+
+    for( ; pSize > 0 ; pSize--, pData++ )
+    {
+        pCrc = (pCrc >> 8) ^ t[0][(pCrc ^ *pData) & 0xff];
+    }
+    return pCrc;
+}
+
+#ifdef TINYTOOLS_X86_SIMD
+__attribute__((target("sse4.2")))
+static uint32_t Crc32cSSE42(const uint8_t* pData,size_t pSize,uint32_t pCrc)
+{
+#ifdef __x86_64__
+    uint64_t crc = pCrc;
+    for( ; pSize >= 8 ; pSize -= 8, pData += 8 )
+    {
+        uint64_t value;
+        memcpy(&value,pData,8);
+        crc = _mm_crc32_u64(crc,value);
+    }
+    pCrc = (uint32_t)crc;
+#endif
+    for( ; pSize >= 4 ; pSize -= 4, pData += 4 )
+    {
+        uint32_t value;
+        memcpy(&value,pData,4);
+        pCrc = _mm_crc32_u32(pCrc,value);
+    }
+
+    for( ; pSize > 0 ; pSize--, pData++ )
+    {
+        pCrc = _mm_crc32_u8(pCrc,*pData);
+    }
+    return pCrc;
+}
+#endif //#ifdef TINYTOOLS_X86_SIMD
+
+uint32_t Crc32c(const void* pData,size_t pSize,uint32_t pCrc)
+{
+    // The CRC is inverted at the start and end, doing it here means the result can be passed straight back in to carry on.
+    pCrc = ~pCrc;
+#ifdef TINYTOOLS_X86_SIMD
+    if( UseCrc32cInstruction().load(std::memory_order_relaxed) )
+    {
+        return ~Crc32cSSE42((const uint8_t*)pData,pSize,pCrc);
+    }
+#endif
+    return ~Crc32cSliceBy8((const uint8_t*)pData,pSize,pCrc);
+}
+
+// The fused versions work in blocks that fit in the L1 cache. Each block is two passes, the codec then the CRC,
+// but the CRC reads what the codec has just pulled in so the 8 bit data only comes from memory once.
+// A multiple of 7 * 8 so every block but the last is whole groups for both encode and decode.
+static const size_t CRC_CODEC_BLOCK_SIZE = 7 * 8 * 64;
+
+size_t Encode7BitCrc32c(const uint8_t* p8Bit,size_t p8BitSize,uint8_t* r7Bit,size_t p7BitBufferSize,uint32_t& rCrc)
+{
+    const size_t newSize = Encoded7BitSize(p8BitSize);
+    if( newSize > p7BitBufferSize )
+    {
+        TINYTOOLS_THROW("Encode7BitCrc32c output buffer is too small, needs " + std::to_string(newSize) + " bytes but was given " + std::to_string(p7BitBufferSize));
+    }
+
+    uint8_t* out = r7Bit;
+    while( p8BitSize > 0 )
+    {
+        const size_t block = std::min(p8BitSize,CRC_CODEC_BLOCK_SIZE);
+        out += Encode7Bit(p8Bit,block,out,Encoded7BitSize(block));
+        rCrc = Crc32c(p8Bit,block,rCrc);
+        p8Bit += block;
+        p8BitSize -= block;
+    }
+    return newSize;
+}
+
+size_t Decode7BitCrc32c(const uint8_t* p7Bit,size_t p7BitSize,uint8_t* r8Bit,size_t p8BitBufferSize,uint32_t& rCrc)
+{
+    const size_t newSize = Decoded7BitSize(p7BitSize);
+    if( newSize > p8BitBufferSize )
+    {
+        TINYTOOLS_THROW("Decode7BitCrc32c output buffer is too small, needs " + std::to_string(newSize) + " bytes but was given " + std::to_string(p8BitBufferSize));
+    }
+
+    uint8_t* out = r8Bit;
+    while( p7BitSize > 0 )
+    {
+        const size_t block = std::min(p7BitSize,CRC_CODEC_BLOCK_SIZE);
+        const size_t decoded = Decode7Bit(p7Bit,block,out,Decoded7BitSize(block));
+        rCrc = Crc32c(out,decoded,rCrc);
+        out += decoded;
+        p7Bit += block;
+        p7BitSize -= block;
+    }
+    return newSize;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Base64 and hex.
+// Like the 7 bit codec the SIMD kernels only do the blocks they can do safely and return how much they did,
+// the scalar code does the rest. The decode kernels also stop at the first bad character and leave it to the
+// scalar code to throw the error.
+static const char BASE64_STANDARD_CHARS[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+static const char BASE64_URL_SAFE_CHARS[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+/**
+ * @brief Maps a character back to its 6 bit value, -1 if it is not in the alphabet.
+ */
+struct Base64DecodeTable
+{
+    int8_t mValue[256];
+
+    constexpr Base64DecodeTable(const char* pChars):mValue()
+    {
+        for( int n = 0 ; n < 256 ; n++ )
+        {
+            mValue[n] = -1;
+        }
+        for( int n = 0 ; n < 64 ; n++ )
+        {
+            mValue[(uint8_t)pChars[n]] = (int8_t)n;
+        }
+    }
+};
+
+static constexpr Base64DecodeTable BASE64_STANDARD_DECODE(BASE64_STANDARD_CHARS);
+static constexpr Base64DecodeTable BASE64_URL_SAFE_DECODE(BASE64_URL_SAFE_CHARS);
+
+#ifdef TINYTOOLS_X86_SIMD
+// The base64 kernels are the SSE / AVX2 methods by Wojciech Mula and Daniel Lemire.
+// http://0x80.pl/notesen/2016-01-12-sse-base64-encoding.html
+// http://0x80.pl/notesen/2016-01-17-sse-base64-decoding.html
+
+// Splits 12 bytes into 16 six bit values, one per byte. Shuffle to get each 3 bytes into a 32 bit lane then multiply them into place.
+#define BASE64_ENCODE_SHUFFLE   1,0,2,1, 4,3,5,4, 7,6,8,7, 10,9,11,10
+// Six bit value to ascii. The value is turned into an index of an offset that is then added to it.
+#define BASE64_ENCODE_OFFSETS(PLUS__,SLASH__)   'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, PLUS__ - 62, SLASH__ - 63, 'A', 0, 0
+// Puts 12 bytes back together from 16 six bit values.
+#define BASE64_DECODE_SHUFFLE   2,1,0, 6,5,4, 10,9,8, 14,13,12, -1,-1,-1,-1
+
+__attribute__((target("sse4.1")))
+static inline __m128i Base64EncodeSSE41(__m128i pIn,__m128i pShuffle,__m128i pOffsets)
+{
+    const __m128i in = _mm_shuffle_epi8(pIn,pShuffle);
+    const __m128i t0 = _mm_mulhi_epu16(_mm_and_si128(in,_mm_set1_epi32(0x0fc0fc00)),_mm_set1_epi32(0x04000040));
+    const __m128i t1 = _mm_mullo_epi16(_mm_and_si128(in,_mm_set1_epi32(0x003f03f0)),_mm_set1_epi32(0x01000010));
+    const __m128i values = _mm_or_si128(t0,t1);
+
+    __m128i index = _mm_subs_epu8(values,_mm_set1_epi8(51));
+    index = _mm_or_si128(index,_mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26),values),_mm_set1_epi8(13)));
+    return _mm_add_epi8(values,_mm_shuffle_epi8(pOffsets,index));
+}
+
+__attribute__((target("sse4.1")))
+static size_t EncodeBase64SSE41(const uint8_t* pIn,size_t pInSize,char* pOut,bool pURLSafe)
+{
+    const __m128i shuffle = _mm_setr_epi8(BASE64_ENCODE_SHUFFLE);
+    const __m128i offsets = pURLSafe ? _mm_setr_epi8(BASE64_ENCODE_OFFSETS('-','_')) : _mm_setr_epi8(BASE64_ENCODE_OFFSETS('+','/'));
+
+    size_t done = 0;
+    // Loads 16 bytes but only uses 12.
+    for( ; pInSize - done >= 16 ; done += 12, pOut += 16 )
+    {
+        _mm_storeu_si128((__m128i*)pOut,Base64EncodeSSE41(_mm_loadu_si128((const __m128i*)(pIn + done)),shuffle,offsets));
+    }
+    return done;
+}
+
+__attribute__((target("avx2")))
+static size_t EncodeBase64AVX2(const uint8_t* pIn,size_t pInSize,char* pOut,bool pURLSafe)
+{
+    const __m256i shuffle = _mm256_setr_epi8(BASE64_ENCODE_SHUFFLE,BASE64_ENCODE_SHUFFLE);
+    const __m256i offsets = pURLSafe ? _mm256_setr_epi8(BASE64_ENCODE_OFFSETS('-','_'),BASE64_ENCODE_OFFSETS('-','_')) : _mm256_setr_epi8(BASE64_ENCODE_OFFSETS('+','/'),BASE64_ENCODE_OFFSETS('+','/'));
+
+    size_t done = 0;
+    // Each lane loaded 12 bytes apart.
+    for( ; pInSize - done >= 28 ; done += 24, pOut += 32 )
+    {
+        const __m256i in = _mm256_shuffle_epi8(_mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(pIn + done))),_mm_loadu_si128((const __m128i*)(pIn + done + 12)),1),shuffle);
+        const __m256i t0 = _mm256_mulhi_epu16(_mm256_and_si256(in,_mm256_set1_epi32(0x0fc0fc00)),_mm256_set1_epi32(0x04000040));
+        const __m256i t1 = _mm256_mullo_epi16(_mm256_and_si256(in,_mm256_set1_epi32(0x003f03f0)),_mm256_set1_epi32(0x01000010));
+        const __m256i values = _mm256_or_si256(t0,t1);
+
+        __m256i index = _mm256_subs_epu8(values,_mm256_set1_epi8(51));
+        index = _mm256_or_si256(index,_mm256_and_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(26),values),_mm256_set1_epi8(13)));
+        _mm256_storeu_si256((__m256i*)pOut,_mm256_add_epi8(values,_mm256_shuffle_epi8(offsets,index)));
+    }
+    return done;
+}
+
+/**
+ * @brief The look up tables for the decode, indexed by the high nibble of the character.
+ * Valid characters are those between the lower and upper bound for their high nibble, plus one special character, / or _,
+ * that has a range all of its own. The shift takes the character to its six bit value.
+ */
+#define BASE64_DECODE_LOWER(PLUS__)  1,1,PLUS__,0x30,0x41,0x50,0x61,0x70,1,1,1,1,1,1,1,1
+#define BASE64_DECODE_UPPER(PLUS__)  0,0,PLUS__,0x39,0x4f,0x5a,0x6f,0x7a,0,0,0,0,0,0,0,0
+#define BASE64_DECODE_SHIFT(PLUS__)  0,0,(char)(0x3e - PLUS__),(char)(0x34 - 0x30),(char)(0x00 - 0x41),(char)(0x0f - 0x50),(char)(0x1a - 0x61),(char)(0x29 - 0x70),0,0,0,0,0,0,0,0
+
+struct Base64DecodeConstants
+{
+    char mPlus;         //!< The character for 62. Has a range of its own in the tables.
+    char mSlash;        //!< The character for 63. Handled with a compare.
+    char mSlashFix;     //!< What to add to mSlash after the shift for its high nibble to get 63.
+};
+
+static const Base64DecodeConstants BASE64_STANDARD_DECODE_CONSTANTS = {'+','/',(char)(0x3f - (0x2f + 0x3e - '+'))};
+static const Base64DecodeConstants BASE64_URL_SAFE_DECODE_CONSTANTS = {'-','_',(char)(0x3f - (0x5f + 0x0f - 0x50))};
+
+__attribute__((target("sse4.1")))
+static size_t DecodeBase64SSE41(const char* pIn,size_t pInSize,uint8_t* pOut,size_t pOutSize,const Base64DecodeConstants& pConstants)
+{
+    const __m128i lower = _mm_setr_epi8(BASE64_DECODE_LOWER(pConstants.mPlus));
+    const __m128i upper = _mm_setr_epi8(BASE64_DECODE_UPPER(pConstants.mPlus));
+    const __m128i shift = _mm_setr_epi8(BASE64_DECODE_SHIFT(pConstants.mPlus));
+    const __m128i slash = _mm_set1_epi8(pConstants.mSlash);
+    const __m128i slashFix = _mm_set1_epi8(pConstants.mSlashFix);
+    const __m128i pack = _mm_setr_epi8(BASE64_DECODE_SHUFFLE);
+
+    size_t done = 0;
+    // Stores 16 bytes but only 12 are valid.
+    for( ; pInSize - done >= 16 && pOutSize >= 16 ; done += 16, pOut += 12, pOutSize -= 12 )
+    {
+        const __m128i in = _mm_loadu_si128((const __m128i*)(pIn + done));
+        const __m128i highNibble = _mm_and_si128(_mm_srli_epi32(in,4),_mm_set1_epi8(0x0f));
+        const __m128i isSlash = _mm_cmpeq_epi8(in,slash);
+        const __m128i outside = _mm_or_si128(_mm_cmplt_epi8(in,_mm_shuffle_epi8(lower,highNibble)),_mm_cmpgt_epi8(in,_mm_shuffle_epi8(upper,highNibble)));
+        if( _mm_movemask_epi8(_mm_andnot_si128(isSlash,outside)) != 0 )
+        {
+            break;
+        }
+
+        __m128i values = _mm_add_epi8(in,_mm_shuffle_epi8(shift,highNibble));
+        values = _mm_add_epi8(values,_mm_and_si128(isSlash,slashFix));
+
+        const __m128i merged = _mm_madd_epi16(_mm_maddubs_epi16(values,_mm_set1_epi32(0x01400140)),_mm_set1_epi32(0x00011000));
+        _mm_storeu_si128((__m128i*)pOut,_mm_shuffle_epi8(merged,pack));
+    }
+    return done;
+}
+
+__attribute__((target("avx2")))
+static size_t DecodeBase64AVX2(const char* pIn,size_t pInSize,uint8_t* pOut,size_t pOutSize,const Base64DecodeConstants& pConstants)
+{
+    const __m256i lower = _mm256_setr_epi8(BASE64_DECODE_LOWER(pConstants.mPlus),BASE64_DECODE_LOWER(pConstants.mPlus));
+    const __m256i upper = _mm256_setr_epi8(BASE64_DECODE_UPPER(pConstants.mPlus),BASE64_DECODE_UPPER(pConstants.mPlus));
+    const __m256i shift = _mm256_setr_epi8(BASE64_DECODE_SHIFT(pConstants.mPlus),BASE64_DECODE_SHIFT(pConstants.mPlus));
+    const __m256i slash = _mm256_set1_epi8(pConstants.mSlash);
+    const __m256i slashFix = _mm256_set1_epi8(pConstants.mSlashFix);
+    const __m256i pack = _mm256_setr_epi8(BASE64_DECODE_SHUFFLE,BASE64_DECODE_SHUFFLE);
+
+    size_t done = 0;
+    // Each lane gives 12 valid bytes, stored separately, the second over writing the junk of the first.
+    for( ; pInSize - done >= 32 && pOutSize >= 28 ; done += 32, pOut += 24, pOutSize -= 24 )
+    {
+        const __m256i in = _mm256_loadu_si256((const __m256i*)(pIn + done));
+        const __m256i highNibble = _mm256_and_si256(_mm256_srli_epi32(in,4),_mm256_set1_epi8(0x0f));
+        const __m256i isSlash = _mm256_cmpeq_epi8(in,slash);
+        const __m256i outside = _mm256_or_si256(_mm256_cmpgt_epi8(_mm256_shuffle_epi8(lower,highNibble),in),_mm256_cmpgt_epi8(in,_mm256_shuffle_epi8(upper,highNibble)));
+        if( _mm256_movemask_epi8(_mm256_andnot_si256(isSlash,outside)) != 0 )
+        {
+            break;
+        }
+
+        __m256i values = _mm256_add_epi8(in,_mm256_shuffle_epi8(shift,highNibble));
+        values = _mm256_add_epi8(values,_mm256_and_si256(isSlash,slashFix));
+
+        const __m256i merged = _mm256_madd_epi16(_mm256_maddubs_epi16(values,_mm256_set1_epi32(0x01400140)),_mm256_set1_epi32(0x00011000));
+        const __m256i out = _mm256_shuffle_epi8(merged,pack);
+        _mm_storeu_si128((__m128i*)pOut,_mm256_castsi256_si128(out));
+        _mm_storeu_si128((__m128i*)(pOut + 12),_mm256_extracti128_si256(out,1));
+    }
+    return done;
+}
+
+#undef BASE64_ENCODE_SHUFFLE
+#undef BASE64_ENCODE_OFFSETS
+#undef BASE64_DECODE_SHUFFLE
+#undef BASE64_DECODE_LOWER
+#undef BASE64_DECODE_UPPER
+#undef BASE64_DECODE_SHIFT
+
+// Hex encode is a 16 entry look up, perfect for a byte shuffle. The two nibbles are then interleaved.
+__attribute__((target("sse4.1")))
+static size_t EncodeHexSSE41(const uint8_t* pIn,size_t pInSize,char* pOut,const char* pDigits)
+{
+    const __m128i digits = _mm_loadu_si128((const __m128i*)pDigits);
+    const __m128i mask = _mm_set1_epi8(0x0f);
+
+    size_t done = 0;
+    for( ; pInSize - done >= 16 ; done += 16, pOut += 32 )
+    {
+        const __m128i in = _mm_loadu_si128((const __m128i*)(pIn + done));
+        const __m128i high = _mm_shuffle_epi8(digits,_mm_and_si128(_mm_srli_epi16(in,4),mask));
+        const __m128i low = _mm_shuffle_epi8(digits,_mm_and_si128(in,mask));
+        _mm_storeu_si128((__m128i*)pOut,_mm_unpacklo_epi8(high,low));
+        _mm_storeu_si128((__m128i*)(pOut + 16),_mm_unpackhi_epi8(high,low));
+    }
+    return done;
+}
+
+__attribute__((target("avx2")))
+static size_t EncodeHexAVX2(const uint8_t* pIn,size_t pInSize,char* pOut,const char* pDigits)
+{
+    const __m256i digits = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)pDigits));
+    const __m256i mask = _mm256_set1_epi8(0x0f);
+
+    size_t done = 0;
+    for( ; pInSize - done >= 32 ; done += 32, pOut += 64 )
+    {
+        const __m256i in = _mm256_loadu_si256((const __m256i*)(pIn + done));
+        const __m256i high = _mm256_shuffle_epi8(digits,_mm256_and_si256(_mm256_srli_epi16(in,4),mask));
+        const __m256i low = _mm256_shuffle_epi8(digits,_mm256_and_si256(in,mask));
+        // Unpack works within lanes, so swap the middle two halves back into order.
+        const __m256i first = _mm256_unpacklo_epi8(high,low);
+        const __m256i second = _mm256_unpackhi_epi8(high,low);
+        _mm256_storeu_si256((__m256i*)pOut,_mm256_permute2x128_si256(first,second,0x20));
+        _mm256_storeu_si256((__m256i*)(pOut + 32),_mm256_permute2x128_si256(first,second,0x31));
+    }
+    return done;
+}
+
+/**
+ * @brief Converts 16 hex characters to their values, rValid gets 0xff for each one that was a hex character.
+ * Or'ing 0x20 makes letters lower case and leaves digits alone.
+ */
+__attribute__((target("sse4.1")))
+static inline __m128i HexValuesSSE41(__m128i pIn,__m128i& rValid)
+{
+    const __m128i lower = _mm_or_si128(pIn,_mm_set1_epi8(0x20));
+    const __m128i isDigit = _mm_and_si128(_mm_cmpgt_epi8(pIn,_mm_set1_epi8('0' - 1)),_mm_cmplt_epi8(pIn,_mm_set1_epi8('9' + 1)));
+    const __m128i isLetter = _mm_and_si128(_mm_cmpgt_epi8(lower,_mm_set1_epi8('a' - 1)),_mm_cmplt_epi8(lower,_mm_set1_epi8('f' + 1)));
+    rValid = _mm_or_si128(isDigit,isLetter);
+    return _mm_or_si128(_mm_and_si128(isDigit,_mm_sub_epi8(pIn,_mm_set1_epi8('0'))),_mm_and_si128(isLetter,_mm_sub_epi8(lower,_mm_set1_epi8('a' - 10))));
+}
+
+__attribute__((target("sse4.1")))
+static size_t DecodeHexSSE41(const char* pIn,size_t pInSize,uint8_t* pOut)
+{
+    size_t done = 0;
+    for( ; pInSize - done >= 32 ; done += 32, pOut += 16 )
+    {
+        __m128i validA,validB;
+        const __m128i a = HexValuesSSE41(_mm_loadu_si128((const __m128i*)(pIn + done)),validA);
+        const __m128i b = HexValuesSSE41(_mm_loadu_si128((const __m128i*)(pIn + done + 16)),validB);
+        if( _mm_movemask_epi8(_mm_and_si128(validA,validB)) != 0xffff )
+        {
+            break;
+        }
+        // high * 16 + low for each pair.
+        const __m128i multiply = _mm_set1_epi16(0x0110);
+        _mm_storeu_si128((__m128i*)pOut,_mm_packus_epi16(_mm_maddubs_epi16(a,multiply),_mm_maddubs_epi16(b,multiply)));
+    }
+    return done;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i HexValuesAVX2(__m256i pIn,__m256i& rValid)
+{
+    const __m256i lower = _mm256_or_si256(pIn,_mm256_set1_epi8(0x20));
+    const __m256i isDigit = _mm256_and_si256(_mm256_cmpgt_epi8(pIn,_mm256_set1_epi8('0' - 1)),_mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1),pIn));
+    const __m256i isLetter = _mm256_and_si256(_mm256_cmpgt_epi8(lower,_mm256_set1_epi8('a' - 1)),_mm256_cmpgt_epi8(_mm256_set1_epi8('f' + 1),lower));
+    rValid = _mm256_or_si256(isDigit,isLetter);
+    return _mm256_or_si256(_mm256_and_si256(isDigit,_mm256_sub_epi8(pIn,_mm256_set1_epi8('0'))),_mm256_and_si256(isLetter,_mm256_sub_epi8(lower,_mm256_set1_epi8('a' - 10))));
+}
+
+__attribute__((target("avx2")))
+static size_t DecodeHexAVX2(const char* pIn,size_t pInSize,uint8_t* pOut)
+{
+    size_t done = 0;
+    for( ; pInSize - done >= 64 ; done += 64, pOut += 32 )
+    {
+        __m256i validA,validB;
+        const __m256i a = HexValuesAVX2(_mm256_loadu_si256((const __m256i*)(pIn + done)),validA);
+        const __m256i b = HexValuesAVX2(_mm256_loadu_si256((const __m256i*)(pIn + done + 32)),validB);
+        if( _mm256_movemask_epi8(_mm256_and_si256(validA,validB)) != -1 )
+        {
+            break;
+        }
+        const __m256i multiply = _mm256_set1_epi16(0x0110);
+        const __m256i packed = _mm256_packus_epi16(_mm256_maddubs_epi16(a,multiply),_mm256_maddubs_epi16(b,multiply));
+        // Pack works within lanes, put the 64 bit quarters back in order.
+        _mm256_storeu_si256((__m256i*)pOut,_mm256_permute4x64_epi64(packed,0xd8));
+    }
+    return done;
+}
+#endif //#ifdef TINYTOOLS_X86_SIMD
+
+size_t EncodeBase64(const uint8_t* pData,size_t pSize,char** rBase64,Base64Alphabet pAlphabet)
+{
+    const size_t newSize = EncodedBase64Size(pSize,pAlphabet);
+    *rBase64 = new char[newSize + 1];
+    (*rBase64)[newSize] = 0;
+    return EncodeBase64(pData,pSize,*rBase64,newSize,pAlphabet);
+}
+
+size_t EncodeBase64(const uint8_t* pData,size_t pSize,char* rBase64,size_t pBase64BufferSize,Base64Alphabet pAlphabet)
+{
+    const size_t newSize = EncodedBase64Size(pSize,pAlphabet);
+    if( newSize > pBase64BufferSize )
+    {
+        TINYTOOLS_THROW("EncodeBase64 output buffer is too small, needs " + std::to_string(newSize) + " bytes but was given " + std::to_string(pBase64BufferSize));
+    }
+
+    const bool urlSafe = pAlphabet == Base64Alphabet::URL_SAFE;
+    const char* chars = urlSafe ? BASE64_URL_SAFE_CHARS : BASE64_STANDARD_CHARS;
+    char* out = rBase64;
+
+    size_t done = 0;
+#ifdef TINYTOOLS_X86_SIMD
+    switch( GetCodecKernel() )
+    {
+    case CodecKernel::SCALAR:
+    case CodecKernel::BMI2:
+        break;
+
+    case CodecKernel::SSE41:
+        done = EncodeBase64SSE41(pData,pSize,out,urlSafe);
+        break;
+
+    case CodecKernel::AVX2:
+        done = EncodeBase64AVX2(pData,pSize,out,urlSafe);
+        break;
+    }
+    out += (done / 3) * 4;
+#endif
+
+    for( ; pSize - done >= 3 ; done += 3, out += 4 )
+    {
+        const uint32_t bits = (pData[done] << 16) | (pData[done+1] << 8) | pData[done+2];
+        out[0] = chars[(bits >> 18) & 0x3f];
+        out[1] = chars[(bits >> 12) & 0x3f];
+        out[2] = chars[(bits >> 6) & 0x3f];
+        out[3] = chars[bits & 0x3f];
+    }
+
+    const size_t tail = pSize - done;
+    if( tail > 0 )
+    {
+        const uint32_t bits = (pData[done] << 16) | (tail > 1 ? pData[done+1] << 8 : 0);
+        *out++ = chars[(bits >> 18) & 0x3f];
+        *out++ = chars[(bits >> 12) & 0x3f];
+        if( tail > 1 )
+        {
+            *out++ = chars[(bits >> 6) & 0x3f];
+        }
+
+        if( urlSafe == false )
+        {
+            for( size_t n = tail ; n < 3 ; n++ )
+            {
+                *out++ = '=';
+            }
+        }
+    }
+    assert( out == rBase64 + newSize );
+
+    return newSize;
+}
+
+size_t DecodeBase64(const char* pBase64,size_t pBase64Size,uint8_t** rData,Base64Alphabet pAlphabet)
+{
+    // Decode to a buffer of the max size, it is at most two bytes bigger than needed so no point in copying it.
+    *rData = new uint8_t[DecodedBase64MaxSize(pBase64Size)];
+    return DecodeBase64(pBase64,pBase64Size,*rData,DecodedBase64MaxSize(pBase64Size),pAlphabet);
+}
+
+size_t DecodeBase64(const char* pBase64,size_t pBase64Size,uint8_t* rData,size_t pDataBufferSize,Base64Alphabet pAlphabet)
+{
+    // Padding is optional, but if it is there the length must be a multiple of four.
+    size_t size = pBase64Size;
+    if( size > 0 && pBase64[size-1] == '=' )
+    {
+        if( (size % 4) != 0 )
+        {
+            TINYTOOLS_THROW("DecodeBase64 padded input is not a multiple of four characters long");
+        }
+        size--;
+        if( pBase64[size-1] == '=' )
+        {
+            size--;
+        }
+    }
+
+    if( (size % 4) == 1 )
+    {
+        TINYTOOLS_THROW("DecodeBase64 input has a bad length, " + std::to_string(pBase64Size) + " characters");
+    }
+
+    const size_t newSize = DecodedBase64MaxSize(size);
+    if( newSize > pDataBufferSize )
+    {
+        TINYTOOLS_THROW("DecodeBase64 output buffer is too small, needs " + std::to_string(newSize) + " bytes but was given " + std::to_string(pDataBufferSize));
+    }
+
+    const bool urlSafe = pAlphabet == Base64Alphabet::URL_SAFE;
+    const int8_t* values = urlSafe ? BASE64_URL_SAFE_DECODE.mValue : BASE64_STANDARD_DECODE.mValue;
+    uint8_t* out = rData;
+
+    size_t done = 0;
+#ifdef TINYTOOLS_X86_SIMD
+    const Base64DecodeConstants& constants = urlSafe ? BASE64_URL_SAFE_DECODE_CONSTANTS : BASE64_STANDARD_DECODE_CONSTANTS;
+    switch( GetCodecKernel() )
+    {
+    case CodecKernel::SCALAR:
+    case CodecKernel::BMI2:
+        break;
+
+    case CodecKernel::SSE41:
+        done = DecodeBase64SSE41(pBase64,size,out,newSize,constants);
+        break;
+
+    case CodecKernel::AVX2:
+        done = DecodeBase64AVX2(pBase64,size,out,newSize,constants);
+        break;
+    }
+    out += (done / 4) * 3;
+#endif
+
+    // Does the whole quads and then the tail as if it were padded with zero values.
+    while( done < size )
+    {
+        uint32_t bits = 0;
+        const size_t count = std::min<size_t>(4,size - done);
+        for( size_t n = 0 ; n < 4 ; n++ )
+        {
+            int value = 0;
+            if( n < count )
+            {
+                value = values[(uint8_t)pBase64[done + n]];
+                if( value < 0 )
+                {
+                    TINYTOOLS_THROW("DecodeBase64 found a character that is not base64 at " + std::to_string(done + n));
+                }
+            }
+            bits = (bits << 6) | value;
+        }
+
+        *out++ = (uint8_t)(bits >> 16);
+        if( count > 2 )
+        {
+            *out++ = (uint8_t)(bits >> 8);
+            if( count > 3 )
+            {
+                *out++ = (uint8_t)bits;
+            }
+        }
+        done += count;
+    }
+    assert( out == rData + newSize );
+
+    return newSize;
+}
+
+size_t EncodeHex(const uint8_t* pData,size_t pSize,char** rHex,bool pUpperCase)
+{
+    *rHex = new char[EncodedHexSize(pSize) + 1];
+    (*rHex)[EncodedHexSize(pSize)] = 0;
+    return EncodeHex(pData,pSize,*rHex,EncodedHexSize(pSize),pUpperCase);
+}
+
+size_t EncodeHex(const uint8_t* pData,size_t pSize,char* rHex,size_t pHexBufferSize,bool pUpperCase)
+{
+    if( EncodedHexSize(pSize) > pHexBufferSize )
+    {
+        TINYTOOLS_THROW("EncodeHex output buffer is too small, needs " + std::to_string(EncodedHexSize(pSize)) + " bytes but was given " + std::to_string(pHexBufferSize));
+    }
+
+    const char* digits = pUpperCase ? "0123456789ABCDEF" : "0123456789abcdef";
+    char* out = rHex;
+
+    size_t done = 0;
+#ifdef TINYTOOLS_X86_SIMD
+    switch( GetCodecKernel() )
+    {
+    case CodecKernel::SCALAR:
+    case CodecKernel::BMI2:
+        break;
+
+    case CodecKernel::SSE41:
+        done = EncodeHexSSE41(pData,pSize,out,digits);
+        break;
+
+    case CodecKernel::AVX2:
+        done = EncodeHexAVX2(pData,pSize,out,digits);
+        break;
+    }
+    out += done * 2;
+#endif
+
+    for( ; done < pSize ; done++, out += 2 )
+    {
+        out[0] = digits[pData[done] >> 4];
+        out[1] = digits[pData[done] & 0x0f];
+    }
+
+    return EncodedHexSize(pSize);
+}
+
+size_t DecodeHex(const char* pHex,size_t pHexSize,uint8_t** rData)
+{
+    *rData = new uint8_t[DecodedHexSize(pHexSize)];
+    return DecodeHex(pHex,pHexSize,*rData,DecodedHexSize(pHexSize));
+}
+
+/**
+ * @brief The value of each hex character, -1 if it's not one. A table as branching on random data is slow.
+ */
+struct HexDecodeTable
+{
+    int8_t mValue[256];
+
+    constexpr HexDecodeTable():mValue()
+    {
+        for( int n = 0 ; n < 256 ; n++ )
+        {
+            mValue[n] = -1;
+        }
+        for( int n = 0 ; n < 10 ; n++ )
+        {
+            mValue['0' + n] = (int8_t)n;
+        }
+        for( int n = 0 ; n < 6 ; n++ )
+        {
+            mValue['a' + n] = (int8_t)(10 + n);
+            mValue['A' + n] = (int8_t)(10 + n);
+        }
+    }
+};
+
+static constexpr HexDecodeTable HEX_DECODE;
+
+size_t DecodeHex(const char* pHex,size_t pHexSize,uint8_t* rData,size_t pDataBufferSize)
+{
+    if( (pHexSize % 2) != 0 )
+    {
+        TINYTOOLS_THROW("DecodeHex input has an odd number of characters, " + std::to_string(pHexSize));
+    }
+
+    if( DecodedHexSize(pHexSize) > pDataBufferSize )
+    {
+        TINYTOOLS_THROW("DecodeHex output buffer is too small, needs " + std::to_string(DecodedHexSize(pHexSize)) + " bytes but was given " + std::to_string(pDataBufferSize));
+    }
+
+    uint8_t* out = rData;
+    size_t done = 0;
+#ifdef TINYTOOLS_X86_SIMD
+    switch( GetCodecKernel() )
+    {
+    case CodecKernel::SCALAR:
+    case CodecKernel::BMI2:
+        break;
+
+    case CodecKernel::SSE41:
+        done = DecodeHexSSE41(pHex,pHexSize,out);
+        break;
+
+    case CodecKernel::AVX2:
+        done = DecodeHexAVX2(pHex,pHexSize,out);
+        break;
+    }
+    out += done / 2;
+#endif
+
+    for( ; done < pHexSize ; done += 2, out++ )
+    {
+        const int high = HEX_DECODE.mValue[(uint8_t)pHex[done]];
+        const int low = HEX_DECODE.mValue[(uint8_t)pHex[done+1]];
+        if( high < 0 || low < 0 )
+        {
+            TINYTOOLS_THROW("DecodeHex found a character that is not hex at " + std::to_string(high < 0 ? done : done + 1));
+        }
+        *out = (uint8_t)((high << 4) | low);
+    }
+
+    return DecodedHexSize(pHexSize);
+}
+
+size_t SevenBitEncoder::Feed(const uint8_t* p8Bit,size_t p8BitSize,uint8_t* r7Bit,size_t p7BitBufferSize)
+{
+    if( GetFeedSize(p8BitSize) > p7BitBufferSize )
+    {
+        TINYTOOLS_THROW("SevenBitEncoder::Feed output buffer is too small, needs " + std::to_string(GetFeedSize(p8BitSize)) + " bytes but was given " + std::to_string(p7BitBufferSize));
+    }
+
+    size_t written = 0;
+
+    // First finish off the group started last time.
+    if( mPendingSize > 0 )
+    {
+        const size_t needed = std::min(sizeof(mPending) - mPendingSize,p8BitSize);
+        memcpy(mPending + mPendingSize,p8Bit,needed);
+        mPendingSize += needed;
+        p8Bit += needed;
+        p8BitSize -= needed;
+
+        if( mPendingSize < sizeof(mPending) )
+            return 0;
+
+        written += Encode7Bit(mPending,sizeof(mPending),r7Bit,p7BitBufferSize);
+        mPendingSize = 0;
+    }
+
+    // Now all the whole groups in one go, then keep the rest.
+    const size_t wholeGroups = (p8BitSize / 7) * 7;
+    if( wholeGroups > 0 )
+    {
+        written += Encode7Bit(p8Bit,wholeGroups,r7Bit + written,p7BitBufferSize - written);
+    }
+
+    mPendingSize = p8BitSize - wholeGroups;
+    memcpy(mPending,p8Bit + wholeGroups,mPendingSize);
+
+    return written;
+}
+
+size_t SevenBitEncoder::Flush(uint8_t* r7Bit,size_t p7BitBufferSize)
+{
+    const size_t written = mPendingSize > 0 ? Encode7Bit(mPending,mPendingSize,r7Bit,p7BitBufferSize) : 0;
+    mPendingSize = 0;
+    return written;
+}
+
+size_t SevenBitDecoder::Feed(const uint8_t* p7Bit,size_t p7BitSize,uint8_t* r8Bit,size_t p8BitBufferSize)
+{
+    if( GetFeedSize(p7BitSize) > p8BitBufferSize )
+    {
+        TINYTOOLS_THROW("SevenBitDecoder::Feed output buffer is too small, needs " + std::to_string(GetFeedSize(p7BitSize)) + " bytes but was given " + std::to_string(p8BitBufferSize));
+    }
+
+    size_t written = 0;
+
+    if( mPendingSize > 0 )
+    {
+        const size_t needed = std::min(sizeof(mPending) - mPendingSize,p7BitSize);
+        memcpy(mPending + mPendingSize,p7Bit,needed);
+        mPendingSize += needed;
+        p7Bit += needed;
+        p7BitSize -= needed;
+
+        if( mPendingSize < sizeof(mPending) )
+            return 0;
+
+        written += Decode7Bit(mPending,sizeof(mPending),r8Bit,p8BitBufferSize);
+        mPendingSize = 0;
+    }
+
+    const size_t wholeGroups = (p7BitSize / 8) * 8;
+    if( wholeGroups > 0 )
+    {
+        written += Decode7Bit(p7Bit,wholeGroups,r8Bit + written,p8BitBufferSize - written);
+    }
+
+    mPendingSize = p7BitSize - wholeGroups;
+    memcpy(mPending,p7Bit + wholeGroups,mPendingSize);
+
+    return written;
+}
+
+size_t SevenBitDecoder::Flush(uint8_t* r8Bit,size_t p8BitBufferSize)
+{
+    const size_t written = mPendingSize > 0 ? Decode7Bit(mPending,mPendingSize,r8Bit,p8BitBufferSize) : 0;
+    mPendingSize = 0;
+    return written;
+}
+
+void FrameWriter::Queue(const uint8_t* p8Bit,size_t p8BitSize)
+{
+    const size_t frameSize = Encoded7BitSize(p8BitSize) + 2;
+    const size_t start = mEncoded.size();
+    mEncoded.resize(start + frameSize);
+
+    uint8_t* frame = mEncoded.data() + start;
+    frame[0] = FRAME_START;
+    Encode7Bit(p8Bit,p8BitSize,frame + 1,frameSize - 2);
+    frame[frameSize-1] = FRAME_END;
+
+    // Frames from Queue are next to each other in mEncoded, so if the last piece was one of them just make it bigger.
+    if( mPieces.size() > mFirstPiece && mPieces.back().mExternal == nullptr && mPieces.back().mOffset + mPieces.back().mSize == start )
+    {
+        mPieces.back().mSize += frameSize;
+    }
+    else
+    {
+        mPieces.push_back({nullptr,start,frameSize});
+    }
+    mQueuedBytes += frameSize;
+}
+
+void FrameWriter::QueueEncoded(const uint8_t* p7Bit,size_t p7BitSize)
+{
+    static const uint8_t frameStart = FRAME_START;
+    static const uint8_t frameEnd = FRAME_END;
+
+    mPieces.push_back({&frameStart,0,1});
+    if( p7BitSize > 0 )
+    {
+        mPieces.push_back({p7Bit,0,p7BitSize});
+    }
+    mPieces.push_back({&frameEnd,0,1});
+    mQueuedBytes += p7BitSize + 2;
+}
+
+bool FrameWriter::Flush(int pFileDescriptor)
+{
+    while( mFirstPiece < mPieces.size() )
+    {
+        mIOVecs.clear();
+        for( size_t n = mFirstPiece ; n < mPieces.size() && mIOVecs.size() < IOV_MAX ; n++ )
+        {
+            const Piece& piece = mPieces[n];
+            const uint8_t* data = piece.mExternal ? piece.mExternal : mEncoded.data() + piece.mOffset;
+            mIOVecs.push_back({(void*)data,piece.mSize});
+        }
+        mIOVecs.front().iov_base = (uint8_t*)mIOVecs.front().iov_base + mFirstPieceWritten;
+        mIOVecs.front().iov_len -= mFirstPieceWritten;
+
+        ssize_t written = writev(pFileDescriptor,mIOVecs.data(),(int)mIOVecs.size());
+        if( written < 0 )
+        {
+            if( errno == EINTR )
+                continue;
+            return false;
+        }
+
+        mQueuedBytes -= written;
+
+        // Step over what was written, may have stopped part way through a piece.
+        for( size_t left = written + mFirstPieceWritten ; left > 0 ; )
+        {
+            const size_t size = mPieces[mFirstPiece].mSize;
+            if( left < size )
+            {
+                mFirstPieceWritten = left;
+                break;
+            }
+            left -= size;
+            mFirstPiece++;
+            mFirstPieceWritten = 0;
+        }
+    }
+
+    Clear();
+    return true;
+}
+
+void FrameWriter::Clear()
+{
+    mEncoded.clear();
+    mPieces.clear();
+    mFirstPiece = 0;
+    mFirstPieceWritten = 0;
+    mQueuedBytes = 0;
+}
+
+/**
+ * @brief Returns the first byte with the most significant bit set, or pEnd.
+ */
+static const uint8_t* FindControlByte(const uint8_t* pStart,const uint8_t* pEnd)
+{
+#ifdef __SSE2__
+    // The sign bit is the control bit, movemask hands them to us 16 at a time.
+    for( ; pStart + 16 <= pEnd ; pStart += 16 )
+    {
+        const int mask = _mm_movemask_epi8(_mm_loadu_si128((const __m128i*)pStart));
+        if( mask != 0 )
+        {
+            return pStart + __builtin_ctz(mask);
+        }
+    }
+#endif
+    for( ; pStart < pEnd && (*pStart&0x80) == 0 ; pStart++ ){}
+    return pStart;
+}
+
+size_t ParseFrames(const uint8_t* pBuffer,size_t pBufferSize,std::function<bool(const uint8_t* p7Bit,size_t p7BitSize)> pFrame)
+{
+    const uint8_t* const end = pBuffer + pBufferSize;
+    const uint8_t* pos = pBuffer;
+    while( pos < end )
+    {
+        const uint8_t* start = (const uint8_t*)memchr(pos,FRAME_START,end - pos);
+        if( start == nullptr )
+        {// Nothing but junk, all of it can go.
+            return pBufferSize;
+        }
+
+        const uint8_t* control = FindControlByte(start + 1,end);
+        if( control == end )
+        {// Not all here yet, keep from the start marker on.
+            return start - pBuffer;
+        }
+
+        if( *control == FRAME_END )
+        {
+            pos = control + 1;
+            if( pFrame(start + 1,control - start - 1) == false )
+            {
+                return pos - pBuffer;
+            }
+        }
+        else
+        {// Broken frame, start looking again from the control byte. It may be the start of the next frame.
+            pos = control;
+        }
+    }
+    return pBufferSize;
+}
+
+/**
+ * @brief True if what ParseFrames left is one frame that has not ended and is already pMaxFrameSize or more, so can never be a good frame.
+ * What ParseFrames leaves after stopping early can be whole frames, those are not counted.
+ */
+static bool IsOversizedPartialFrame(const uint8_t* pBuffer,size_t pBufferSize,size_t pMaxFrameSize)
+{
+    return pBufferSize > 0 && pBufferSize >= pMaxFrameSize && pBuffer[0] == FRAME_START && FindControlByte(pBuffer + 1,pBuffer + pBufferSize) == pBuffer + pBufferSize;
+}
+
+ssize_t FrameReader::Read(int pFileDescriptor,std::function<bool(const uint8_t* p7Bit,size_t p7BitSize)> pFrame)
+{
+    if( mBuffer.size() < mUsed + mReadSize )
+    {
+        mBuffer.resize(mUsed + mReadSize);
+    }
+
+    const ssize_t bytesRead = read(pFileDescriptor,mBuffer.data() + mUsed,mReadSize);
+    if( bytesRead > 0 )
+    {
+        mUsed += bytesRead;
+        const size_t parsed = ParseFrames(mBuffer.data(),mUsed,[this,&pFrame](const uint8_t* p7Bit,size_t p7BitSize)
+        {// Frames over the limit are skipped even if they did all arrive in one read, so what gets through does not depend on how the reads fell.
+            return p7BitSize + 2 > mMaxFrameSize || pFrame(p7Bit,p7BitSize);
+        });
+        mUsed -= parsed;
+        if( IsOversizedPartialFrame(mBuffer.data() + parsed,mUsed,mMaxFrameSize) )
+        {// Never going to end, or too big if it does. Drop it, ParseFrames skips the rest of it and picks up at the next FRAME_START.
+            mUsed = 0;
+        }
+        else if( mUsed > 0 && parsed > 0 )
+        {
+            memmove(mBuffer.data(),mBuffer.data() + parsed,mUsed);
+        }
+    }
+    return bytesRead;
+}
+
+EventLoop::EventLoop():
+	mEpoll(epoll_create1(EPOLL_CLOEXEC)),
+	mWakeEvent(eventfd(0,EFD_NONBLOCK|EFD_CLOEXEC)),
+	mTimerFD(timerfd_create(CLOCK_MONOTONIC,TFD_NONBLOCK|TFD_CLOEXEC))
+{
+	sigemptyset(&mSignals);
+	if( mEpoll < 0 || mWakeEvent < 0 || mTimerFD < 0 )
+	{
+		const std::string error = strerror(errno);
+		for( int fd : {mEpoll,mWakeEvent,mTimerFD} ){if( fd >= 0 ){close(fd);}}
+		TINYTOOLS_THROW("EventLoop failed to create its file descriptors, " + error);
+	}
+
+	// Our own file descriptors have a generation of zero, users ones never do.
+	for( int fd : {mWakeEvent,mTimerFD} )
+	{
+		struct epoll_event event;
+		event.events = EPOLLIN;
+		event.data.u64 = (uint32_t)fd;
+		epoll_ctl(mEpoll,EPOLL_CTL_ADD,fd,&event);
+	}
+}
+
+EventLoop::~EventLoop()
+{
+	if( mSignalFD >= 0 )
+	{
+		pthread_sigmask(SIG_UNBLOCK,&mSignals,nullptr);
+		close(mSignalFD);
+	}
+	close(mTimerFD);
+	close(mWakeEvent);
+	close(mEpoll);
+}
+
+void EventLoop::AddFD(int pFileDescriptor,uint32_t pEvents,std::function<void(uint32_t pEvents)> pCallback)
+{
+	if( pCallback == nullptr )
+	{
+		TINYTOOLS_THROW("EventLoop::AddFD passed nullptr for the callback");
+	}
+	if( mHandlers.count(pFileDescriptor) > 0 )
+	{
+		TINYTOOLS_THROW("EventLoop::AddFD file descriptor " + std::to_string(pFileDescriptor) + " has already been added");
+	}
+
+	auto handler = std::make_shared<FDHandler>();
+	handler->mCallback = pCallback;
+	handler->mGeneration = mNextGeneration++;
+	if( mNextGeneration == 0 )
+	{
+		mNextGeneration = 1;
+	}
+
+	struct epoll_event event;
+	event.events = pEvents;
+	event.data.u64 = (uint64_t(handler->mGeneration) << 32) | (uint32_t)pFileDescriptor;
+	if( epoll_ctl(mEpoll,EPOLL_CTL_ADD,pFileDescriptor,&event) != 0 )
+	{
+		TINYTOOLS_THROW("EventLoop::AddFD epoll_ctl failed, " + std::string(strerror(errno)));
+	}
+	mHandlers[pFileDescriptor] = handler;
+}
+
+void EventLoop::ModifyFD(int pFileDescriptor,uint32_t pEvents)
+{
+	auto found = mHandlers.find(pFileDescriptor);
+	if( found == mHandlers.end() )
+	{
+		TINYTOOLS_THROW("EventLoop::ModifyFD file descriptor " + std::to_string(pFileDescriptor) + " has not been added");
+	}
+
+	struct epoll_event event;
+	event.events = pEvents;
+	event.data.u64 = (uint64_t(found->second->mGeneration) << 32) | (uint32_t)pFileDescriptor;
+	if( epoll_ctl(mEpoll,EPOLL_CTL_MOD,pFileDescriptor,&event) != 0 )
+	{
+		TINYTOOLS_THROW("EventLoop::ModifyFD epoll_ctl failed, " + std::string(strerror(errno)));
+	}
+}
+
+void EventLoop::RemoveFD(int pFileDescriptor)
+{
+	auto found = mHandlers.find(pFileDescriptor);
+	if( found != mHandlers.end() )
+	{
+		epoll_ctl(mEpoll,EPOLL_CTL_DEL,pFileDescriptor,nullptr);// Fails if it's already closed, which is fine.
+		mHandlers.erase(found);
+	}
+}
+
+EventLoop::TimerID EventLoop::AddTimer(int pMilliseconds,std::function<void()> pCallback)
+{
+	return AddTimer(std::chrono::milliseconds(std::max(0,pMilliseconds)),std::chrono::milliseconds(0),pCallback);
+}
+
+EventLoop::TimerID EventLoop::AddRepeatingTimer(int pMilliseconds,std::function<void()> pCallback)
+{
+	if( pMilliseconds <= 0 )
+	{
+		TINYTOOLS_THROW("EventLoop::AddRepeatingTimer interval must be more than zero");
+	}
+	return AddTimer(std::chrono::milliseconds(pMilliseconds),std::chrono::milliseconds(pMilliseconds),pCallback);
+}
+
+EventLoop::TimerID EventLoop::AddTimer(std::chrono::milliseconds pDelay,std::chrono::milliseconds pInterval,std::function<void()> pCallback)
+{
+	if( pCallback == nullptr )
+	{
+		TINYTOOLS_THROW("EventLoop passed nullptr for the timer callback");
+	}
+
+	const TimerID id = mNextTimerID++;
+	auto timer = std::make_shared<Timer>();
+	timer->mWhen = std::chrono::steady_clock::now() + pDelay;
+	timer->mInterval = pInterval;
+	timer->mCallback = pCallback;
+	mTimers[id] = timer;
+	mTimerQueue.emplace(timer->mWhen,id);
+
+	// Only need to touch the timerfd if this is now the soonest.
+	if( mTimerQueue.begin()->second == id )
+	{
+		ArmTimerFD();
+	}
+	return id;
+}
+
+void EventLoop::CancelTimer(TimerID pTimer)
+{
+	auto found = mTimers.find(pTimer);
+	if( found != mTimers.end() )
+	{
+		const bool wasFirst = mTimerQueue.begin()->second == pTimer;
+		mTimerQueue.erase({found->second->mWhen,pTimer});
+		mTimers.erase(found);
+		if( wasFirst )
+		{
+			ArmTimerFD();
+		}
+	}
+}
+
+void EventLoop::ArmTimerFD()
+{
+	// steady_clock is CLOCK_MONOTONIC so its time can be given to the timerfd as it is. All zero disarms it.
+	struct itimerspec when;
+	memset(&when,0,sizeof(when));
+	if( mTimerQueue.size() > 0 )
+	{
+		const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(mTimerQueue.begin()->first.time_since_epoch()).count();
+		when.it_value.tv_sec = ns / 1000000000;
+		when.it_value.tv_nsec = std::max<int64_t>(1,ns % 1000000000);
+	}
+	timerfd_settime(mTimerFD,TFD_TIMER_ABSTIME,&when,nullptr);
+}
+
+void EventLoop::RunTimers()
+{
+	uint64_t expirations;
+	if( read(mTimerFD,&expirations,sizeof(expirations)) ){}// Only reading to reset it, the queue says what is due.
+
+	const auto now = std::chrono::steady_clock::now();
+	while( mTimerQueue.size() > 0 && mTimerQueue.begin()->first <= now )
+	{
+		const TimerID id = mTimerQueue.begin()->second;
+		mTimerQueue.erase(mTimerQueue.begin());
+
+		// Hold on to it, the callback may cancel it.
+		const std::shared_ptr<Timer> timer = mTimers[id];
+		if( timer->mInterval.count() > 0 )
+		{
+			timer->mWhen += timer->mInterval;
+			if( timer->mWhen <= now )
+			{
+				timer->mWhen = now + timer->mInterval;
+			}
+			mTimerQueue.emplace(timer->mWhen,id);
+		}
+		else
+		{
+			mTimers.erase(id);
+		}
+		timer->mCallback();
+	}
+	ArmTimerFD();
+}
+
+void EventLoop::AddSignal(int pSignal,std::function<void(int pSignal)> pCallback)
+{
+	if( pCallback == nullptr )
+	{
+		TINYTOOLS_THROW("EventLoop::AddSignal passed nullptr for the callback");
+	}
+
+	sigset_t signal;
+	sigemptyset(&signal);
+	sigaddset(&signal,pSignal);
+	pthread_sigmask(SIG_BLOCK,&signal,nullptr);
+	sigaddset(&mSignals,pSignal);
+
+	const int signalFD = signalfd(mSignalFD,&mSignals,SFD_NONBLOCK|SFD_CLOEXEC);
+	if( signalFD < 0 )
+	{
+		TINYTOOLS_THROW("EventLoop::AddSignal signalfd failed, " + std::string(strerror(errno)));
+	}
+	if( mSignalFD < 0 )
+	{
+		mSignalFD = signalFD;
+		struct epoll_event event;
+		event.events = EPOLLIN;
+		event.data.u64 = (uint32_t)mSignalFD;
+		epoll_ctl(mEpoll,EPOLL_CTL_ADD,mSignalFD,&event);
+	}
+	mSignalHandlers[pSignal] = pCallback;
+}
+
+void EventLoop::RemoveSignal(int pSignal)
+{
+	if( mSignalHandlers.erase(pSignal) > 0 )
+	{
+		sigdelset(&mSignals,pSignal);
+		signalfd(mSignalFD,&mSignals,0);
+
+		sigset_t signal;
+		sigemptyset(&signal);
+		sigaddset(&signal,pSignal);
+		pthread_sigmask(SIG_UNBLOCK,&signal,nullptr);
+	}
+}
+
+void EventLoop::RunSignals()
+{
+	struct signalfd_siginfo info;
+	while( read(mSignalFD,&info,sizeof(info)) == sizeof(info) )
+	{
+		auto found = mSignalHandlers.find((int)info.ssi_signo);
+		if( found != mSignalHandlers.end() )
+		{
+			const auto callback = found->second;// A copy, the callback may remove itself.
+			callback((int)info.ssi_signo);
+		}
+	}
+}
+
+void EventLoop::Post(std::function<void()> pWork)
+{
+	bool wake;
+	{
+		std::unique_lock<std::mutex> lock(mPostedMutex);
+		wake = mPosted.size() == 0;// If it's not empty the loop has already been woken.
+		mPosted.push_back(pWork);
+	}
+
+	if( wake )
+	{
+		const uint64_t one = 1;
+		if( write(mWakeEvent,&one,sizeof(one)) ){}// Can only fail if the count overflows, and then it's awake anyway.
+	}
+}
+
+void EventLoop::RunPosted()
+{
+	uint64_t count;
+	if( read(mWakeEvent,&count,sizeof(count)) ){}
+
+	std::vector<std::function<void()>> work;
+	{
+		std::unique_lock<std::mutex> lock(mPostedMutex);
+		work.swap(mPosted);
+	}
+	for( auto& w : work )
+	{
+		w();
+	}
+}
+
+void EventLoop::Run()
+{
+	while( mKeepGoing )
+	{
+		RunOnce(-1);
+	}
+	mKeepGoing = true;// So it can be run again.
+}
+
+void EventLoop::RunOnce(int pTimeoutMS)
+{
+	struct epoll_event events[64];
+	const int numEvents = epoll_wait(mEpoll,events,64,pTimeoutMS);
+	if( numEvents < 0 )
+	{
+		if( errno == EINTR )
+			return;
+		TINYTOOLS_THROW("EventLoop epoll_wait failed, " + std::string(strerror(errno)));
+	}
+
+	for( int n = 0 ; n < numEvents ; n++ )
+	{
+		const int fd = (int)(events[n].data.u64 & 0xffffffff);
+		const uint32_t generation = (uint32_t)(events[n].data.u64 >> 32);
+		if( generation == 0 )
+		{
+			if( fd == mWakeEvent )
+			{
+				RunPosted();
+			}
+			else if( fd == mTimerFD )
+			{
+				RunTimers();
+			}
+			else if( fd == mSignalFD )
+			{
+				RunSignals();
+			}
+		}
+		else
+		{
+			// It may have been removed, or removed and a new one added with the same number, by an earlier callback.
+			auto found = mHandlers.find(fd);
+			if( found != mHandlers.end() && found->second->mGeneration == generation )
+			{
+				const std::shared_ptr<FDHandler> handler = found->second;
+				handler->mCallback(events[n].events);
+			}
+		}
+	}
+}
+
+void EventLoop::Stop()
+{
+	mKeepGoing = false;
+	const uint64_t one = 1;
+	if( write(mWakeEvent,&one,sizeof(one)) ){}
+}
+
+/**
+ * @brief Makes a non blocking socket bound to the address and port, pPort can be zero for any. rPort is the port it got.
+ */
+static int OpenBoundSocket(int pType,uint32_t pIPv4,uint16_t pPort,bool pReusePort,uint16_t& rPort)
+{
+	const int s = socket(AF_INET,pType|SOCK_NONBLOCK|SOCK_CLOEXEC,0);
+	if( s < 0 )
+	{
+		TINYTOOLS_THROW("Failed to open socket, " + std::string(strerror(errno)));
+	}
+
+	// SO_REUSEADDR lets a listener restart while old connections are in TIME_WAIT. On UDP it would let two sockets share the port,
+	// only one of them getting the traffic, so that is left to pReusePort.
+	const int one = 1;
+	if( pType == SOCK_STREAM )
+	{
+		setsockopt(s,SOL_SOCKET,SO_REUSEADDR,&one,sizeof(one));
+	}
+	if( pReusePort && setsockopt(s,SOL_SOCKET,SO_REUSEPORT,&one,sizeof(one)) != 0 )
+	{
+		const std::string error = strerror(errno);
+		close(s);
+		TINYTOOLS_THROW("Failed to set SO_REUSEPORT, " + error);
+	}
+
+	sockaddr_in address;
+	memset(&address,0,sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = pIPv4;
+	address.sin_port = htons(pPort);
+	socklen_t size = sizeof(address);
+	if( bind(s,(struct sockaddr*)&address,sizeof(address)) != 0 || getsockname(s,(struct sockaddr*)&address,&size) != 0 )
+	{
+		const std::string error = strerror(errno);
+		close(s);
+		TINYTOOLS_THROW("Failed to bind to " + IPv4ToString(pIPv4) + ":" + std::to_string(pPort) + ", " + error);
+	}
+
+	rPort = ntohs(address.sin_port);
+	return s;
+}
+
+TCPConnection::Ptr TCPConnection::Connect(EventLoop& pLoop,uint32_t pIPv4,uint16_t pPort,std::function<void(TCPConnection& pConnection)> pConnected,DataCallback pData,CloseCallback pClosed)
+{
+	const int s = socket(AF_INET,SOCK_STREAM|SOCK_NONBLOCK|SOCK_CLOEXEC,0);
+	if( s < 0 )
+	{
+		TINYTOOLS_THROW("TCPConnection::Connect failed to open socket, " + std::string(strerror(errno)));
+	}
+
+	Ptr connection(new TCPConnection(pLoop,s,false));
+	connection->mOnConnected = pConnected;
+	connection->mOnData = pData;
+	connection->mOnClose = pClosed;
+	connection->mPeerIPv4 = pIPv4;
+	connection->mPeerPort = pPort;
+
+	sockaddr_in address;
+	memset(&address,0,sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = pIPv4;
+	address.sin_port = htons(pPort);
+
+	// Even if it connects straight away the socket is writable when added, so the connected callback comes from the loop either way.
+	if( connect(s,(struct sockaddr*)&address,sizeof(address)) == 0 || errno == EINPROGRESS )
+	{
+		connection->Start();
+	}
+	else
+	{
+		// Failed already, tell them from the loop so it's the same as a connect that fails later.
+		const int error = errno;
+		pLoop.Post([connection,error](){connection->Finish(error);});
+	}
+	return connection;
+}
+
+TCPConnection::TCPConnection(EventLoop& pLoop,int pSocket,bool pConnected):
+	mLoop(pLoop),
+	mSocket(pSocket),
+	mConnected(pConnected)
+{
+}
+
+TCPConnection::~TCPConnection()
+{
+	// Only gets here once the loop has let go of it, so it's already been removed from the loop.
+	if( mSocket >= 0 )
+	{
+		close(mSocket);
+	}
+}
+
+void TCPConnection::Start()
+{
+	if( mSocket >= 0 )
+	{
+		// The loop holds a reference until Finish removes it.
+		Ptr self = shared_from_this();
+		mLoop.AddFD(mSocket,EPOLLIN|EPOLLOUT|EPOLLRDHUP|EPOLLET,[self](uint32_t pEvents){self->OnEvents(pEvents);});
+	}
+}
+
+void TCPConnection::Send(const void* pData,size_t pSize)
+{
+	if( mSocket < 0 || pSize == 0 )
+		return;
+
+	// Small sends are added on to the end of the last piece, so they go in one write.
+	if( mSendQueue.size() == 0 || mSendQueue.back().mFile >= 0 )
+	{
+		mSendQueue.emplace_back();
+	}
+	Piece& piece = mSendQueue.back();
+	piece.mData.insert(piece.mData.end(),(const uint8_t*)pData,(const uint8_t*)pData + pSize);
+	piece.mSize += pSize;
+	mQueuedBytes += pSize;
+	WriteAll();
+}
+
+void TCPConnection::Send(std::vector<uint8_t>&& pData)
+{
+	if( mSocket < 0 || pData.size() == 0 )
+		return;
+
+	mSendQueue.emplace_back();
+	mSendQueue.back().mSize = pData.size();
+	mSendQueue.back().mData = std::move(pData);
+	mQueuedBytes += mSendQueue.back().mSize;
+	WriteAll();
+}
+
+void TCPConnection::SendFile(int pFileDescriptor,off_t pOffset,size_t pSize)
+{
+	if( mSocket < 0 || pSize == 0 )
+		return;
+
+	mSendQueue.emplace_back();
+	mSendQueue.back().mFile = pFileDescriptor;
+	mSendQueue.back().mOffset = pOffset;
+	mSendQueue.back().mSize = pSize;
+	mQueuedBytes += pSize;
+	WriteAll();
+}
+
+void TCPConnection::Close(bool pAfterSending)
+{
+	if( mSocket < 0 )
+		return;
+
+	if( pAfterSending && mQueuedBytes > 0 )
+	{
+		mClosing = true;// WriteAll closes it when the queue empties.
+	}
+	else
+	{
+		Finish(0);
+	}
+}
+
+void TCPConnection::OnEvents(uint32_t pEvents)
+{
+	if( mConnected == false )
+	{
+		if( (pEvents & (EPOLLOUT|EPOLLERR|EPOLLHUP)) == 0 )
+			return;
+
+		int error = 0;
+		socklen_t errorSize = sizeof(error);
+		getsockopt(mSocket,SOL_SOCKET,SO_ERROR,&error,&errorSize);
+		if( error != 0 )
+		{
+			Finish(error);
+			return;
+		}
+
+		mConnected = true;
+		if( mOnConnected )
+		{
+			mOnConnected(*this);
+		}
+	}
+
+	if( mSocket >= 0 && (pEvents & (EPOLLIN|EPOLLRDHUP|EPOLLHUP|EPOLLERR)) )
+	{
+		ReadAll();
+	}
+
+	if( mSocket >= 0 && (pEvents & EPOLLOUT) )
+	{
+		WriteAll();
+	}
+}
+
+void TCPConnection::ReadAll()
+{
+	// Edge triggered, so read until there is no more or we won't be told again.
+	while( mSocket >= 0 )
+	{
+		if( mReceivedSize >= mMaxReceiveSize )
+		{// Full and none of it used, whatever they are sending is too big.
+			Finish(EMSGSIZE);
+			return;
+		}
+
+		if( mReceived.size() - mReceivedSize < 4096 )
+		{
+			mReceived.resize(std::max<size_t>(64 * 1024,mReceived.size() * 2));
+		}
+
+		const size_t room = std::min(mReceived.size(),mMaxReceiveSize) - mReceivedSize;
+		const ssize_t got = recv(mSocket,mReceived.data() + mReceivedSize,room,0);
+		if( got > 0 )
+		{
+			mReceivedSize += got;
+
+			// Keep passing it on while they keep using some, there may be more than one message in what arrived.
+			size_t start = 0;
+			while( start < mReceivedSize && mSocket >= 0 )
+			{
+				const size_t left = mReceivedSize - start;
+				const size_t used = mOnData ? std::min(mOnData(*this,mReceived.data() + start,left),left) : left;
+				if( used == 0 )
+					break;
+				start += used;
+			}
+
+			if( start > 0 && mSocket >= 0 )
+			{
+				memmove(mReceived.data(),mReceived.data() + start,mReceivedSize - start);
+				mReceivedSize -= start;
+			}
+		}
+		else if( got == 0 )
+		{
+			// They closed it, or only their side of it. Either way finish sending what is queued first, WriteAll then closes.
+			if( mQueuedBytes > 0 )
+			{
+				mClosing = true;
+				return;
+			}
+			Finish(0);
+		}
+		else if( errno == EINTR )
+		{
+			continue;
+		}
+		else
+		{
+			if( errno != EAGAIN && errno != EWOULDBLOCK )
+			{
+				Finish(errno);
+			}
+			return;
+		}
+	}
+}
+
+void TCPConnection::WriteAll()
+{
+	while( mSocket >= 0 && mConnected && mSendQueue.size() > 0 )
+	{
+		ssize_t sent;
+		if( mSendQueue.front().mFile >= 0 )
+		{
+			Piece& piece = mSendQueue.front();
+			sent = sendfile(mSocket,piece.mFile,&piece.mOffset,piece.mSize);
+			if( sent == 0 )
+			{// The file is shorter than we were told, nothing more to send from it.
+				mQueuedBytes -= piece.mSize;
+				mSendQueue.pop_front();
+				continue;
+			}
+		}
+		else
+		{
+			// Batch up all the memory pieces in a row into one write.
+			// sendmsg rather than writev so we can say MSG_NOSIGNAL.
+			mIOVecs.clear();
+			for( size_t n = 0 ; n < mSendQueue.size() && mSendQueue[n].mFile < 0 && mIOVecs.size() < IOV_MAX ; n++ )
+			{
+				Piece& piece = mSendQueue[n];
+				mIOVecs.push_back({piece.mData.data() + piece.mSent,piece.mSize});
+			}
+
+			struct msghdr message;
+			memset(&message,0,sizeof(message));
+			message.msg_iov = mIOVecs.data();
+			message.msg_iovlen = mIOVecs.size();
+			sent = sendmsg(mSocket,&message,MSG_NOSIGNAL);
+		}
+
+		if( sent < 0 )
+		{
+			if( errno == EINTR )
+				continue;
+			if( errno != EAGAIN && errno != EWOULDBLOCK )
+			{
+				Finish(errno);
+			}
+			return;// Full, EPOLLOUT will tell us when there is room.
+		}
+
+		// Take what went off the front of the queue.
+		mQueuedBytes -= sent;
+		while( sent > 0 )
+		{
+			Piece& piece = mSendQueue.front();
+			const size_t used = std::min((size_t)sent,piece.mSize);
+			if( piece.mFile < 0 )
+			{
+				piece.mSent += used;
+			}
+			piece.mSize -= used;
+			sent -= used;
+			if( piece.mSize == 0 )
+			{
+				mSendQueue.pop_front();
+			}
+		}
+	}
+
+	if( mSocket >= 0 && mClosing && mSendQueue.size() == 0 )
+	{
+		Finish(0);
+	}
+}
+
+void TCPConnection::Finish(int pError)
+{
+	Ptr keep = shared_from_this();// Removing from the loop can drop the last reference.
+	if( mSocket < 0 )
+		return;
+
+	mLoop.RemoveFD(mSocket);
+	close(mSocket);
+	mSocket = -1;
+	mConnected = false;
+	mSendQueue.clear();
+	mQueuedBytes = 0;
+
+	if( mOnClose )
+	{
+		const CloseCallback closed = mOnClose;
+		closed(*this,pError);
+	}
+}
+
+TCPListener::TCPListener(EventLoop& pLoop,uint16_t pPort,std::function<void(TCPConnection::Ptr pConnection)> pAccepted,uint32_t pIPv4,bool pReusePort,int pBacklog):
+	mLoop(pLoop),
+	mAccepted(pAccepted)
+{
+	if( pAccepted == nullptr )
+	{
+		TINYTOOLS_THROW("TCPListener passed nullptr for the accepted callback");
+	}
+
+	mSocket = OpenBoundSocket(SOCK_STREAM,pIPv4,pPort,pReusePort,mPort);
+	if( listen(mSocket,pBacklog) != 0 )
+	{
+		const std::string error = strerror(errno);
+		close(mSocket);
+		TINYTOOLS_THROW("TCPListener failed to listen, " + error);
+	}
+	mLoop.AddFD(mSocket,EPOLLIN|EPOLLET,[this](uint32_t){AcceptAll();});
+}
+
+TCPListener::~TCPListener()
+{
+	mLoop.RemoveFD(mSocket);
+	close(mSocket);
+}
+
+void TCPListener::AcceptAll()
+{
+	for(;;)
+	{
+		sockaddr_in address;
+		socklen_t size = sizeof(address);
+		const int s = accept4(mSocket,(struct sockaddr*)&address,&size,SOCK_NONBLOCK|SOCK_CLOEXEC);
+		if( s < 0 )
+		{
+			if( errno == EINTR || errno == ECONNABORTED )
+				continue;
+			return;// EAGAIN, or out of file descriptors in which case there's nothing we can do now.
+		}
+
+		TCPConnection::Ptr connection(new TCPConnection(mLoop,s,true));
+		connection->mPeerIPv4 = address.sin_addr.s_addr;
+		connection->mPeerPort = ntohs(address.sin_port);
+		mAccepted(connection);
+		connection->Start();
+	}
+}
+
+UDPSocket::UDPSocket(EventLoop& pLoop,uint16_t pPort,ReceiveCallback pReceived,uint32_t pIPv4,bool pReusePort):
+	mLoop(pLoop),
+	mReceived(pReceived),
+	mBuffer(64 * 1024)// Biggest a datagram can be.
+{
+	if( pReceived == nullptr )
+	{
+		TINYTOOLS_THROW("UDPSocket passed nullptr for the receive callback");
+	}
+
+	mSocket = OpenBoundSocket(SOCK_DGRAM,pIPv4,pPort,pReusePort,mPort);
+	mLoop.AddFD(mSocket,EPOLLIN|EPOLLET,[this](uint32_t){ReadAll();});
+}
+
+UDPSocket::~UDPSocket()
+{
+	mLoop.RemoveFD(mSocket);
+	close(mSocket);
+}
+
+bool UDPSocket::SendTo(uint32_t pIPv4,uint16_t pPort,const void* pData,size_t pSize)
+{
+	sockaddr_in address;
+	memset(&address,0,sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = pIPv4;
+	address.sin_port = htons(pPort);
+	return sendto(mSocket,pData,pSize,MSG_NOSIGNAL,(struct sockaddr*)&address,sizeof(address)) == (ssize_t)pSize;
+}
+
+void UDPSocket::ReadAll()
+{
+	for(;;)
+	{
+		sockaddr_in from;
+		socklen_t size = sizeof(from);
+		const ssize_t got = recvfrom(mSocket,mBuffer.data(),mBuffer.size(),0,(struct sockaddr*)&from,&size);
+		if( got < 0 )
+		{
+			if( errno == EINTR )
+				continue;
+			return;
+		}
+		mReceived(*this,from.sin_addr.s_addr,ntohs(from.sin_port),mBuffer.data(),(size_t)got);
+	}
+}
+
+/**
+ * @brief termios wants one of its B values, not the number.
+ */
+static speed_t BaudRateToSpeed(int pBaudRate)
+{
+	switch( pBaudRate )
+	{
+	case 1200:		return B1200;
+	case 2400:		return B2400;
+	case 4800:		return B4800;
+	case 9600:		return B9600;
+	case 19200:		return B19200;
+	case 38400:		return B38400;
+	case 57600:		return B57600;
+	case 115200:	return B115200;
+	case 230400:	return B230400;
+	case 460800:	return B460800;
+	case 500000:	return B500000;
+	case 576000:	return B576000;
+	case 921600:	return B921600;
+	case 1000000:	return B1000000;
+	case 1500000:	return B1500000;
+	case 2000000:	return B2000000;
+	case 3000000:	return B3000000;
+	case 4000000:	return B4000000;
+	}
+	TINYTOOLS_THROW("SerialPort baud rate " + std::to_string(pBaudRate) + " is not supported");
+}
+
+SerialPort::SerialPort(const std::string& pDevice,int pBaudRate,size_t pRingBufferSize,size_t pMaxFrameSize):
+	mMaxFrameSize(pMaxFrameSize)
+{
+	mFileDescriptor = open(pDevice.c_str(),O_RDWR|O_NOCTTY|O_NONBLOCK|O_CLOEXEC);
+	if( mFileDescriptor < 0 )
+	{
+		TINYTOOLS_THROW("SerialPort failed to open " + pDevice + ", " + std::string(strerror(errno)));
+	}
+	Setup(pBaudRate,pRingBufferSize);
+}
+
+SerialPort::SerialPort(int pFileDescriptor,int pBaudRate,size_t pRingBufferSize,size_t pMaxFrameSize):
+	mFileDescriptor(pFileDescriptor),
+	mMaxFrameSize(pMaxFrameSize)
+{
+	if( mFileDescriptor < 0 )
+	{
+		TINYTOOLS_THROW("SerialPort passed an invalid file descriptor");
+	}
+	fcntl(mFileDescriptor,F_SETFL,fcntl(mFileDescriptor,F_GETFL) | O_NONBLOCK);
+	Setup(pBaudRate,pRingBufferSize);
+}
+
+SerialPort::~SerialPort()
+{
+	close(mFileDescriptor);
+}
+
+void SerialPort::Setup(int pBaudRate,size_t pRingBufferSize)
+{
+	// Raw, 8N1, no flow control, no echo, no translating of CR / LF or anything else. Every byte as it is.
+	struct termios options;
+	if( tcgetattr(mFileDescriptor,&options) != 0 )
+	{
+		const std::string error = strerror(errno);
+		close(mFileDescriptor);
+		TINYTOOLS_THROW("SerialPort tcgetattr failed, " + error);
+	}
+
+	cfmakeraw(&options);
+	options.c_cflag |= CLOCAL | CREAD;
+	options.c_cflag &= ~(CSTOPB | CRTSCTS);
+	options.c_cc[VMIN] = 0;
+	options.c_cc[VTIME] = 0;
+
+	try
+	{
+		const speed_t speed = BaudRateToSpeed(pBaudRate);
+		cfsetispeed(&options,speed);
+		cfsetospeed(&options,speed);
+	}
+	catch( std::runtime_error& )
+	{
+		close(mFileDescriptor);
+		throw;
+	}
+
+	if( tcsetattr(mFileDescriptor,TCSANOW,&options) != 0 )
+	{
+		const std::string error = strerror(errno);
+		close(mFileDescriptor);
+		TINYTOOLS_THROW("SerialPort tcsetattr failed, " + error);
+	}
+	tcflush(mFileDescriptor,TCIOFLUSH);// Throw away anything from before we set it up.
+
+	size_t size = 64;
+	while( size < pRingBufferSize )
+	{
+		size <<= 1;
+	}
+	mRing.resize(size);
+	mRingMask = size - 1;
+}
+
+void SerialPort::SetReadTiming(uint8_t pMinBytes,uint8_t pTenthsOfSecond)
+{
+	struct termios options;
+	if( tcgetattr(mFileDescriptor,&options) != 0 )
+	{
+		TINYTOOLS_THROW("SerialPort tcgetattr failed, " + std::string(strerror(errno)));
+	}
+
+	options.c_cc[VMIN] = pMinBytes;
+	options.c_cc[VTIME] = pTenthsOfSecond;
+	if( tcsetattr(mFileDescriptor,TCSANOW,&options) != 0 )
+	{
+		TINYTOOLS_THROW("SerialPort tcsetattr failed, " + std::string(strerror(errno)));
+	}
+
+	// VMIN and VTIME do nothing when non blocking.
+	mBlocking = pMinBytes > 0 || pTenthsOfSecond > 0;
+	const int flags = fcntl(mFileDescriptor,F_GETFL);
+	fcntl(mFileDescriptor,F_SETFL,mBlocking ? (flags & ~O_NONBLOCK) : (flags | O_NONBLOCK));
+}
+
+ssize_t SerialPort::Fill()
+{
+	ssize_t total = 0;
+	while( GetAvailable() < mRing.size() )
+	{
+		// Read into the space up to the end of the ring, then round again if that filled it.
+		const size_t start = mHead & mRingMask;
+		const size_t space = std::min(mRing.size() - GetAvailable(),mRing.size() - start);
+		const ssize_t got = read(mFileDescriptor,mRing.data() + start,space);
+		if( got < 0 )
+		{
+			if( errno == EINTR )
+				continue;
+			if( errno == EAGAIN || errno == EWOULDBLOCK )
+				break;
+			return total > 0 ? total : -1;
+		}
+
+		mHead += got;
+		total += got;
+		if( mBlocking || (size_t)got < space )
+			break;// Got all there is, or we'd block.
+	}
+	return total;
+}
+
+bool SerialPort::WaitForData(int pTimeoutMS)
+{
+	struct pollfd wait = {mFileDescriptor,POLLIN,0};
+	return poll(&wait,1,pTimeoutMS) > 0 && (wait.revents & POLLIN);
+}
+
+size_t SerialPort::Read(uint8_t* rData,size_t pMaxSize)
+{
+	const size_t size = std::min(pMaxSize,GetAvailable());
+	const size_t start = mTail & mRingMask;
+	const size_t first = std::min(size,mRing.size() - start);
+	memcpy(rData,mRing.data() + start,first);
+	memcpy(rData + first,mRing.data(),size - first);
+	mTail += size;
+	return size;
+}
+
+size_t SerialPort::ReadFrames(std::function<bool(const uint8_t* p7Bit,size_t p7BitSize)> pFrame)
+{
+	// ParseFrames wants it all in one piece, so move it after what was left last time.
+	const size_t kept = mFrames.size();
+	mFrames.resize(kept + GetAvailable());
+	Read(mFrames.data() + kept,mFrames.size() - kept);
+
+	size_t numFrames = 0;
+	const size_t parsed = ParseFrames(mFrames.data(),mFrames.size(),[this,&numFrames,&pFrame](const uint8_t* p7Bit,size_t p7BitSize)
+	{
+		if( p7BitSize + 2 > mMaxFrameSize )
+			return true;
+
+		numFrames++;
+		return pFrame(p7Bit,p7BitSize);
+	});
+	mFrames.erase(mFrames.begin(),mFrames.begin() + parsed);
+	if( IsOversizedPartialFrame(mFrames.data(),mFrames.size(),mMaxFrameSize) )
+	{// Same as FrameReader, a frame that is too big is dropped and we resync on the next FRAME_START.
+		mFrames.clear();
+	}
+	return numFrames;
+}
+
+void SerialPort::Write(const uint8_t* pData,size_t pSize)
+{
+	mWriteQueue.insert(mWriteQueue.end(),pData,pData + pSize);
+}
+
+void SerialPort::WriteFrame(const uint8_t* p8Bit,size_t p8BitSize)
+{
+	const size_t frameSize = Encoded7BitSize(p8BitSize) + 2;
+	const size_t start = mWriteQueue.size();
+	mWriteQueue.resize(start + frameSize);
+
+	uint8_t* frame = mWriteQueue.data() + start;
+	frame[0] = FRAME_START;
+	Encode7Bit(p8Bit,p8BitSize,frame + 1,frameSize - 2);
+	frame[frameSize-1] = FRAME_END;
+}
+
+bool SerialPort::Flush()
+{
+	while( mWriteOffset < mWriteQueue.size() )
+	{
+		const ssize_t written = write(mFileDescriptor,mWriteQueue.data() + mWriteOffset,mWriteQueue.size() - mWriteOffset);
+		if( written < 0 )
+		{
+			if( errno == EINTR )
+				continue;
+
+			// If the port is slow the queue could keep growing at the back while going at the front, so drop what has gone.
+			if( mWriteOffset > mWriteQueue.size() / 2 )
+			{
+				mWriteQueue.erase(mWriteQueue.begin(),mWriteQueue.begin() + mWriteOffset);
+				mWriteOffset = 0;
+			}
+			return false;
+		}
+		mWriteOffset += written;
+	}
+
+	// Keep the capacity, the next lot of writes won't have to allocate.
+	mWriteQueue.clear();
+	mWriteOffset = 0;
+	return true;
+}
+
+};// namespace network
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////
+namespace system{
+
+std::string GetLocalDateTime()
+{
+	auto t = std::time(nullptr);
+	char mbstr[100];
+	std::strftime(mbstr,sizeof(mbstr), "%d-%m-%Y %H-%M-%S",std::localtime(&t));
+    return mbstr;
+}
+
+/**
+ * @brief Fetches the system uptime in a more human readable format
+ */
+bool GetUptime(uint64_t& rUpDays,uint64_t& rUpHours,uint64_t& rUpMinutes)
+{
+    rUpDays = 0;
+    rUpHours = 0;
+    rUpMinutes = 0;
+
+    std::ifstream upTimeFile("/proc/uptime");
+    if( upTimeFile.is_open() )
+    {
+        rUpDays = 999;
+        char buf[256];
+        buf[255] = 0;
+        if( upTimeFile.getline(buf,255,' ') )
+        {
+            const uint64_t secondsInADay = 60 * 60 * 24;
+            const uint64_t secondsInAnHour = 60 * 60;
+            const uint64_t secondsInAMinute = 60;
+
+            const uint64_t totalSeconds = std::stoull(buf);
+            rUpDays = totalSeconds / secondsInADay;
+            rUpHours = (totalSeconds - (rUpDays*secondsInADay)) / secondsInAnHour;
+            rUpMinutes = (totalSeconds - (rUpDays*secondsInADay) - (rUpHours * secondsInAnHour) ) / secondsInAMinute;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string GetUptime()
+{
+	uint64_t upDays,upHours,upMinutes;
+	GetUptime(upDays,upHours,upMinutes);
+	std::string upTime;
+	std::string space;
+	if( upDays > 0 )
+	{
+		if( upDays == 1 )
+		{
+			upTime = "1 Day";
+		}
+		else
+		{
+			upTime = std::to_string(upDays) + " Days";
+		}
+		space = " ";
+	}
+
+	if( upHours > 0 )
+	{
+		if( upHours == 1 )
+		{
+			upTime += space + "1 Hour";
+		}
+		else
+		{
+			upTime += space + std::to_string(upHours) + " Hours";
+		}
+		space = " ";
+	}
+
+	if( upMinutes == 1 )
+	{
+		upTime += "1 Minute";
+	}
+	else
+	{
+		upTime += space + std::to_string(upMinutes) + " Minutes";
+	}
+
+	return upTime;
+}
+
+bool GetCPULoad(std::map<int,CPULoadTracking>& pTrackingData,int& rTotalSystemLoad,std::map<int,int>& rCoreLoads)
+{
+	// If pTrackingData is empty then we're initalising the state so lets build our starting point.
+	const bool initalising = pTrackingData.size() ==  0;
+
+	std::ifstream statFile("/proc/stat");
+	if( statFile.is_open() )
+	{
+		// Written so that it'll read the lines in any order. Easy to do and safe.
+		while( statFile.eof() == false )
+		{
+			std::string what;
+			statFile >> what;
+			if( string::CompareNoCase(what,"cpu") )
+			{
+				// The the rest of the bits we want.
+				std::string usertimeSTR, nicetimeSTR, systemtimeSTR, idletimeSTR, ioWaitSTR, irqSTR, softIrqSTR, stealSTR, guestSTR, guestniceSTR;
+				statFile >> usertimeSTR >>
+								 nicetimeSTR >>
+								 systemtimeSTR >>
+								 idletimeSTR >>
+								 ioWaitSTR >>
+								 irqSTR >>
+								 softIrqSTR >>
+								 stealSTR >>
+								 guestSTR >>
+								 guestniceSTR;
+				// Read rest of line.
+				std::string eol;
+				std::getline(statFile,eol,'\n');
+
+				const uint64_t userTime = std::stoull(usertimeSTR);	
+				const uint64_t niceTime = std::stoull(nicetimeSTR);
+				const uint64_t idleTime = std::stoull(idletimeSTR);
+				const uint64_t stealTime = std::stoull(stealSTR);
+				
+				const uint64_t systemAllTime = std::stoull(systemtimeSTR) + std::stoull(irqSTR) + std::stoull(softIrqSTR);
+//				const uint64_t virtualTime = std::stoull(guestSTR) + std::stoull(guestniceSTR); // According to a comment in hot, guest and guest nice are already incorerated in user time.
+				const uint64_t totalTime = userTime + niceTime + systemAllTime + idleTime + stealTime; // No need to add virtualTime, I want that to be part of user time. If not will not see load on CPU from virtual guest.
+
+				int cpuID = -1; // This is the total system load.
+				if( what.size() > 3 )
+				{
+					sscanf(what.data(),"cpu%d",&cpuID);
+					if( cpuID < 0 || cpuID > 128 )
+					{
+						TINYTOOLS_THROW("Error in GetCPULoad, cpu Id read from /proc/stat has a massive index, not going ot happen mate... cpuID == " + std::to_string(cpuID));
+					}
+				}
+
+				if( initalising )
+				{
+					if( pTrackingData.find(cpuID) != pTrackingData.end() )
+					{
+						TINYTOOLS_THROW("Error in GetCPULoad, trying to initalising and found a duplicate CPU id, something went wrong. cpuID == " + std::to_string(cpuID));
+					}
+
+					CPULoadTracking info;
+					info.mUserTime		= userTime;
+					info.mTotalTime		= totalTime;
+					pTrackingData.emplace(cpuID,info);
+				}
+				else
+				{
+					// Workout the deltas to get cpu load in percentage.
+					auto core = pTrackingData.find(cpuID);
+					if( core == pTrackingData.end() )
+					{
+						TINYTOOLS_THROW("Error in GetCPULoad, trying to workout load but found a new CPU id, something went wrong. cpuID == " + std::to_string(cpuID));
+					}
+
+					// Copied from htop!
+					// Since we do a subtraction (usertime - guest) and cputime64_to_clock_t()
+					// used in /proc/stat rounds down numbers, it can lead to a case where the
+					// integer overflow.
+					#define WRAP_SUBTRACT(a,b) (a > b) ? a - b : 0					
+					const uint64_t deltaUser = WRAP_SUBTRACT(userTime,core->second.mUserTime);
+					const uint64_t deltaTotal = WRAP_SUBTRACT(totalTime,core->second.mTotalTime);
+					#undef WRAP_SUBTRACT
+					core->second.mUserTime = userTime;
+					core->second.mTotalTime = totalTime;
+
+					if( deltaTotal > 0 )
+					{
+						const uint64_t percentage = deltaUser * 100 / deltaTotal;
+						if( cpuID == -1 )
+						{
+							rTotalSystemLoad = (int)percentage;
+						}
+						else
+						{
+							rCoreLoads[cpuID] = (int)percentage;
+						}
+					}
+					else
+					{
+						if( cpuID == -1 )
+						{
+							rTotalSystemLoad = 0;
+						}
+						else
+						{
+							rCoreLoads[cpuID] = 0;
+						}
+					}
+				}
+			}
+		}
+		return true;
+	}
+	return false;
+}
+
+bool GetMemoryUsage(size_t& rMemoryUsedKB,size_t& rMemAvailableKB,size_t& rMemTotalKB,size_t& rSwapUsedKB)
+{
+	std::ifstream memFile("/proc/meminfo");
+	if( memFile.is_open() )
+	{
+		// We'll build a map of the data lines that have key: value combination.
+		std::map<std::string,size_t> keyValues;
+		while( memFile.eof() == false )
+		{
+			std::string memLine;
+			std::getline(memFile,memLine);
+			if( memLine.size() > 0 )
+			{
+				std::vector<std::string> memParts = string::SplitString(memLine," ");// Have to do like this as maybe two or three parts. key: value [kb]
+				if( memParts.size() != 2 && memParts.size() != 3 )
+				{
+					TINYTOOLS_THROW("Failed to correctly read a line from /proc/meminfo did the format change? Found line \"" + memLine + "\" and split it into " + std::to_string(memParts.size()) + " parts");
+				}
+
+				if( memParts[0].back() == ':' )
+				{
+					memParts[0].pop_back();
+					keyValues[memParts[0]] = std::stoull(memParts[1]);
+				}
+			}
+		}
+
+		try
+		{
+			const size_t Buffers = keyValues.at("Buffers");
+			const size_t Cached = keyValues["Cached"];
+			const size_t SReclaimable = keyValues["SReclaimable"];
+			const size_t MemAvailable = keyValues["MemAvailable"];
+			const size_t MemTotal = keyValues["MemTotal"];
+			const size_t MemFree = keyValues["MemFree"];
+			const size_t SwapFree = keyValues["SwapFree"];
+			const size_t SwapTotal = keyValues["SwapTotal"];
+
+			const size_t mainCached = Cached + SReclaimable;
+			// if kb_main_available is greater than kb_main_total or our calculation of
+			// mem_used overflows, that's symptomatic of running within a lxc container
+			// where such values will be dramatically distorted over those of the host.
+			if (MemAvailable > MemTotal)
+			{
+				rMemAvailableKB = MemFree;
+			}
+			else
+			{
+				rMemAvailableKB = MemAvailable;
+			}
+
+			rMemoryUsedKB = MemTotal - MemFree - mainCached - Buffers;
+			if (rMemoryUsedKB < 0)
+			{
+				rMemoryUsedKB = MemTotal - MemFree;
+			}
+
+			rMemTotalKB = MemTotal;
+			rSwapUsedKB = SwapTotal - SwapFree;
+
+			return true;
+		}
+		catch( std::out_of_range& e ){std::cerr << " failed to read all the data needed from /proc/meminfo " << e.what();}// We'll return false so they know something went wrong.
+	}
+	return false;
+}
+
+static char* CopyArg(const std::string& pString)
+{
+    char *newString = nullptr;
+    const size_t len = pString.length();
+    if( len > 0 )
+    {
+        newString = new char[len + 1];
+        for( size_t n = 0 ; n < len ; n++ )
+            newString[n] = pString.at(n);
+        newString[len] = 0;
+    }
+
+    return newString;
+}
+
+static void BuildArgArray(char** pTheArgs, const std::vector<std::string>& pArgs)
+{    
+    for (const std::string& Arg : pArgs)
+    {
+        char* str = CopyArg(Arg);
+        if(str)
+        {
+            //Trim leading white space.
+            while(isspace(str[0]) && str[0])
+                str++;
+
+            if(str[0])
+            {
+                *pTheArgs = str;
+                pTheArgs++;
+            }
+        }
+    }
+    *pTheArgs = nullptr;
+}
+
+bool ExecuteShellCommand(const std::string& pCommand,const std::vector<std::string>& pArgs,const std::map<std::string,std::string>& pEnv, std::string& rOutput)
+{
+    const bool VERBOSE = false;
+    if (pCommand.size() == 0 )
+    {
+        std::cerr << "ExecuteShellCommand Command name for was zero length! No command given!\n";
+        return false;
+    }
+
+    int pipeSTDOUT[2];
+    int result = pipe(pipeSTDOUT);
+    if (result < 0)
+    {
+        perror("pipe");
+        exit(-1);
+    }
+
+    int pipeSTDERR[2];
+    result = pipe(pipeSTDERR);
+    if (result < 0)
+    {
+        perror("pipe");
+        exit(-1);
+    }
+
+    /* print error message if fork() fails */
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        std::cout << "ExecuteShellCommand Fork failed" << std::endl;
+        return false;
+    }
+
+    /* fork() == 0 for child process */
+    if (pid == 0)
+    {
+        dup2(pipeSTDOUT[1], STDOUT_FILENO ); /* Duplicate writing end to stdout */
+        close(pipeSTDOUT[0]);
+        close(pipeSTDOUT[1]);
+
+        dup2(pipeSTDERR[1], STDERR_FILENO ); /* Duplicate writing end to stdout */
+        close(pipeSTDERR[0]);
+        close(pipeSTDERR[1]);
+
+        ExecuteCommand(pCommand,pArgs,pEnv);
+    }
+
+    /*
+     * parent process
+     */
+
+    /* Parent process */
+    close(pipeSTDOUT[1]); /* Close writing end of pipes, don't need them */
+    close(pipeSTDERR[1]); /* Close writing end of pipes, don't need them */
+
+    const size_t BufSize = 1000;
+    char buf[BufSize+1];
+    buf[BufSize] = 0;
+
+    struct pollfd Pipes[] =
+    {
+        {pipeSTDOUT[0],POLLIN,0},
+        {pipeSTDERR[0],POLLIN,0},
+    };
+
+    int NumPipesOk = 2;
+    std::stringstream outputStream;
+    do
+    {
+        int ret = poll(Pipes,2,1000);
+        if( ret < 0 )
+        {
+            rOutput = "Error, pipes failed. Can't capture process output";
+            NumPipesOk = 0;
+        }
+        else if(ret  > 0 )
+        {
+            for(int n = 0 ; n < 2 ; n++ )
+            {
+                if( (Pipes[n].revents&POLLIN) != 0 )
+                {
+                    ssize_t num = read(Pipes[n].fd,buf,BufSize);
+                    if( num > 0 )
+                    {
+                        buf[num] = 0;
+                        outputStream << buf;
+                    }
+                }
+                else if( (Pipes[n].revents&(POLLERR|POLLHUP|POLLNVAL)) != 0 && Pipes[n].events != 0 )
+                {
+                    Pipes[n].fd = -1;
+                    NumPipesOk--;
+                }
+            }
+        }
+    }while(NumPipesOk>0);
+    rOutput = outputStream.str();
+
+    int status;
+    bool Worked = false;
+    if( wait(&status) == -1 )
+    {
+        std::cout << "Failed to wait for child process." << std::endl;
+    }
+    else
+    {
+        if(WIFEXITED(status) && WEXITSTATUS(status) != 0)//did the child terminate normally?
+        {
+            if( VERBOSE )
+                std::cout << (long)pid << " exited with return code " << WEXITSTATUS(status) << std::endl;
+        }
+        else if (WIFSIGNALED(status))// was the child terminated by a signal?
+        {
+            if( VERBOSE )
+                std::cout << (long)pid << " terminated because it didn't catch signal number " << WTERMSIG(status) << std::endl;
+        }
+        else
+        {// Get here, then all is ok.
+            Worked = true;
+        }
+    }
+
+    return Worked;
+}
+
+void ExecuteCommand(const std::string& pCommand,const std::vector<std::string>& pArgs,const std::map<std::string,std::string>& pEnv)
+{
+    // +1 for the NULL and +1 for the file name as per convention, see https://linux.die.net/man/3/execlp.
+    char** TheArgs = new char*[pArgs.size() + 2];
+    TheArgs[0] = CopyArg(pCommand);
+    BuildArgArray(TheArgs+1,pArgs);
+
+    // Build the environment variables.
+    for( const auto& var : pEnv )
+    {
+        setenv(var.first.c_str(),var.second.c_str(),1);
+    }
+
+    // This replaces the current process so no need to clean up the memory leaks before here. ;)
+    execvp(TheArgs[0], TheArgs);
+
+    const char* errorString = strerror(errno);
+
+    std::cerr << "ExecuteCommand execvp() failure!\n" << "    Error: " << errorString << "\n    This print is after execvp() and should not have been executed if execvp were successful!\n";
+
+    // Should never get here!
+    throw std::runtime_error("Command execution failed! Should not have returned! " + pCommand + " Error: " + errorString);
+    // Really make sure the process is gone...
+    _exit(1);
+}
+
+};//namespace system{
+///////////////////////////////////////////////////////////////////////////////////////////////////////////
+namespace threading{
+
+void SleepableThread::Tick(int pPauseInterval,std::function<void()> pTheWork)
+{
+	if( pTheWork == nullptr )
+	{
+		TINYTOOLS_THROW("SleepableThread passed nullpoint for the work to do...");
+	}
+
+        mKeepGoing = true;
+	mWorkerThread = std::thread([this,pPauseInterval,pTheWork]()
+	{
+		while(mKeepGoing)
+		{
+			pTheWork();
+			std::unique_lock<std::mutex> lk(mSleeperMutex);
+			mSleeper.wait_for(lk,std::chrono::seconds(pPauseInterval));
+		};
+	});
+}
+
+void SleepableThread::TellThreadToExitAndWait()
+{
+	mKeepGoing = false;
+	mSleeper.notify_one();
+	if( mWorkerThread.joinable() )
+	{
+		mWorkerThread.join();
+	}
+}
+
+/**
+ * @brief Registers the process for expedited membarrier, once. Returns false if the kernel is too old or it's blocked.
+ */
+static bool RegisterMembarrier()
+{
+    static const bool registered = syscall(SYS_membarrier,MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED,0,0) == 0;
+    return registered;
+}
+
+/**
+ * @brief Spins then sleeps on the futex rParked until pReady says yes or we run out of time. Shared with the other ring buffers.
+ * pShared for a futex in memory shared between processes. Without pUseMembarrier a fence is used after saying we're parked.
+ */
+static bool SpinThenPark(std::atomic<uint32_t>& rParked,int pTimeoutMS,bool pShared,bool pUseMembarrier,const std::function<bool()>& pReady)
+{
+    // Spin a little first, the other side is often only a moment away and a sleep and wake costs microseconds.
+    for( int n = 0 ; n < 200 ; n++ )
+    {
+        if( pReady() )
+            return true;
+#ifdef TINYTOOLS_X86_SIMD
+        _mm_pause();
+#endif
+    }
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(pTimeoutMS);
+    for(;;)
+    {
+        // Say we're parked and then look again, the barrier pairs with WakeIfParked.
+        rParked.store(1,std::memory_order_relaxed);
+        if( pUseMembarrier )
+            syscall(SYS_membarrier,MEMBARRIER_CMD_PRIVATE_EXPEDITED,0,0);
+        else
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        if( pReady() )
+        {
+            rParked.store(0,std::memory_order_relaxed);
+            return true;
+        }
+
+        struct timespec timeout;
+        struct timespec* timeoutPtr = nullptr;
+        if( pTimeoutMS >= 0 )
+        {
+            const auto left = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - std::chrono::steady_clock::now()).count();
+            if( left <= 0 )
+            {
+                rParked.store(0,std::memory_order_relaxed);
+                return false;
+            }
+            timeout.tv_sec = left / 1000000000;
+            timeout.tv_nsec = left % 1000000000;
+            timeoutPtr = &timeout;
+        }
+
+        // Returns straight away if the other side has already cleared it to wake us.
+        syscall(SYS_futex,&rParked,pShared ? FUTEX_WAIT : FUTEX_WAIT_PRIVATE,1,timeoutPtr,nullptr,0);
+    }
+}
+
+LocklessRingBuffer::LocklessRingBuffer(size_t pItemSizeof,size_t pItemCount)
+{
+    // A power of two so wrapping is a mask and not a divide.
+    size_t itemCount = 1;
+    while( itemCount < pItemCount )
+    {
+        itemCount <<= 1;
+    }
+
+    mBuffer = new uint8_t[pItemSizeof * itemCount];
+    mItemSizeof = pItemSizeof;
+    mItemCount = itemCount;
+    mItemMask = itemCount - 1;
+    mReadCount = 0;
+    mReadersWriteCount = 0;
+    mWriteCount = 0;
+    mWritersReadCount = 0;
+    mReaderParked = 0;
+    mWriterParked = 0;
+    mUseMembarrier = RegisterMembarrier();
+}
+
+LocklessRingBuffer::~LocklessRingBuffer()
+{
+    delete []mBuffer;
+}
+
+bool LocklessRingBuffer::ReadNext(void* rItem,size_t pBufferSize)
+{
+    // Only we change mReadCount so no ordering needed to read it.
+    const size_t readCount = mReadCount.load(std::memory_order_relaxed);
+
+    // If we have caught up with our copy of the write count get the real one, if it's the same the buffer is empty.
+    // Acquire so the item the writer wrote is there for us to read.
+    if( readCount == mReadersWriteCount )
+    {
+        mReadersWriteCount = mWriteCount.load(std::memory_order_acquire);
+        if( readCount == mReadersWriteCount )
+            return false;
+    }
+
+    // Copy before advancing the read count so it can't get over written.
+    const size_t numBytesToCopy = pBufferSize < mItemSizeof ? pBufferSize : mItemSizeof;
+    memcpy(rItem,mBuffer + ((readCount & mItemMask) * mItemSizeof),numBytesToCopy);
+
+    // Release so we're done with the item before the writer sees it's free.
+    mReadCount.store(readCount + 1,std::memory_order_release);
+    WakeIfParked(mWriterParked);
+    return true;
+}
+
+bool LocklessRingBuffer::WriteNext(const void* pItem,size_t pBufferSize)
+{
+    const size_t writeCount = mWriteCount.load(std::memory_order_relaxed);
+
+    // Counts don't wrap, so full is when we're a whole buffer ahead of the reader.
+    if( writeCount - mWritersReadCount == mItemCount )
+    {
+        mWritersReadCount = mReadCount.load(std::memory_order_acquire);
+        if( writeCount - mWritersReadCount == mItemCount )
+            return false;// Full, data not written.
+    }
+
+    const size_t numBytesToCopy = pBufferSize < mItemSizeof ? pBufferSize : mItemSizeof;
+    memcpy(mBuffer + ((writeCount & mItemMask) * mItemSizeof),pItem,numBytesToCopy);
+
+    // Release so the item is there before the reader sees the new count.
+    mWriteCount.store(writeCount + 1,std::memory_order_release);
+    WakeIfParked(mReaderParked);
+    return true;// Written ok.
+}
+
+size_t LocklessRingBuffer::ReadBatch(void* rItems,size_t pMaxItems)
+{
+    const size_t readCount = mReadCount.load(std::memory_order_relaxed);
+
+    // Only go for the real write count if our copy does not have enough for the whole batch.
+    size_t available = mReadersWriteCount - readCount;
+    if( available < pMaxItems )
+    {
+        mReadersWriteCount = mWriteCount.load(std::memory_order_acquire);
+        available = mReadersWriteCount - readCount;
+    }
+
+    const size_t numItems = available < pMaxItems ? available : pMaxItems;
+    if( numItems == 0 )
+        return 0;
+
+    CopyOut(readCount,(uint8_t*)rItems,numItems);
+
+    mReadCount.store(readCount + numItems,std::memory_order_release);
+    WakeIfParked(mWriterParked);
+    return numItems;
+}
+
+size_t LocklessRingBuffer::WriteBatch(const void* pItems,size_t pNumItems)
+{
+    const size_t writeCount = mWriteCount.load(std::memory_order_relaxed);
+
+    size_t space = mItemCount - (writeCount - mWritersReadCount);
+    if( space < pNumItems )
+    {
+        mWritersReadCount = mReadCount.load(std::memory_order_acquire);
+        space = mItemCount - (writeCount - mWritersReadCount);
+    }
+
+    const size_t numItems = space < pNumItems ? space : pNumItems;
+    if( numItems == 0 )
+        return 0;
+
+    CopyIn(writeCount,(const uint8_t*)pItems,numItems);
+
+    mWriteCount.store(writeCount + numItems,std::memory_order_release);
+    WakeIfParked(mReaderParked);
+    return numItems;
+}
+
+bool LocklessRingBuffer::ReadWait(void* rItem,size_t pBufferSize,int pTimeoutMS)
+{
+    if( ReadNext(rItem,pBufferSize) )
+        return true;
+
+    // Ready when the write count has moved past what we've read.
+    const size_t readCount = mReadCount.load(std::memory_order_relaxed);
+    if( SpinThenPark(mReaderParked,pTimeoutMS,false,mUseMembarrier,[this,readCount](){return mWriteCount.load(std::memory_order_acquire) != readCount;}) == false )
+        return false;
+
+    return ReadNext(rItem,pBufferSize);
+}
+
+bool LocklessRingBuffer::WriteWait(const void* pItem,size_t pBufferSize,int pTimeoutMS)
+{
+    if( WriteNext(pItem,pBufferSize) )
+        return true;
+
+    const size_t writeCount = mWriteCount.load(std::memory_order_relaxed);
+    if( SpinThenPark(mWriterParked,pTimeoutMS,false,mUseMembarrier,[this,writeCount](){return writeCount - mReadCount.load(std::memory_order_acquire) != mItemCount;}) == false )
+        return false;
+
+    return WriteNext(pItem,pBufferSize);
+}
+
+void LocklessRingBuffer::Wake(std::atomic<uint32_t>& pParked)
+{
+    pParked.store(0,std::memory_order_relaxed);
+    syscall(SYS_futex,&pParked,FUTEX_WAKE_PRIVATE,1,nullptr,nullptr,0);
+}
+
+void LocklessRingBuffer::CopyOut(size_t pFromCount,uint8_t* rItems,size_t pNumItems)const
+{
+    // At most two copies, up to the end of the buffer and then the rest from the start.
+    const size_t index = pFromCount & mItemMask;
+    const size_t firstPart = std::min(pNumItems,mItemCount - index);
+    memcpy(rItems,mBuffer + (index * mItemSizeof),firstPart * mItemSizeof);
+    if( firstPart < pNumItems )
+    {
+        memcpy(rItems + (firstPart * mItemSizeof),mBuffer,(pNumItems - firstPart) * mItemSizeof);
+    }
+}
+
+void LocklessRingBuffer::CopyIn(size_t pToCount,const uint8_t* pItems,size_t pNumItems)
+{
+    const size_t index = pToCount & mItemMask;
+    const size_t firstPart = std::min(pNumItems,mItemCount - index);
+    memcpy(mBuffer + (index * mItemSizeof),pItems,firstPart * mItemSizeof);
+    if( firstPart < pNumItems )
+    {
+        memcpy(mBuffer,pItems + (firstPart * mItemSizeof),(pNumItems - firstPart) * mItemSizeof);
+    }
+}
+
+LocklessMPMCBuffer::LocklessMPMCBuffer(size_t pItemSizeof,size_t pItemCount)
+{
+    // Needs at least two cells, with one the sequence a reader leaves behind is the same as the next write count so a second write would land on an unread item.
+    size_t itemCount = 2;
+    while( itemCount < pItemCount )
+    {
+        itemCount <<= 1;
+    }
+
+    const size_t align = alignof(std::atomic<size_t>);
+    mItemSizeof = pItemSizeof;
+    mCellSizeof = (sizeof(std::atomic<size_t>) + pItemSizeof + align - 1) & ~(align - 1);
+    mItemCount = itemCount;
+    mItemMask = itemCount - 1;
+    mBuffer = new uint8_t[mCellSizeof * itemCount];
+
+    // A cell is free to write when its sequence equals the write count that lands on it.
+    for( size_t n = 0 ; n < itemCount ; n++ )
+    {
+        new(GetSequence(n)) std::atomic<size_t>(n);
+    }
+    mReadCount = 0;
+    mWriteCount = 0;
+}
+
+LocklessMPMCBuffer::~LocklessMPMCBuffer()
+{
+    delete []mBuffer;
+}
+
+bool LocklessMPMCBuffer::ReadNext(void* rItem,size_t pBufferSize)
+{
+    size_t readCount = mReadCount.load(std::memory_order_relaxed);
+    std::atomic<size_t>* sequence;
+    for(;;)
+    {
+        // Acquire so we see the item the writer put there before it bumped the sequence.
+        sequence = GetSequence(readCount);
+        const intptr_t diff = (intptr_t)sequence->load(std::memory_order_acquire) - (intptr_t)(readCount + 1);
+        if( diff == 0 )
+        {// Written and ready, try to claim it. If another reader got there first readCount is updated for us.
+            if( mReadCount.compare_exchange_weak(readCount,readCount + 1,std::memory_order_relaxed) )
+                break;
+        }
+        else if( diff < 0 )
+        {// Not written yet, empty.
+            return false;
+        }
+        else
+        {// Another reader has had it, catch up.
+            readCount = mReadCount.load(std::memory_order_relaxed);
+        }
+    }
+
+    const size_t numBytesToCopy = pBufferSize < mItemSizeof ? pBufferSize : mItemSizeof;
+    memcpy(rItem,GetItem(readCount),numBytesToCopy);
+
+    // Free for the writer that comes round next time, release so we're done with the item first.
+    sequence->store(readCount + mItemCount,std::memory_order_release);
+    return true;
+}
+
+bool LocklessMPMCBuffer::WriteNext(const void* pItem,size_t pBufferSize)
+{
+    size_t writeCount = mWriteCount.load(std::memory_order_relaxed);
+    std::atomic<size_t>* sequence;
+    for(;;)
+    {
+        sequence = GetSequence(writeCount);
+        const intptr_t diff = (intptr_t)sequence->load(std::memory_order_acquire) - (intptr_t)writeCount;
+        if( diff == 0 )
+        {
+            if( mWriteCount.compare_exchange_weak(writeCount,writeCount + 1,std::memory_order_relaxed) )
+                break;
+        }
+        else if( diff < 0 )
+        {// Still has last time round's item in it, full.
+            return false;
+        }
+        else
+        {
+            writeCount = mWriteCount.load(std::memory_order_relaxed);
+        }
+    }
+
+    const size_t numBytesToCopy = pBufferSize < mItemSizeof ? pBufferSize : mItemSizeof;
+    memcpy(GetItem(writeCount),pItem,numBytesToCopy);
+
+    // Release so the item is there before a reader sees the sequence say it is.
+    sequence->store(writeCount + 1,std::memory_order_release);
+    return true;
+}
+
+/**
+ * @brief What sits at the start of the shared memory, followed by the records. Counts and sizes only, no pointers.
+ */
+struct SharedRingBuffer::Header
+{
+    static constexpr uint32_t MAGIC = 0x54545242;
+    static constexpr uint32_t VERSION = 1;
+    static constexpr uint32_t PARKED_ON_FUTEX = 1;
+    static constexpr uint32_t PARKED_ON_EVENTFD = 2;
+
+    std::atomic<uint32_t> mMagic;           //!< Set last by the producer, so the consumer knows the rest is filled in.
+    uint32_t mVersion;
+    uint64_t mItemSizeof;
+    uint64_t mItemCount;
+    int32_t mProducerPID;
+    int32_t mProducerEventFD;               //!< The fd number in the producer, -1 if none.
+    std::atomic<uint32_t> mProducerClosed;
+
+    alignas(64) std::atomic<uint64_t> mReadCount;
+    std::atomic<uint32_t> mWriterParked;
+
+    alignas(64) std::atomic<uint64_t> mWriteCount;
+    std::atomic<uint32_t> mReaderParked;    //!< PARKED_ON_FUTEX or PARKED_ON_EVENTFD when the consumer wants waking.
+};
+
+static_assert( std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,"SharedRingBuffer needs lock free atomics to work between processes" );
+
+/**
+ * @brief If the process has not ended. A pidfd that is readable means it has, even if it has not been reaped yet.
+ */
+static bool IsProcessRunning(pid_t pPID)
+{
+    const int pidfd = syscall(SYS_pidfd_open,pPID,0);
+    if( pidfd >= 0 )
+    {
+        struct pollfd exited = {pidfd,POLLIN,0};
+        const bool running = poll(&exited,1,0) == 0;
+        close(pidfd);
+        return running;
+    }
+
+    if( errno == ESRCH )
+        return false;
+
+    // No pidfd, old kernel. EPERM means it's there but not ours.
+    return kill(pPID,0) == 0 || errno == EPERM;
+}
+
+SharedRingBuffer::SharedRingBuffer(const std::string& pName,size_t pItemSizeof,size_t pItemCount,bool pUseEventFD):
+    mName(pName.size() && pName[0] == '/' ? pName : "/" + pName),
+    mIsProducer(true)
+{
+    size_t itemCount = 1;
+    while( itemCount < pItemCount )
+    {
+        itemCount <<= 1;
+    }
+
+    // Only take the name over if it was left by a producer that has gone. A running producer, or something that is not ours, is left alone.
+    const int oldFD = shm_open(mName.c_str(),O_RDONLY|O_CLOEXEC,0);
+    if( oldFD >= 0 )
+    {
+        std::string problem;
+        struct stat info;
+        if( fstat(oldFD,&info) != 0 || (size_t)info.st_size < sizeof(Header) )
+        {
+            problem = "is not a ring buffer";
+        }
+        else
+        {
+            void* memory = mmap(nullptr,sizeof(Header),PROT_READ,MAP_SHARED,oldFD,0);
+            if( memory == MAP_FAILED )
+            {
+                problem = "could not be checked : " + std::string(strerror(errno));
+            }
+            else
+            {
+                const Header* old = (const Header*)memory;
+                if( old->mMagic.load(std::memory_order_acquire) != Header::MAGIC )
+                {
+                    problem = "is not a ring buffer, or its producer never finished making it";
+                }
+                else if( old->mProducerClosed.load(std::memory_order_acquire) == 0 && IsProcessRunning(old->mProducerPID) )
+                {
+                    problem = "is in use by the producer with pid " + std::to_string(old->mProducerPID);
+                }
+                munmap(memory,sizeof(Header));
+            }
+        }
+        close(oldFD);
+
+        if( problem.size() )
+        {
+            TINYTOOLS_THROW("SharedRingBuffer " + mName + " already exists and " + problem);
+        }
+        shm_unlink(mName.c_str());
+    }
+
+    const int fd = shm_open(mName.c_str(),O_CREAT|O_EXCL|O_RDWR|O_CLOEXEC,0600);
+    if( fd < 0 )
+    {
+        TINYTOOLS_THROW("SharedRingBuffer failed to create " + mName + " : " + std::string(strerror(errno)));
+    }
+
+    const size_t size = sizeof(Header) + (pItemSizeof * itemCount);
+    if( ftruncate(fd,size) != 0 )
+    {
+        const std::string error = strerror(errno);
+        close(fd);
+        shm_unlink(mName.c_str());
+        TINYTOOLS_THROW("SharedRingBuffer failed to size " + mName + " : " + error);
+    }
+
+    try
+    {
+        Map(fd,size);
+    }
+    catch(...)
+    {
+        close(fd);
+        shm_unlink(mName.c_str());
+        throw;
+    }
+    close(fd);
+
+    if( pUseEventFD )
+    {
+        mEventFD = eventfd(0,EFD_NONBLOCK|EFD_CLOEXEC);
+        if( mEventFD < 0 )
+        {
+            const std::string error = strerror(errno);
+            Detach();
+            TINYTOOLS_THROW("SharedRingBuffer failed to make eventfd : " + error);
+        }
+    }
+
+    // New memory from ftruncate is all zero, so the counts and flags are already right.
+    mItemSizeof = pItemSizeof;
+    mItemMask = itemCount - 1;
+    mHeader->mVersion = Header::VERSION;
+    mHeader->mItemSizeof = pItemSizeof;
+    mHeader->mItemCount = itemCount;
+    mHeader->mProducerPID = getpid();
+    mHeader->mProducerEventFD = mEventFD;
+    mHeader->mMagic.store(Header::MAGIC,std::memory_order_release);
+}
+
+SharedRingBuffer::SharedRingBuffer(const std::string& pName):
+    mName(pName.size() && pName[0] == '/' ? pName : "/" + pName),
+    mIsProducer(false)
+{
+    const int fd = shm_open(mName.c_str(),O_RDWR|O_CLOEXEC,0);
+    if( fd < 0 )
+    {
+        TINYTOOLS_THROW("SharedRingBuffer failed to attach to " + mName + " : " + std::string(strerror(errno)));
+    }
+
+    // We may have got in between the producer making it and filling in the header, give it a moment.
+    for( int tries = 0 ; mHeader == nullptr ; tries++ )
+    {
+        struct stat info;
+        if( fstat(fd,&info) == 0 && (size_t)info.st_size >= sizeof(Header) )
+        {
+            Map(fd,info.st_size);
+            if( mHeader->mMagic.load(std::memory_order_acquire) != Header::MAGIC )
+            {
+                Detach();
+            }
+        }
+
+        if( mHeader == nullptr )
+        {
+            if( tries == 100 )
+            {
+                close(fd);
+                TINYTOOLS_THROW("SharedRingBuffer " + mName + " is not a ring buffer or the producer never finished making it");
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+    close(fd);
+
+    const uint64_t itemCount = mHeader->mItemCount;
+    if( mHeader->mVersion != Header::VERSION || itemCount == 0 || (itemCount & (itemCount - 1)) != 0 ||
+        mMappedSize != sizeof(Header) + (mHeader->mItemSizeof * itemCount) )
+    {
+        Detach();
+        TINYTOOLS_THROW("SharedRingBuffer " + mName + " has a header we don't understand");
+    }
+    mItemSizeof = mHeader->mItemSizeof;
+    mItemMask = itemCount - 1;
+
+    // A pidfd goes readable when the process ends, and unlike kill(pid,0) it can't be fooled by the pid being used again.
+    mProducerPIDFD = syscall(SYS_pidfd_open,mHeader->mProducerPID,0);
+    if( mProducerPIDFD >= 0 && mHeader->mProducerEventFD >= 0 )
+    {
+        mEventFD = syscall(SYS_pidfd_getfd,mProducerPIDFD,mHeader->mProducerEventFD,0);
+    }
+}
+
+SharedRingBuffer::~SharedRingBuffer()
+{
+    Detach();
+}
+
+void SharedRingBuffer::Detach()
+{
+    if( mHeader )
+    {
+        if( mIsProducer )
+        {
+            // Anyone attached keeps their mapping, they just read what's left and then see we've closed.
+            mHeader->mProducerClosed.store(1,std::memory_order_release);
+            WakeReader();
+            shm_unlink(mName.c_str());
+        }
+        munmap(mHeader,mMappedSize);
+        mHeader = nullptr;
+        mItems = nullptr;
+        mMappedSize = 0;
+        mReserved = false;
+        mPeeked = false;
+    }
+
+    if( mEventFD >= 0 )
+    {
+        close(mEventFD);
+        mEventFD = -1;
+    }
+
+    if( mProducerPIDFD >= 0 )
+    {
+        close(mProducerPIDFD);
+        mProducerPIDFD = -1;
+    }
+}
+
+bool SharedRingBuffer::Empty()const
+{
+    CheckAttached("Empty");
+    return mHeader->mReadCount.load(std::memory_order_acquire) == mHeader->mWriteCount.load(std::memory_order_acquire);
+}
+
+void* SharedRingBuffer::Reserve()
+{
+    CheckAttached("Reserve");
+    const uint64_t writeCount = mHeader->mWriteCount.load(std::memory_order_relaxed);
+    if( mReserved == false && writeCount - mCachedCount > mItemMask )
+    {
+        mCachedCount = mHeader->mReadCount.load(std::memory_order_acquire);
+        if( writeCount - mCachedCount > mItemMask )
+            return nullptr;// Full
+    }
+    mReserved = true;
+    return mItems + ((writeCount & mItemMask) * mItemSizeof);
+}
+
+void SharedRingBuffer::Commit()
+{
+    CheckAttached("Commit");
+    if( mReserved == false )
+        TINYTOOLS_THROW("SharedRingBuffer::Commit called without a Reserve");
+
+    mReserved = false;
+    mHeader->mWriteCount.store(mHeader->mWriteCount.load(std::memory_order_relaxed) + 1,std::memory_order_release);
+    WakeReader();
+}
+
+bool SharedRingBuffer::WriteNext(const void* pItem,size_t pBufferSize)
+{
+    void* item = Reserve();
+    if( item == nullptr )
+        return false;
+
+    memcpy(item,pItem,pBufferSize < mItemSizeof ? pBufferSize : mItemSizeof);
+    Commit();
+    return true;
+}
+
+bool SharedRingBuffer::WriteWait(const void* pItem,size_t pBufferSize,int pTimeoutMS)
+{
+    if( WriteNext(pItem,pBufferSize) )
+        return true;
+
+    const uint64_t writeCount = mHeader->mWriteCount.load(std::memory_order_relaxed);
+    if( SpinThenPark(mHeader->mWriterParked,pTimeoutMS,true,false,[this,writeCount](){return writeCount - mHeader->mReadCount.load(std::memory_order_acquire) <= mItemMask;}) == false )
+        return false;
+
+    return WriteNext(pItem,pBufferSize);
+}
+
+const void* SharedRingBuffer::Peek()
+{
+    CheckAttached("Peek");
+    const uint64_t readCount = mHeader->mReadCount.load(std::memory_order_relaxed);
+    if( readCount == mCachedCount )
+    {
+        mCachedCount = mHeader->mWriteCount.load(std::memory_order_acquire);
+        if( readCount == mCachedCount )
+        {
+            if( mEventFD < 0 )
+                return nullptr;
+
+            // Empty, so clear the eventfd and ask to be woken by it. Then look again in case the producer wrote before it saw the request.
+            uint64_t events;
+            if( read(mEventFD,&events,sizeof(events)) ){}
+            mHeader->mReaderParked.store(Header::PARKED_ON_EVENTFD,std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            mCachedCount = mHeader->mWriteCount.load(std::memory_order_acquire);
+            if( readCount == mCachedCount )
+                return nullptr;
+            mHeader->mReaderParked.store(0,std::memory_order_relaxed);
+        }
+    }
+    mPeeked = true;
+    return mItems + ((readCount & mItemMask) * mItemSizeof);
+}
+
+void SharedRingBuffer::Release()
+{
+    CheckAttached("Release");
+    if( mPeeked == false )
+        TINYTOOLS_THROW("SharedRingBuffer::Release called without a Peek");
+
+    mPeeked = false;
+    mHeader->mReadCount.store(mHeader->mReadCount.load(std::memory_order_relaxed) + 1,std::memory_order_release);
+
+    // Pairs with the fence in SpinThenPark. No membarrier here, it only reaches threads in our own process.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if( mHeader->mWriterParked.load(std::memory_order_relaxed) != 0 )
+    {
+        mHeader->mWriterParked.store(0,std::memory_order_relaxed);
+        syscall(SYS_futex,&mHeader->mWriterParked,FUTEX_WAKE,1,nullptr,nullptr,0);
+    }
+}
+
+bool SharedRingBuffer::ReadNext(void* rItem,size_t pBufferSize)
+{
+    const void* item = Peek();
+    if( item == nullptr )
+        return false;
+
+    memcpy(rItem,item,pBufferSize < mItemSizeof ? pBufferSize : mItemSizeof);
+    Release();
+    return true;
+}
+
+bool SharedRingBuffer::ReadWait(void* rItem,size_t pBufferSize,int pTimeoutMS)
+{
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(pTimeoutMS);
+    for(;;)
+    {
+        if( ReadNext(rItem,pBufferSize) )
+            return true;
+
+        // Gone, one last look as it may have written just before going.
+        if( GetProducerState() != PRODUCER_RUNNING )
+            return ReadNext(rItem,pBufferSize);
+
+        // Sleep in short goes so we notice if the producer crashes, a crash can't wake us.
+        int waitMS = 100;
+        if( pTimeoutMS >= 0 )
+        {
+            const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+            if( left <= 0 )
+                return false;
+            waitMS = left < waitMS ? left : waitMS;
+        }
+
+        const uint64_t readCount = mHeader->mReadCount.load(std::memory_order_relaxed);
+        SpinThenPark(mHeader->mReaderParked,waitMS,true,false,[this,readCount]()
+        {
+            return mHeader->mWriteCount.load(std::memory_order_acquire) != readCount || mHeader->mProducerClosed.load(std::memory_order_acquire) != 0;
+        });
+    }
+}
+
+SharedRingBuffer::ProducerState SharedRingBuffer::GetProducerState()const
+{
+    if( mHeader == nullptr || mHeader->mProducerClosed.load(std::memory_order_acquire) != 0 )
+        return PRODUCER_CLOSED;
+
+    if( mIsProducer )
+        return PRODUCER_RUNNING;
+
+    if( mProducerPIDFD >= 0 )
+    {
+        struct pollfd pidfd = {mProducerPIDFD,POLLIN,0};
+        return poll(&pidfd,1,0) > 0 ? PRODUCER_CRASHED : PRODUCER_RUNNING;
+    }
+
+    // No pidfd, old kernel. Good enough unless the pid has been used again.
+    return (kill(mHeader->mProducerPID,0) != 0 && errno == ESRCH) ? PRODUCER_CRASHED : PRODUCER_RUNNING;
+}
+
+void SharedRingBuffer::CheckAttached(const char* pFunction)const
+{
+    if( mHeader == nullptr )
+        TINYTOOLS_THROW("SharedRingBuffer::" + std::string(pFunction) + " called after Detach");
+}
+
+void SharedRingBuffer::Map(int pFD,size_t pSize)
+{
+    void* memory = mmap(nullptr,pSize,PROT_READ|PROT_WRITE,MAP_SHARED,pFD,0);
+    if( memory == MAP_FAILED )
+    {
+        TINYTOOLS_THROW("SharedRingBuffer failed to map " + mName + " : " + std::string(strerror(errno)));
+    }
+    mHeader = (Header*)memory;
+    mItems = (uint8_t*)memory + sizeof(Header);
+    mMappedSize = pSize;
+}
+
+void SharedRingBuffer::WakeReader()
+{
+    // Pairs with the fence the consumer does after saying it's parked, either way.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const uint32_t parked = mHeader->mReaderParked.load(std::memory_order_relaxed);
+    if( parked == 0 )
+        return;
+
+    mHeader->mReaderParked.store(0,std::memory_order_relaxed);
+    if( parked == Header::PARKED_ON_EVENTFD && mEventFD >= 0 )
+    {
+        const uint64_t one = 1;
+        if( write(mEventFD,&one,sizeof(one)) ){}
+    }
+    else
+    {
+        syscall(SYS_futex,&mHeader->mReaderParked,FUTEX_WAKE,1,nullptr,nullptr,0);
+    }
+}
+
+// Which pool the current thread is a worker of, if any, so work it submits goes on its own queue.
+static thread_local ThreadPool* tCurrentPool = nullptr;
+static thread_local size_t tWorkerIndex = 0;
+
+ThreadPool::ThreadPool(size_t pNumThreads,bool pPinThreads):
+    mPending(0),
+    mNextWorker(0),
+    mStopping(false)
+{
+    // The CPUs we may run on, may be less than the machine has if we're in a container or started with taskset.
+    std::vector<int> cpus;
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if( sched_getaffinity(0,sizeof(allowed),&allowed) == 0 )
+    {
+        for( int cpu = 0 ; cpu < CPU_SETSIZE ; cpu++ )
+        {
+            if( CPU_ISSET(cpu,&allowed) )
+                cpus.push_back(cpu);
+        }
+    }
+
+    if( pNumThreads == 0 )
+    {
+        pNumThreads = cpus.size() ? cpus.size() : std::max(1u,std::thread::hardware_concurrency());
+    }
+
+    for( size_t n = 0 ; n < pNumThreads ; n++ )
+    {
+        mWorkers.emplace_back(std::make_unique<Worker>());
+    }
+
+    // All made before any start, as they look in each others queues.
+    for( size_t n = 0 ; n < pNumThreads ; n++ )
+    {
+        mWorkers[n]->mThread = std::thread(&ThreadPool::WorkerLoop,this,n);
+        if( pPinThreads && cpus.size() )
+        {
+            cpu_set_t cpu;
+            CPU_ZERO(&cpu);
+            CPU_SET(cpus[n % cpus.size()],&cpu);
+            pthread_setaffinity_np(mWorkers[n]->mThread.native_handle(),sizeof(cpu),&cpu);
+        }
+    }
 }
 
-static char* CopyArg(const std::string& pString)
+ThreadPool::~ThreadPool()
 {
-    char *newString = nullptr;
-    const size_t len = pString.length();
-    if( len > 0 )
-    {
-        newString = new char[len + 1];
-        for( size_t n = 0 ; n < len ; n++ )
-            newString[n] = pString.at(n);
-        newString[len] = 0;
+    Shutdown();
+}
+
+void ThreadPool::ParallelFor(size_t pBegin,size_t pEnd,const std::function<void(size_t pBegin,size_t pEnd)>& pWork,size_t pChunkSize)
+{
+    if( pBegin >= pEnd )
+        return;
+
+    const size_t count = pEnd - pBegin;
+    if( pChunkSize == 0 )
+    {// A few chunks each so one slow chunk does not hold everyone up.
+        pChunkSize = std::max<size_t>(1,count / (mWorkers.size() * 4));
     }
+    const size_t numChunks = (count + pChunkSize - 1) / pChunkSize;
 
-    return newString;
-}
+    // Everyone, including us, takes the next chunk until there are none left.
+    // Shared so helpers that only get to run after we've returned still have something valid to look at.
+    struct Job
+    {
+        std::atomic<size_t> mNextChunk{0};
+        std::atomic<size_t> mChunksDone{0};
+        std::mutex mMutex;
+        std::condition_variable mDone;
+        std::exception_ptr mError;
+    };
+    auto job = std::make_shared<Job>();
 
-static void BuildArgArray(char** pTheArgs, const std::vector<std::string>& pArgs)
-{    
-    for (const std::string& Arg : pArgs)
+    auto runChunks = [job,pBegin,pEnd,pChunkSize,numChunks,&pWork]()
     {
-        char* str = CopyArg(Arg);
-        if(str)
+        size_t chunk;
+        while( (chunk = job->mNextChunk.fetch_add(1)) < numChunks )
         {
-            //Trim leading white space.
-            while(isspace(str[0]) && str[0])
-                str++;
+            const size_t from = pBegin + (chunk * pChunkSize);
+            try
+            {
+                pWork(from,std::min(from + pChunkSize,pEnd));
+            }
+            catch(...)
+            {
+                std::lock_guard<std::mutex> lock(job->mMutex);
+                if( job->mError == nullptr )
+                    job->mError = std::current_exception();
+            }
 
-            if(str[0])
+            if( job->mChunksDone.fetch_add(1) + 1 == numChunks )
             {
-                *pTheArgs = str;
-                pTheArgs++;
+                std::lock_guard<std::mutex> lock(job->mMutex);
+                job->mDone.notify_all();
             }
         }
-    }
-    *pTheArgs = nullptr;
-}
+    };
 
-bool ExecuteShellCommand(const std::string& pCommand,const std::vector<std::string>& pArgs,const std::map<std::string,std::string>& pEnv, std::string& rOutput)
-{
-    const bool VERBOSE = false;
-    if (pCommand.size() == 0 )
+    // pWork is only used while there are chunks left, and we don't return until they're all done, so the reference is safe.
+    const size_t numHelpers = std::min(mWorkers.size(),numChunks - 1);
+    for( size_t n = 0 ; n < numHelpers ; n++ )
     {
-        std::cerr << "ExecuteShellCommand Command name for was zero length! No command given!\n";
-        return false;
+        Push(runChunks);
     }
+    runChunks();
 
-    int pipeSTDOUT[2];
-    int result = pipe(pipeSTDOUT);
-    if (result < 0)
+    std::exception_ptr error;
     {
-        perror("pipe");
-        exit(-1);
+        std::unique_lock<std::mutex> lock(job->mMutex);
+        job->mDone.wait(lock,[&job,numChunks](){return job->mChunksDone.load() == numChunks;});
+        // Take it out, a late helper may be the last to let go of the job and it should not take the exception with it.
+        std::swap(error,job->mError);
     }
 
-    int pipeSTDERR[2];
-    result = pipe(pipeSTDERR);
-    if (result < 0)
+    if( error )
     {
-        perror("pipe");
-        exit(-1);
+        std::rethrow_exception(error);
     }
+}
 
-    /* print error message if fork() fails */
-    pid_t pid = fork();
-    if (pid < 0)
+void ThreadPool::Shutdown()
+{
     {
-        std::cout << "ExecuteShellCommand Fork failed" << std::endl;
-        return false;
+        std::lock_guard<std::mutex> lock(mSleepMutex);
+        if( mStopping )
+            return;
+        mStopping = true;
     }
+    mSleeper.notify_all();
 
-    /* fork() == 0 for child process */
-    if (pid == 0)
+    for( auto& worker : mWorkers )
     {
-        dup2(pipeSTDOUT[1], STDOUT_FILENO ); /* Duplicate writing end to stdout */
-        close(pipeSTDOUT[0]);
-        close(pipeSTDOUT[1]);
-
-        dup2(pipeSTDERR[1], STDERR_FILENO ); /* Duplicate writing end to stdout */
-        close(pipeSTDERR[0]);
-        close(pipeSTDERR[1]);
-
-        ExecuteCommand(pCommand,pArgs,pEnv);
+        if( worker->mThread.joinable() )
+            worker->mThread.join();
     }
+}
 
-    /*
-     * parent process
-     */
-
-    /* Parent process */
-    close(pipeSTDOUT[1]); /* Close writing end of pipes, don't need them */
-    close(pipeSTDERR[1]); /* Close writing end of pipes, don't need them */
-
-    const size_t BufSize = 1000;
-    char buf[BufSize+1];
-    buf[BufSize] = 0;
-
-    struct pollfd Pipes[] =
+void ThreadPool::Push(Task&& pTask)
+{
+    // Our own workers can still add work while draining, it's part of what was submitted.
+    const bool fromWorker = tCurrentPool == this;
+    size_t index;
+    if( fromWorker )
     {
-        {pipeSTDOUT[0],POLLIN,0},
-        {pipeSTDERR[0],POLLIN,0},
-    };
+        index = tWorkerIndex;
+    }
+    else
+    {
+        index = mNextWorker.fetch_add(1,std::memory_order_relaxed) % mWorkers.size();
+    }
 
-    int NumPipesOk = 2;
-    std::stringstream outputStream;
-    do
     {
-        int ret = poll(Pipes,2,1000);
-        if( ret < 0 )
-        {
-            rOutput = "Error, pipes failed. Can't capture process output";
-            NumPipesOk = 0;
-        }
-        else if(ret  > 0 )
+        std::lock_guard<std::mutex> lock(mSleepMutex);
+        if( mStopping && fromWorker == false )
         {
-            for(int n = 0 ; n < 2 ; n++ )
-            {
-                if( (Pipes[n].revents&POLLIN) != 0 )
-                {
-                    ssize_t num = read(Pipes[n].fd,buf,BufSize);
-                    if( num > 0 )
-                    {
-                        buf[num] = 0;
-                        outputStream << buf;
-                    }
-                }
-                else if( (Pipes[n].revents&(POLLERR|POLLHUP|POLLNVAL)) != 0 && Pipes[n].events != 0 )
-                {
-                    Pipes[n].fd = -1;
-                    NumPipesOk--;
-                }
-            }
+            TINYTOOLS_THROW("ThreadPool has been shut down, can not take more work");
         }
-    }while(NumPipesOk>0);
-    rOutput = outputStream.str();
+        mPending++;
+    }
 
-    int status;
-    bool Worked = false;
-    if( wait(&status) == -1 )
     {
-        std::cout << "Failed to wait for child process." << std::endl;
+        std::lock_guard<std::mutex> lock(mWorkers[index]->mMutex);
+        mWorkers[index]->mTasks.push_back(std::move(pTask));
     }
-    else
+    mSleeper.notify_one();
+}
+
+bool ThreadPool::PopTask(size_t pWorker,Task& rTask)
+{
+    // Newest of our own first, it's the one most likely still in the cache.
     {
-        if(WIFEXITED(status) && WEXITSTATUS(status) != 0)//did the child terminate normally?
+        Worker& worker = *mWorkers[pWorker];
+        std::lock_guard<std::mutex> lock(worker.mMutex);
+        if( worker.mTasks.size() )
         {
-            if( VERBOSE )
-                std::cout << (long)pid << " exited with return code " << WEXITSTATUS(status) << std::endl;
+            rTask = std::move(worker.mTasks.back());
+            worker.mTasks.pop_back();
+            return true;
         }
-        else if (WIFSIGNALED(status))// was the child terminated by a signal?
+    }
+
+    // Then the oldest of someone else's.
+    for( size_t n = 1 ; n < mWorkers.size() ; n++ )
+    {
+        Worker& victim = *mWorkers[(pWorker + n) % mWorkers.size()];
+        std::lock_guard<std::mutex> lock(victim.mMutex);
+        if( victim.mTasks.size() )
         {
-            if( VERBOSE )
-                std::cout << (long)pid << " terminated because it didn't catch signal number " << WTERMSIG(status) << std::endl;
+            rTask = std::move(victim.mTasks.front());
+            victim.mTasks.pop_front();
+            return true;
         }
-        else
-        {// Get here, then all is ok.
-            Worked = true;
+    }
+    return false;
+}
+
+void ThreadPool::WorkerLoop(size_t pWorker)
+{
+    tCurrentPool = this;
+    tWorkerIndex = pWorker;
+
+    Task task;
+    for(;;)
+    {
+        if( PopTask(pWorker,task) )
+        {
+            mPending--;
+            task();
+            task = nullptr;// Let go of anything it captured now, not when the next one comes.
+            continue;
         }
+
+        // mPending is changed under the lock in Push, so we can't miss a wake between looking and waiting.
+        std::unique_lock<std::mutex> lock(mSleepMutex);
+        mSleeper.wait(lock,[this](){return mPending.load() > 0 || mStopping;});
+        if( mStopping && mPending.load() == 0 )
+            return;
     }
+}
 
-    return Worked;
+TaskScheduler::TaskScheduler(size_t pNumThreads):
+    mRandom(std::random_device()())
+{
+    for( size_t n = 0 ; n < std::max<size_t>(pNumThreads,1) ; n++ )
+    {
+        mThreads.emplace_back(&TaskScheduler::WorkerLoop,this);
+    }
 }
 
-void ExecuteCommand(const std::string& pCommand,const std::vector<std::string>& pArgs,const std::map<std::string,std::string>& pEnv)
+TaskScheduler::~TaskScheduler()
 {
-    // +1 for the NULL and +1 for the file name as per convention, see https://linux.die.net/man/3/execlp.
-    char** TheArgs = new char*[pArgs.size() + 2];
-    TheArgs[0] = CopyArg(pCommand);
-    BuildArgArray(TheArgs+1,pArgs);
+    TellThreadsToExitAndWait();
+}
 
-    // Build the environment variables.
-    for( const auto& var : pEnv )
+TaskScheduler::TaskID TaskScheduler::Add(std::chrono::microseconds pInterval,std::function<void()> pWork,Mode pMode,std::chrono::microseconds pJitter)
+{
+    if( pWork == nullptr )
     {
-        setenv(var.first.c_str(),var.second.c_str(),1);
+        TINYTOOLS_THROW("TaskScheduler passed nullptr for the work to do...");
     }
 
-    // This replaces the current process so no need to clean up the memory leaks before here. ;)
-    execvp(TheArgs[0], TheArgs);
-
-    const char* errorString = strerror(errno);
+    if( pInterval.count() <= 0 || pJitter.count() < 0 )
+    {
+        TINYTOOLS_THROW("TaskScheduler interval must be more than zero and the jitter not negative");
+    }
 
-    std::cerr << "ExecuteCommand execvp() failure!\n" << "    Error: " << errorString << "\n    This print is after execvp() and should not have been executed if execvp were successful!\n";
+    auto task = std::make_shared<Task>();
+    task->mWork = pWork;
+    task->mInterval = pInterval;
+    task->mJitter = pJitter;
+    task->mMode = pMode;
+    task->mBeat = std::chrono::steady_clock::now();// First run straight away, as SleepableThread does.
 
-    // Should never get here!
-    throw std::runtime_error("Command execution failed! Should not have returned! " + pCommand + " Error: " + errorString);
-    // Really make sure the process is gone...
-    _exit(1);
+    TaskID id;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        id = mNextTaskID++;
+        mTasks[id] = task;
+        Schedule(id,*task);
+    }
+    mWakeUp.notify_one();
+    return id;
 }
 
-};//namespace system{
-///////////////////////////////////////////////////////////////////////////////////////////////////////////
-namespace threading{
-
-void SleepableThread::Tick(int pPauseInterval,std::function<void()> pTheWork)
+bool TaskScheduler::Cancel(TaskID pTask)
 {
-	if( pTheWork == nullptr )
-	{
-		TINYTOOLS_THROW("SleepableThread passed nullpoint for the work to do...");
-	}
+    std::unique_lock<std::mutex> lock(mMutex);
+    auto found = mTasks.find(pTask);
+    if( found == mTasks.end() )
+        return false;
 
-        mKeepGoing = true;
-	mWorkerThread = std::thread([this,pPauseInterval,pTheWork]()
-	{
-		while(mKeepGoing)
-		{
-			pTheWork();
-			std::unique_lock<std::mutex> lk(mSleeperMutex);
-			mSleeper.wait_for(lk,std::chrono::seconds(pPauseInterval));
-		};
-	});
-}
+    std::shared_ptr<Task> task = found->second;
+    task->mCancelled = true;
+    mTasks.erase(found);
 
-void SleepableThread::TellThreadToExitAndWait()
-{
-	mKeepGoing = false;
-	mSleeper.notify_one();
-	if( mWorkerThread.joinable() )
-	{
-		mWorkerThread.join();
-	}
+    // Take it out of the queue, if it's running it won't be in it and won't be put back.
+    for( auto queued = mQueue.begin() ; queued != mQueue.end() ; ++queued )
+    {
+        if( queued->second == pTask )
+        {
+            mQueue.erase(queued);
+            break;
+        }
+    }
+
+    // If it's running on another thread wait for it, if it's us cancelling our selves that would never end.
+    if( task->mRunningOn != std::this_thread::get_id() )
+    {
+        mTaskDone.wait(lock,[&task](){return task->mRunningOn == std::thread::id();});
+    }
+    return true;
 }
 
-LocklessRingBuffer::LocklessRingBuffer(size_t pItemSizeof,size_t pItemCount)
+size_t TaskScheduler::GetNumTasks()const
 {
-    mBuffer = new uint8_t[pItemSizeof * pItemCount];
-    mItemSizeof = pItemSizeof;
-    mItemCount = pItemCount;
-    mCurrentReadPos = 0;
-    mNextWritePos = 0;    
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mTasks.size();
 }
 
-LocklessRingBuffer::~LocklessRingBuffer()
+void TaskScheduler::TellThreadsToExitAndWait()
 {
-    delete []mBuffer;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mKeepGoing = false;
+    }
+    mWakeUp.notify_all();
+
+    for( auto& thread : mThreads )
+    {
+        if( thread.joinable() )
+            thread.join();
+    }
 }
 
-bool LocklessRingBuffer::ReadNext(void* rItem,size_t pBufferSize)
+void TaskScheduler::WorkerLoop()
 {
-    void *item = NULL;
-    volatile int NextPos = 0;
+    std::unique_lock<std::mutex> lock(mMutex);
+    while( mKeepGoing )
+    {
+        if( mQueue.empty() )
+        {
+            mWakeUp.wait(lock);
+            continue;
+        }
 
-    // If we have caught up with the write index then we're blocked and return NULL.
-    // Current read pos is allowed to become the same as the write pos.
-    if( mCurrentReadPos == mNextWritePos )
-        return false;
+        // Not due yet, sleep until it is. Add will wake us if something sooner comes along.
+        const auto next = *mQueue.begin();
+        if( next.first > std::chrono::steady_clock::now() )
+        {
+            mWakeUp.wait_until(lock,next.first);
+            continue;
+        }
 
-    // Get the items address
-    item = mBuffer + (mCurrentReadPos * mItemSizeof);
+        mQueue.erase(mQueue.begin());
+        std::shared_ptr<Task> task = mTasks[next.second];
+        task->mRunningOn = std::this_thread::get_id();
 
-    // Copy before advancing the read buffer so it can't get over written.
-    const size_t numBytesToCopy = pBufferSize < mItemSizeof ? pBufferSize : mItemSizeof;
-    memcpy(rItem,item,numBytesToCopy);
+        // There may be another one due, let another thread have it while we're busy with this one.
+        if( mQueue.size() )
+            mWakeUp.notify_one();
 
-    // Advance to where we want to read from next time.
-    // Also we don't write new index till we have calculated it. Makes the write a single instruction and so atomic.
-    NextPos = (mCurrentReadPos+1)%mItemCount;
+        lock.unlock();
+        task->mWork();
+        lock.lock();
 
-    // Write with one instuction.
-    mCurrentReadPos = NextPos;
-    
-    return true;
+        task->mRunningOn = std::thread::id();
+        if( task->mCancelled )
+        {
+            mTaskDone.notify_all();
+            continue;
+        }
+
+        const auto now = std::chrono::steady_clock::now();
+        if( task->mMode == FIXED_DELAY )
+        {
+            task->mBeat = now + task->mInterval;
+        }
+        else
+        {// Next beat, and if the work took so long it's already gone skip on to the first one that hasn't.
+            task->mBeat += task->mInterval;
+            if( task->mBeat < now )
+            {
+                const auto missed = (now - task->mBeat + task->mInterval - std::chrono::steady_clock::duration(1)) / task->mInterval;
+                task->mBeat += task->mInterval * missed;
+            }
+        }
+        Schedule(next.second,*task);
+    }
 }
 
-bool LocklessRingBuffer::WriteNext(const void* pItem,size_t pBufferSize)
+void TaskScheduler::Schedule(TaskID pID,Task& pTask)
 {
-    // Notice how the logic for testing for overwrite is a 'little' different to the one above.
-    // This is important. It deals with then there is no data in the buffer and we need to write.
-    // The write pos is NOT allowed to become the same as the read pos.
-    // Also we don't write result till we are done. Makes the write a single instruction and so atomic.
-    volatile int NextPos = (mNextWritePos+1)%mItemCount;
-
-    // If we have caught up with the read index then we're blocked, return false. Data not written
-    if( NextPos == mCurrentReadPos )
-        return false;
-
-    const size_t numBytesToCopy = pBufferSize < mItemSizeof ? pBufferSize : mItemSizeof;
-    memcpy(mBuffer + (mNextWritePos * mItemSizeof),
-            pItem,
-            numBytesToCopy);
-
-    // Move to the place we'll next write too.
-    mNextWritePos = NextPos;
-
-    return true;// Written ok.
+    auto due = pTask.mBeat;
+    if( pTask.mJitter.count() > 0 )
+    {
+        due += std::chrono::microseconds(std::uniform_int_distribution<int64_t>(0,pTask.mJitter.count())(mRandom));
+    }
+    mQueue.emplace(due,pID);
 }
 
 };//namespace threading{
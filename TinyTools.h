@@ -22,10 +22,21 @@
 #define TINY_TOOLS_H
 
 #include <getopt.h>
+#include <sys/uio.h>
+#include <sys/epoll.h>
+#include <signal.h>
+#include <arpa/inet.h>
+#include <net/if.h>
 
 #include <vector>
 #include <string>
+#include <string_view>
 #include <map>
+#include <unordered_map>
+#include <list>
+#include <deque>
+#include <memory>
+#include <new>
 #include <set>
 #include <stack>
 #include <functional>
@@ -36,6 +47,11 @@
 #include <chrono>
 #include <thread>
 #include <condition_variable>
+#include <future>
+#include <tuple>
+#include <random>
+#include <mutex>
+#include <atomic>
 #include <ctime>
 #include <iomanip>
 
@@ -246,55 +262,1292 @@ std::string GetNameFromIPv4(const uint32_t pAddress);
  */
 uint32_t GetIPv4FromName(const std::string& pHostName);
 
+/**
+ * @brief Remembers the answers from GetNameFromIPv4 and GetIPv4FromName so asking again does not go back to the resolver.
+ * Answers are kept for pPositiveTTL, no answer (empty name or zero address) is kept for pNegativeTTL.
+ * Once a table has pMaxEntries in it the least recently used entry is dropped.
+ * With background refresh an expired entry is still returned straight away, and counted as a hit,
+ * while a worker thread looks it up again. Only the first ever lookup of something waits for the resolver.
+ * Safe to use from many threads, the resolver is never called with the lock held.
+ */
+class ResolverCache
+{
+public:
+	ResolverCache(std::chrono::milliseconds pPositiveTTL = std::chrono::minutes(5),std::chrono::milliseconds pNegativeTTL = std::chrono::seconds(30),size_t pMaxEntries = 1024,bool pBackgroundRefresh = false);
+	~ResolverCache();
+
+	/**
+	 * @brief Same as network::GetNameFromIPv4 but cached.
+	 */
+	std::string GetNameFromIPv4(uint32_t pAddress);
+
+	/**
+	 * @brief Same as network::GetIPv4FromName but cached.
+	 */
+	uint32_t GetIPv4FromName(const std::string& pHostName);
+
+	/**
+	 * @brief Lookups answered from the cache, including stale ones returned while a background refresh runs.
+	 */
+	uint64_t GetHits()const{return mHits;}
+
+	/**
+	 * @brief Lookups that had to wait for the resolver.
+	 */
+	uint64_t GetMisses()const{return mMisses;}
+
+	/**
+	 * @brief Number of entries in both tables.
+	 */
+	size_t GetSize();
+
+	/**
+	 * @brief Forgets everything, the counters are left alone.
+	 */
+	void Clear();
+
+private:
+	template<typename KEY,typename VALUE> struct Table
+	{
+		struct Entry
+		{
+			VALUE mValue;
+			std::chrono::steady_clock::time_point mExpires;
+			bool mRefreshing;								//!< Queued for the refresh thread, so it's not queued twice.
+			typename std::list<KEY>::iterator mLRU;
+		};
+		std::unordered_map<KEY,Entry> mEntries;
+		std::list<KEY> mLRU;								//!< Most recently used at the front.
+		std::vector<KEY> mRefreshQueue;
+	};
+
+	template<typename KEY,typename VALUE,typename RESOLVE> VALUE Lookup(Table<KEY,VALUE>& rTable,const KEY& pKey,RESOLVE pResolve);
+	template<typename KEY,typename VALUE> void Store(Table<KEY,VALUE>& rTable,const KEY& pKey,const VALUE& pValue);
+	void RefreshThread();
+
+	const std::chrono::milliseconds mPositiveTTL;
+	const std::chrono::milliseconds mNegativeTTL;
+	const size_t mMaxEntries;
+
+	std::mutex mMutex;							//!< Guards the tables.
+	Table<uint32_t,std::string> mNames;			//!< Address to name.
+	Table<std::string,uint32_t> mAddresses;		//!< Name to address.
+	std::atomic<uint64_t> mHits{0};
+	std::atomic<uint64_t> mMisses{0};
+
+	bool mKeepGoing = true;
+	std::condition_variable mRefreshWake;		//!< Wakes the refresh thread when something is queued or we're exiting.
+	std::thread mRefreshThread;
+};
+
 /**
  * @brief Scans from PI range to PI range. Broadcast IP's ignored.
  * Will return some intresting information handy for network monitoring.
  */
 void ScanNetworkIPv4(uint32_t pFromIPRange,uint32_t pToIPRange,std::function<bool(const uint32_t pIPv4,const char* pHostName)> pDeviceFound);
 
+/**
+ * @brief Same as above but does up to pMaxLookupsInFlight reverse lookups at the same time on a pool of worker threads.
+ * Most addresses on a network have no name and each of those lookups waits for the resolver to time out, so this is much faster.
+ * pDeviceFound is only ever called from the calling thread, in the order the answers arrive and not address order.
+ * Returning false from it stops the scan, lookups already in flight are waited for but not reported.
+ */
+void ScanNetworkIPv4(uint32_t pFromIPRange,uint32_t pToIPRange,size_t pMaxLookupsInFlight,std::function<bool(const uint32_t pIPv4,const char* pHostName)> pDeviceFound);
+
 /**
  * @brief Checks that the port on the device at IPv4 can be opened.
  */
 bool IsPortOpen(uint32_t pIPv4,uint16_t pPort);
 
+/**
+ * @brief An address and port to be checked by ScanPorts.
+ */
+struct PortProbe
+{
+	uint32_t mIPv4;		//!< In network byte order, see MakeIP4V.
+	uint16_t mPort;
+};
+
+/**
+ * @brief Checks a lot of ports at once. Uses non blocking connects, up to pMaxInFlight at a time, waiting on them all with epoll.
+ * IsPortOpen waits for the kernels connect timeout one port after another, this only waits pTimeoutMS for each and does them together.
+ * @param pTimeoutMS How long a connect has to work before the port is said to be closed.
+ * @param pMaxInFlight The most sockets open at once, keep it below your file descriptor limit.
+ * @param pResult Called on the calling thread as each probe finishes, in the order they finish. Return false to stop the scan.
+ */
+void ScanPorts(const std::vector<PortProbe>& pProbes,int pTimeoutMS,size_t pMaxInFlight,std::function<bool(const PortProbe& pProbe,bool pOpen)> pResult);
+
 /**
  * @brief Creates an 32 bit value from the passed IPv4 address.
  * https://www.sciencedirect.com/topics/computer-science/network-byte-order
  */
-inline uint32_t MakeIP4V(uint8_t pA,uint8_t pB,uint8_t pC,uint8_t pD)
+constexpr uint32_t MakeIP4V(uint8_t pA,uint8_t pB,uint8_t pC,uint8_t pD)
 {
 	// Networking byte order is big endian, so most significan't byte is byte 0.
-	return (uint32_t)((pA << 0) | (pB << 8) | (pC << 16) | pD << 24);
+	return uint32_t(pA) | (uint32_t(pB) << 8) | (uint32_t(pC) << 16) | (uint32_t(pD) << 24);
+}
+
+/**
+ * @brief The most chars IPv4ToChars will write, 255.255.255.255
+ */
+constexpr size_t IPV4_MAX_CHARS = 15;
+
+/**
+ * @brief Writes the address as text, IE 192.168.1.1, without a null terminator. No allocation, each octet is a table look up.
+ * @param pIPv4 In big endian format, as made by MakeIP4V.
+ * @param rBuffer Must have room for IPV4_MAX_CHARS.
+ * @return char* One past the last char written.
+ */
+char* IPv4ToChars(uint32_t pIPv4,char* rBuffer);
+
+/**
+ * @brief Bulk version of the above, writes each address followed by pSeparator.
+ * @param rBuffer Must have room for pCount * (IPV4_MAX_CHARS + 1)
+ * @return size_t The number of chars written.
+ */
+size_t IPv4ToChars(const uint32_t* pIPv4,size_t pCount,char* rBuffer,char pSeparator = '\n');
+
+/**
+ * @brief Parses dotted decimal, IE 192.168.1.1, into a network byte order value. No allocation and does not need a null terminator.
+ * Accepts the same as inet_pton, four decimal octets of 0 to 255 with no leading zeros and nothing else.
+ * @return true rIPv4 has been written.
+ * @return false Not an address, rIPv4 is untouched.
+ */
+bool ParseIPv4(std::string_view pText,uint32_t& rIPv4);
+
+/**
+ * @brief Bulk version of the above. Anything that fails to parse is written as zero.
+ * @return size_t How many parsed.
+ */
+size_t ParseIPv4(const std::string_view* pText,size_t pCount,uint32_t* rIPv4);
+
+/**
+ * @brief Makes a string, IE 192.168.1.1 from the passed in IPv4 value.
+ * 
+ * @param pIPv4 In big endian format https://www.sciencedirect.com/topics/computer-science/network-byte-order
+ * @return std::string 
+ */
+inline std::string IPv4ToString(uint32_t pIPv4)
+{
+	char buffer[IPV4_MAX_CHARS];
+	return std::string(buffer,IPv4ToChars(pIPv4,buffer));
+}
+
+/**
+ * @brief A run of IPv4 addresses, first to last inclusive.
+ * Held in host byte order so ranges can be compared and counted, the iterator hands out network byte order
+ * addresses like the rest of the network functions use. Iterating does not allocate or look at octets.
+ */
+struct IPv4Range
+{
+	uint32_t mFirst;	//!< Host byte order.
+	uint32_t mLast;		//!< Host byte order, inclusive.
+
+	/**
+	 * @brief Both in network byte order, as made by MakeIP4V. Throws if pToIPv4 is before pFromIPv4.
+	 */
+	IPv4Range(uint32_t pFromIPv4,uint32_t pToIPv4);
+
+	/**
+	 * @brief The network pIPv4 is in, e.g. FromCIDR(MakeIP4V(10,0,0,0),12) is 10.0.0.0 to 10.15.255.255
+	 */
+	static IPv4Range FromCIDR(uint32_t pIPv4,int pPrefixLength);
+
+	/**
+	 * @brief Same as above from a string like "10.0.0.0/12". A plain address is a /32. Throws if it can't be parsed.
+	 */
+	static IPv4Range FromCIDR(const std::string& pCIDR);
+
+	/**
+	 * @brief The range without its first and last address, the network and broadcast addresses for a subnet.
+	 * Ranges of two or less addresses are returned as they are, like /31 and /32 networks.
+	 */
+	IPv4Range Hosts()const;
+
+	uint64_t GetCount()const{return uint64_t(mLast) - mFirst + 1;}
+	bool Contains(uint32_t pIPv4)const{const uint32_t host = ntohl(pIPv4);return host >= mFirst && host <= mLast;}
+	bool operator == (const IPv4Range& pOther)const{return mFirst == pOther.mFirst && mLast == pOther.mLast;}
+
+	struct Iterator
+	{
+		uint64_t mCurrent;	//!< 64 bit so the end of a range that finishes on 255.255.255.255 does not wrap.
+		uint32_t operator*()const{return htonl((uint32_t)mCurrent);}
+		Iterator& operator++(){mCurrent++;return *this;}
+		bool operator != (const Iterator& pOther)const{return mCurrent != pOther.mCurrent;}
+	};
+	Iterator begin()const{return {mFirst};}
+	Iterator end()const{return {uint64_t(mLast) + 1};}
+
+private:
+	IPv4Range() = default;
+};
+
+/**
+ * @brief A set of IPv4 addresses held as sorted, non touching, ranges. So 10.0.0.0/8 minus a few subnets is only a handful of ranges.
+ * Contains is a binary search, Add and Remove of a set are a single pass over both.
+ */
+class IPv4Set
+{
+public:
+	IPv4Set() = default;
+	IPv4Set(const IPv4Range& pRange){Add(pRange);}
+
+	void Add(const IPv4Range& pRange);
+	void Add(const IPv4Set& pOther);
+	void Add(uint32_t pIPv4){Add(IPv4Range(pIPv4,pIPv4));}
+
+	void Remove(const IPv4Range& pRange);
+	void Remove(const IPv4Set& pOther);
+	void Remove(uint32_t pIPv4){Remove(IPv4Range(pIPv4,pIPv4));}
+
+	/**
+	 * @brief pIPv4 in network byte order.
+	 */
+	bool Contains(uint32_t pIPv4)const;
+
+	/**
+	 * @brief The number of addresses, 64 bit as the whole address space does not fit in 32.
+	 */
+	uint64_t GetCount()const;
+
+	bool Empty()const{return mRanges.size() == 0;}
+	void Clear(){mRanges.clear();}
+	const std::vector<IPv4Range>& GetRanges()const{return mRanges;}
+
+	/**
+	 * @brief Walks every address in the set in order, network byte order like IPv4Range.
+	 */
+	struct Iterator
+	{
+		const IPv4Range* mRange;
+		const IPv4Range* mEnd;
+		uint32_t mCurrent;	//!< Host byte order, zero once at the end.
+		uint32_t operator*()const{return htonl(mCurrent);}
+		Iterator& operator++()
+		{
+			if( mCurrent == mRange->mLast )
+			{
+				mRange++;
+				mCurrent = mRange != mEnd ? mRange->mFirst : 0;
+			}
+			else
+			{
+				mCurrent++;
+			}
+			return *this;
+		}
+		bool operator != (const Iterator& pOther)const{return mRange != pOther.mRange || mCurrent != pOther.mCurrent;}
+	};
+	Iterator begin()const{return mRanges.size() > 0 ? Iterator{mRanges.data(),mRanges.data() + mRanges.size(),mRanges[0].mFirst} : end();}
+	Iterator end()const{return {mRanges.data() + mRanges.size(),mRanges.data() + mRanges.size(),0};}
+
+private:
+	std::vector<IPv4Range> mRanges;
+};
+
+/**
+ * @brief Same as the ScanNetworkIPv4 functions above but for any set of addresses, e.g. a few CIDR blocks minus a deny list.
+ * Nothing is skipped, use IPv4Range::Hosts to leave out network and broadcast addresses.
+ * A pMaxLookupsInFlight below 2 does the lookups one at a time on the calling thread.
+ */
+void ScanNetworkIPv4(const IPv4Set& pAddresses,size_t pMaxLookupsInFlight,std::function<bool(const uint32_t pIPv4,const char* pHostName)> pDeviceFound);
+
+/**
+ * @brief One address on a network interface.
+ */
+struct InterfaceAddress
+{
+	int mFamily = AF_UNSPEC;		//!< AF_INET or AF_INET6, says which of the addresses below is used.
+	uint32_t mIPv4 = 0;				//!< Network byte order.
+	uint32_t mIPv4Netmask = 0;		//!< Network byte order.
+	uint32_t mIPv4Broadcast = 0;	//!< Network byte order, zero if the interface has none.
+	in6_addr mIPv6 = {};
+	int mPrefixLength = 0;			//!< The netmask as a count of bits, for both families.
+
+	/**
+	 * @brief The address as text, IE 192.168.1.10 or fe80::1
+	 */
+	std::string ToString()const;
+};
+
+/**
+ * @brief A network interface and all its addresses as reported by getifaddrs.
+ */
+struct NetworkInterface
+{
+	std::string mName;
+	unsigned int mIndex = 0;
+	unsigned int mFlags = 0;		//!< The IFF_ values from net/if.h
+	std::vector<InterfaceAddress> mAddresses;
+
+	bool IsUp()const{return (mFlags & IFF_UP) != 0;}
+	bool IsLoopback()const{return (mFlags & IFF_LOOPBACK) != 0;}
+};
+
+typedef std::vector<NetworkInterface> InterfaceTable;
+
+/**
+ * @brief Keeps a table of the network interfaces. Filled from getifaddrs and then refreshed when rtnetlink says something changed.
+ * Reading the table, or the local IPv4, is just an atomic load. No system calls.
+ * The table handed out is never changed, a change makes a new one, so it can be held on to for as long as you like.
+ */
+class InterfaceMonitor
+{
+public:
+	/**
+	 * @param pWatchForChanges Starts a thread listening for link and address changes. Without it the table only changes when Refresh is called.
+	 */
+	InterfaceMonitor(bool pWatchForChanges = true);
+	~InterfaceMonitor();
+
+	/**
+	 * @brief The current table, in the order getifaddrs gave them.
+	 */
+	std::shared_ptr<const InterfaceTable> GetInterfaces()const{return std::atomic_load(&mInterfaces);}
+
+	/**
+	 * @brief The first IPv4 address of the first interface that is up and not loopback, network byte order. Zero if there is not one.
+	 */
+	uint32_t GetIPv4()const{return mIPv4;}
+
+	/**
+	 * @brief Goes up by one each time the table is rebuilt. Handy to see if something has changed without looking at the table.
+	 */
+	uint64_t GetChangeCount()const{return mChangeCount;}
+
+	/**
+	 * @brief Rebuilds the table now.
+	 */
+	void Refresh();
+
+private:
+	void MonitorThread();
+
+	std::shared_ptr<const InterfaceTable> mInterfaces;	//!< Only ever accessed with the std::atomic_ functions.
+	std::atomic<uint32_t> mIPv4{0};
+	std::atomic<uint64_t> mChangeCount{0};
+	std::mutex mRefreshMutex;							//!< So two refreshes at once can't publish out of order.
+
+	int mNetlinkSocket = -1;
+	int mExitEvent = -1;								//!< An eventfd that wakes the thread to exit.
+	std::thread mMonitorThread;
+};
+
+/**
+ * @brief A process wide InterfaceMonitor that watches for changes. Made the first time it is asked for.
+ */
+InterfaceMonitor& GetInterfaceMonitor();
+
+/**
+ * @brief The machines IPv4 address, network byte order, zero if there is not one.
+ * Unlike GetLocalIP this does no system calls after the first time, the answer comes from GetInterfaceMonitor.
+ */
+inline uint32_t GetLocalIPv4(){return GetInterfaceMonitor().GetIPv4();}
+
+/**
+ * @brief An entry from the kernels IPv4 neighbour (ARP) table.
+ */
+struct Neighbour
+{
+	uint32_t mIPv4 = 0;				//!< Network byte order.
+	uint8_t mMAC[6] = {};			//!< All zero if the kernel does not have it yet.
+	unsigned int mInterfaceIndex = 0;
+	uint16_t mState = 0;			//!< The NUD_ values from linux/neighbour.h, NUD_REACHABLE, NUD_STALE etc.
+
+	/**
+	 * @brief True if the kernel has, or recently had, a MAC address for it. So it's a real device that answered.
+	 */
+	bool IsAlive()const;
+};
+
+/**
+ * @brief Reads the kernels IPv4 neighbour table. Asks rtnetlink for it, if that can't be done /proc/net/arp is read instead.
+ * There is no network traffic, it's what the kernel already knows, so it takes microseconds.
+ */
+std::vector<Neighbour> ReadNeighbourTable();
+
+/**
+ * @brief Finds the live hosts in pAddresses from the neighbour table, a lot faster than ScanNetworkIPv4 and finds devices with no name.
+ * Only sees devices on the same network segment as this machine, anything past a router is not in the table.
+ * @param pProbeWaitMS If not zero a UDP packet is sent to each address first, so the kernel goes and asks for their MAC addresses,
+ * and then it waits this long for the answers before reading the table. Zero to only report what the kernel already knows.
+ * @param pResolveNames Looks up the name of each host found, otherwise the name passed to pDeviceFound is empty.
+ * @param pDeviceFound Same as ScanNetworkIPv4. Return false to stop.
+ */
+void ScanNeighboursIPv4(const IPv4Set& pAddresses,int pProbeWaitMS,bool pResolveNames,std::function<bool(const uint32_t pIPv4,const char* pHostName)> pDeviceFound);
+
+/**
+ * @brief Same as above for a range, unlike ScanNetworkIPv4 nothing in the range is skipped.
+ */
+inline void ScanNeighboursIPv4(uint32_t pFromIPRange,uint32_t pToIPRange,int pProbeWaitMS,bool pResolveNames,std::function<bool(const uint32_t pIPv4,const char* pHostName)> pDeviceFound)
+{
+	ScanNeighboursIPv4(IPv4Set(IPv4Range(pFromIPRange,pToIPRange)),pProbeWaitMS,pResolveNames,pDeviceFound);
+}
+
+
+/**
+ * @brief The instruction set used by the codecs, Encode7Bit, Decode7Bit etc.
+ * The best one the CPU supports is picked the first time a codec is used, SCALAR is always there as the fall back.
+ */
+enum struct CodecKernel
+{
+	SCALAR,		//!< Plain C++, one 7 byte / 8 byte group at a time. The reference all the others must match.
+	BMI2,		//!< pdep / pext, one group at a time but without all the shifting. (x86 only)
+	SSE41,		//!< Two groups per 128 bit register. (x86 only)
+	AVX2		//!< Four groups per 256 bit register. (x86 only)
+};
+
+/**
+ * @brief Returns true if the CPU we're running on can execute the kernel.
+ */
+bool IsCodecKernelSupported(CodecKernel pKernel);
+
+/**
+ * @brief Returns the kernel currently being used by the codecs.
+ */
+CodecKernel GetCodecKernel();
+
+/**
+ * @brief Forces the codecs to use the kernel passed, mostly for testing and benchmarking.
+ * @return false if the CPU does not support it, the current kernel is left unchanged.
+ */
+bool SetCodecKernel(CodecKernel pKernel);
+
+/**
+ * @brief The exact number of bytes Encode7Bit will write for p8BitSize bytes of input.
+ * Every 7 bytes become 8, a trailing partial group of N bytes becomes N + 1.
+ */
+constexpr size_t Encoded7BitSize(size_t p8BitSize)
+{
+	return (p8BitSize / 7) * 8 + (p8BitSize % 7 > 0 ? (p8BitSize % 7) + 1 : 0);
+}
+
+/**
+ * @brief The exact number of bytes Decode7Bit will write for p7BitSize bytes of input.
+ * Every 8 bytes become 7, a trailing partial group of N bytes becomes N - 1.
+ */
+constexpr size_t Decoded7BitSize(size_t p7BitSize)
+{
+	return (p7BitSize / 8) * 7 + (p7BitSize % 8 > 1 ? (p7BitSize % 8) - 1 : 0);
+}
+
+/**
+ * @brief Encodes 8 bit data to a 7 bit data data stream. No data is lost, new buffer size will be bigger because of that.
+ * Used for comunication protocals so that the most significant bit can be used for control bytes.
+ * @param r7Bit A point to memory holding the converted data. You have to delete this after use with delete[].
+ * @return size_t The size of the 7Bit data.
+ */
+size_t Encode7Bit(const uint8_t* p8Bit,size_t p8BitSize,uint8_t** r7Bit);
+
+/**
+ * @brief Encodes 8 bit data to 7 bit data into memory you own, no allocations.
+ * Throws if p7BitBufferSize is less than Encoded7BitSize(p8BitSize).
+ * @return size_t The size of the 7Bit data, always Encoded7BitSize(p8BitSize).
+ */
+size_t Encode7Bit(const uint8_t* p8Bit,size_t p8BitSize,uint8_t* r7Bit,size_t p7BitBufferSize);
+
+/**
+ * @brief Encodes into the vector, it is resized to fit so reusing the same vector only allocates when it has to grow.
+ */
+inline size_t Encode7Bit(const uint8_t* p8Bit,size_t p8BitSize,std::vector<uint8_t>& r7Bit)
+{
+	r7Bit.resize(Encoded7BitSize(p8BitSize));
+	return Encode7Bit(p8Bit,p8BitSize,r7Bit.data(),r7Bit.size());
 }
 
 /**
- * @brief Makes a string, IE 192.168.1.1 from the passed in IPv4 value.
- * 
- * @param pIPv4 In big endian format https://www.sciencedirect.com/topics/computer-science/network-byte-order
- * @return std::string 
+ * @brief Converts 7 bit input data into the original 8 bit data.
+ * The most significant bit of the input bytes should be zero, the SIMD kernels ignore it.
+ * @param r8Bit A point to memory holding the converted data. You have to delete this after use with delete[].
+ */
+size_t Decode7Bit(const uint8_t* p7Bit,size_t p7BitSize,uint8_t** r8Bit);
+
+/**
+ * @brief Converts 7 bit input data into the original 8 bit data into memory you own, no allocations.
+ * Throws if p8BitBufferSize is less than Decoded7BitSize(p7BitSize).
+ * @return size_t The size of the 8Bit data, always Decoded7BitSize(p7BitSize).
+ */
+size_t Decode7Bit(const uint8_t* p7Bit,size_t p7BitSize,uint8_t* r8Bit,size_t p8BitBufferSize);
+
+/**
+ * @brief Decodes into the vector, it is resized to fit so reusing the same vector only allocates when it has to grow.
+ */
+inline size_t Decode7Bit(const uint8_t* p7Bit,size_t p7BitSize,std::vector<uint8_t>& r8Bit)
+{
+	r8Bit.resize(Decoded7BitSize(p7BitSize));
+	return Decode7Bit(p7Bit,p7BitSize,r8Bit.data(),r8Bit.size());
+}
+
+/**
+ * @brief Below this many input bytes the parallel versions stay on the calling thread, starting threads would cost more than the work.
+ */
+constexpr size_t PARALLEL_7BIT_THRESHOLD = 1024 * 1024;
+
+/**
+ * @brief Same as Encode7Bit but for large inputs the work is split on group boundaries across worker threads.
+ * The output is identical to Encode7Bit. The calling thread does one of the chunks.
+ * @param pNumThreads The number of threads to use, including the calling one. Zero means one per hardware thread.
+ * @param pThreshold Inputs smaller than this are done on the calling thread.
+ */
+size_t Encode7BitParallel(const uint8_t* p8Bit,size_t p8BitSize,uint8_t* r7Bit,size_t p7BitBufferSize,size_t pNumThreads = 0,size_t pThreshold = PARALLEL_7BIT_THRESHOLD);
+
+/**
+ * @brief Same as Decode7Bit but for large inputs the work is split on group boundaries across worker threads.
+ * @param pNumThreads The number of threads to use, including the calling one. Zero means one per hardware thread.
+ * @param pThreshold Inputs smaller than this are done on the calling thread.
+ */
+size_t Decode7BitParallel(const uint8_t* p7Bit,size_t p7BitSize,uint8_t* r8Bit,size_t p8BitBufferSize,size_t pNumThreads = 0,size_t pThreshold = PARALLEL_7BIT_THRESHOLD);
+
+/**
+ * @brief CRC32C (Castagnoli) checksum, the one used by iSCSI, ext4, SCTP etc.
+ * Uses the SSE4.2 crc32 instruction when the CPU has it, otherwise slice by 8 tables. See SetCrc32cHardware.
+ * To checksum data that arrives in pieces pass the result of the previous call in as pCrc.
+ * @param pCrc The CRC so far, 0 to start a new one.
+ */
+uint32_t Crc32c(const void* pData,size_t pSize,uint32_t pCrc = 0);
+
+/**
+ * @brief Turns Crc32c's use of the SSE4.2 crc32 instruction on or off, mostly for testing and benchmarking the tables.
+ * On by default when the CPU has it. Not tied to SetCodecKernel, the codec kernel has no effect on the CRC.
+ * @return false if asked to use the instruction and the CPU does not have it, the setting is left unchanged.
+ */
+bool SetCrc32cHardware(bool pUseHardware);
+
+/**
+ * @brief Encode7Bit and Crc32c of the 8 bit input. Done in blocks that fit in the L1 cache, each block is encoded
+ * and then checksummed while it is still in the cache, so the input is only read from memory once.
+ * @param rCrc Pass in the CRC so far, 0 for a new one, and it is updated with the checksum of p8Bit.
+ */
+size_t Encode7BitCrc32c(const uint8_t* p8Bit,size_t p8BitSize,uint8_t* r7Bit,size_t p7BitBufferSize,uint32_t& rCrc);
+
+/**
+ * @brief Decode7Bit and Crc32c of the decoded 8 bit output, in L1 sized blocks the same as Encode7BitCrc32c.
+ * Checking the result against the CRC the sender made with Encode7BitCrc32c validates the payload.
+ * @param rCrc Pass in the CRC so far, 0 for a new one, and it is updated with the checksum of the decoded data.
+ */
+size_t Decode7BitCrc32c(const uint8_t* p7Bit,size_t p7BitSize,uint8_t* r8Bit,size_t p8BitBufferSize,uint32_t& rCrc);
+
+/**
+ * @brief Encodes a stream of 8 bit data that arrives in chunks of any size.
+ * Whole 7 byte groups are encoded as they arrive, a partial group is held until the next Feed or Flush.
+ * Feeding a message in pieces and then calling Flush gives the same bytes as one call to Encode7Bit.
+ */
+class SevenBitEncoder
+{
+public:
+	/**
+	 * @brief The most Feed will write for p8BitSize more bytes of input.
+	 */
+	size_t GetFeedSize(size_t p8BitSize)const{return ((mPendingSize + p8BitSize) / 7) * 8;}
+
+	/**
+	 * @brief Encodes all the whole groups it can, the rest is kept for next time.
+	 * Throws if p7BitBufferSize is less than GetFeedSize(p8BitSize).
+	 * @return size_t The number of bytes written to r7Bit.
+	 */
+	size_t Feed(const uint8_t* p8Bit,size_t p8BitSize,uint8_t* r7Bit,size_t p7BitBufferSize);
+
+	/**
+	 * @brief Same as above but appends to the vector.
+	 */
+	size_t Feed(const uint8_t* p8Bit,size_t p8BitSize,std::vector<uint8_t>& r7Bit)
+	{
+		const size_t start = r7Bit.size();
+		r7Bit.resize(start + GetFeedSize(p8BitSize));
+		return Feed(p8Bit,p8BitSize,r7Bit.data() + start,r7Bit.size() - start);
+	}
+
+	/**
+	 * @brief Encodes the partial group being held, call at the end of a message. The encoder is then ready for the next one.
+	 * Needs at most 7 bytes.
+	 * @return size_t The number of bytes written to r7Bit.
+	 */
+	size_t Flush(uint8_t* r7Bit,size_t p7BitBufferSize);
+
+	size_t Flush(std::vector<uint8_t>& r7Bit)
+	{
+		const size_t start = r7Bit.size();
+		r7Bit.resize(start + Encoded7BitSize(mPendingSize));
+		return Flush(r7Bit.data() + start,r7Bit.size() - start);
+	}
+
+	/**
+	 * @brief Throws away any partial group.
+	 */
+	void Reset(){mPendingSize = 0;}
+
+	/**
+	 * @brief The number of input bytes held waiting for the rest of their group.
+	 */
+	size_t GetPendingSize()const{return mPendingSize;}
+
+private:
+	uint8_t mPending[7];		//!< The start of a group that was split between calls to Feed.
+	size_t mPendingSize = 0;
+};
+
+/**
+ * @brief Decodes a stream of 7 bit data that arrives in chunks of any size.
+ * Whole 8 byte groups are decoded as they arrive, a partial group is held until the next Feed or Flush.
+ */
+class SevenBitDecoder
+{
+public:
+	/**
+	 * @brief The most Feed will write for p7BitSize more bytes of input.
+	 */
+	size_t GetFeedSize(size_t p7BitSize)const{return ((mPendingSize + p7BitSize) / 8) * 7;}
+
+	/**
+	 * @brief Decodes all the whole groups it can, the rest is kept for next time.
+	 * Throws if p8BitBufferSize is less than GetFeedSize(p7BitSize).
+	 * @return size_t The number of bytes written to r8Bit.
+	 */
+	size_t Feed(const uint8_t* p7Bit,size_t p7BitSize,uint8_t* r8Bit,size_t p8BitBufferSize);
+
+	/**
+	 * @brief Same as above but appends to the vector.
+	 */
+	size_t Feed(const uint8_t* p7Bit,size_t p7BitSize,std::vector<uint8_t>& r8Bit)
+	{
+		const size_t start = r8Bit.size();
+		r8Bit.resize(start + GetFeedSize(p7BitSize));
+		return Feed(p7Bit,p7BitSize,r8Bit.data() + start,r8Bit.size() - start);
+	}
+
+	/**
+	 * @brief Decodes the partial group being held, call at the end of a message. The decoder is then ready for the next one.
+	 * Needs at most 6 bytes.
+	 * @return size_t The number of bytes written to r8Bit.
+	 */
+	size_t Flush(uint8_t* r8Bit,size_t p8BitBufferSize);
+
+	size_t Flush(std::vector<uint8_t>& r8Bit)
+	{
+		const size_t start = r8Bit.size();
+		r8Bit.resize(start + Decoded7BitSize(mPendingSize));
+		return Flush(r8Bit.data() + start,r8Bit.size() - start);
+	}
+
+	/**
+	 * @brief Throws away any partial group.
+	 */
+	void Reset(){mPendingSize = 0;}
+
+	/**
+	 * @brief The number of input bytes held waiting for the rest of their group.
+	 */
+	size_t GetPendingSize()const{return mPendingSize;}
+
+private:
+	uint8_t mPending[8];		//!< The start of a group that was split between calls to Feed.
+	size_t mPendingSize = 0;
+};
+
+/**
+ * @brief The two base64 alphabets from RFC 4648.
+ * STANDARD uses + and / and pads the output with =, URL_SAFE uses - and _ and does not pad.
+ * Either decoder accepts input with or without the padding.
+ */
+enum struct Base64Alphabet
+{
+	STANDARD,
+	URL_SAFE
+};
+
+/**
+ * @brief The exact number of characters EncodeBase64 will write for pSize bytes of input.
+ */
+constexpr size_t EncodedBase64Size(size_t pSize,Base64Alphabet pAlphabet = Base64Alphabet::STANDARD)
+{
+	return pAlphabet == Base64Alphabet::STANDARD ? ((pSize + 2) / 3) * 4 : (pSize / 3) * 4 + (pSize % 3 > 0 ? (pSize % 3) + 1 : 0);
+}
+
+/**
+ * @brief The most bytes DecodeBase64 can write for pBase64Size characters. Exact for unpadded input, padding makes the result up to 2 bytes smaller.
+ */
+constexpr size_t DecodedBase64MaxSize(size_t pBase64Size)
+{
+	return (pBase64Size / 4) * 3 + (pBase64Size % 4 > 1 ? (pBase64Size % 4) - 1 : 0);
+}
+
+/**
+ * @brief Encodes binary data as base64 text. Uses the same SIMD kernel as the 7 bit codec, see SetCodecKernel.
+ * @param rBase64 A point to memory holding the text, it is null terminated. You have to delete this after use with delete[].
+ * @return size_t The length of the text, not including the null.
+ */
+size_t EncodeBase64(const uint8_t* pData,size_t pSize,char** rBase64,Base64Alphabet pAlphabet = Base64Alphabet::STANDARD);
+
+/**
+ * @brief Encodes binary data as base64 text into memory you own, no allocations. Not null terminated.
+ * Throws if pBase64BufferSize is less than EncodedBase64Size(pSize,pAlphabet).
+ */
+size_t EncodeBase64(const uint8_t* pData,size_t pSize,char* rBase64,size_t pBase64BufferSize,Base64Alphabet pAlphabet = Base64Alphabet::STANDARD);
+
+/**
+ * @brief Encodes into the string, it is resized to fit so reusing the same string only allocates when it has to grow.
+ */
+inline size_t EncodeBase64(const uint8_t* pData,size_t pSize,std::string& rBase64,Base64Alphabet pAlphabet = Base64Alphabet::STANDARD)
+{
+	rBase64.resize(EncodedBase64Size(pSize,pAlphabet));
+	return EncodeBase64(pData,pSize,&rBase64[0],rBase64.size(),pAlphabet);
+}
+
+/**
+ * @brief Decodes base64 text back to binary. Throws if the text has characters not in the alphabet, line breaks included, or a bad length.
+ * @param rData A point to memory holding the data. You have to delete this after use with delete[].
+ * @return size_t The size of the decoded data.
+ */
+size_t DecodeBase64(const char* pBase64,size_t pBase64Size,uint8_t** rData,Base64Alphabet pAlphabet = Base64Alphabet::STANDARD);
+
+/**
+ * @brief Decodes base64 text back to binary into memory you own, no allocations.
+ * Throws if pDataBufferSize is too small, DecodedBase64MaxSize(pBase64Size) is always big enough.
+ */
+size_t DecodeBase64(const char* pBase64,size_t pBase64Size,uint8_t* rData,size_t pDataBufferSize,Base64Alphabet pAlphabet = Base64Alphabet::STANDARD);
+
+/**
+ * @brief Decodes into the vector, it is resized to fit so reusing the same vector only allocates when it has to grow.
+ */
+inline size_t DecodeBase64(const char* pBase64,size_t pBase64Size,std::vector<uint8_t>& rData,Base64Alphabet pAlphabet = Base64Alphabet::STANDARD)
+{
+	rData.resize(DecodedBase64MaxSize(pBase64Size));
+	rData.resize(DecodeBase64(pBase64,pBase64Size,rData.data(),rData.size(),pAlphabet));
+	return rData.size();
+}
+
+constexpr size_t EncodedHexSize(size_t pSize){return pSize * 2;}
+constexpr size_t DecodedHexSize(size_t pHexSize){return pHexSize / 2;}
+
+/**
+ * @brief Encodes binary data as hex text, two characters per byte.
+ * @param rHex A point to memory holding the text, it is null terminated. You have to delete this after use with delete[].
+ * @return size_t The length of the text, not including the null.
+ */
+size_t EncodeHex(const uint8_t* pData,size_t pSize,char** rHex,bool pUpperCase = false);
+
+/**
+ * @brief Encodes binary data as hex text into memory you own, no allocations. Not null terminated.
+ * Throws if pHexBufferSize is less than EncodedHexSize(pSize).
+ */
+size_t EncodeHex(const uint8_t* pData,size_t pSize,char* rHex,size_t pHexBufferSize,bool pUpperCase = false);
+
+/**
+ * @brief Encodes into the string, it is resized to fit so reusing the same string only allocates when it has to grow.
+ */
+inline size_t EncodeHex(const uint8_t* pData,size_t pSize,std::string& rHex,bool pUpperCase = false)
+{
+	rHex.resize(EncodedHexSize(pSize));
+	return EncodeHex(pData,pSize,&rHex[0],rHex.size(),pUpperCase);
+}
+
+/**
+ * @brief Decodes hex text, upper or lower case, back to binary. Throws on an odd length or a character that is not hex.
+ * @param rData A point to memory holding the data. You have to delete this after use with delete[].
+ */
+size_t DecodeHex(const char* pHex,size_t pHexSize,uint8_t** rData);
+
+/**
+ * @brief Decodes hex text back to binary into memory you own, no allocations.
+ * Throws if pDataBufferSize is less than DecodedHexSize(pHexSize).
+ */
+size_t DecodeHex(const char* pHex,size_t pHexSize,uint8_t* rData,size_t pDataBufferSize);
+
+/**
+ * @brief Decodes into the vector, it is resized to fit so reusing the same vector only allocates when it has to grow.
+ */
+inline size_t DecodeHex(const char* pHex,size_t pHexSize,std::vector<uint8_t>& rData)
+{
+	rData.resize(DecodedHexSize(pHexSize));
+	return DecodeHex(pHex,pHexSize,rData.data(),rData.size());
+}
+
+/**
+ * @brief Control bytes used to frame 7 bit payloads. The payload bytes never have the most significant bit set so these can not appear in one.
+ * Any other byte with the most significant bit set inside a frame is an error, the frame is dropped and the parser looks for the next FRAME_START.
+ */
+constexpr uint8_t FRAME_START = 0x80;
+constexpr uint8_t FRAME_END = 0x81;
+
+/**
+ * @brief Queues many frames and writes them to a file descriptor with as few writev calls as possible.
+ * Each frame is FRAME_START, the 7 bit payload and then FRAME_END.
+ */
+class FrameWriter
+{
+public:
+	/**
+	 * @brief Encodes the 8 bit payload into the writers own buffer and queues it. The payload can be reused straight away.
+	 */
+	void Queue(const uint8_t* p8Bit,size_t p8BitSize);
+
+	/**
+	 * @brief Queues an already 7 bit encoded payload without copying it.
+	 * The memory must stay valid and unchanged until Flush has written it.
+	 */
+	void QueueEncoded(const uint8_t* p7Bit,size_t p7BitSize);
+
+	/**
+	 * @brief Writes everything queued using writev, IOV_MAX pieces at a time.
+	 * Partial writes are carried on from where they stopped.
+	 * @return true All the frames were written and the queue is empty.
+	 * @return false The write failed or would block, see errno. What was not written stays queued, call again to carry on.
+	 */
+	bool Flush(int pFileDescriptor);
+
+	/**
+	 * @brief The number of bytes, including control bytes, waiting to be written.
+	 */
+	size_t GetQueuedBytes()const{return mQueuedBytes;}
+
+	/**
+	 * @brief Throws away everything queued.
+	 */
+	void Clear();
+
+private:
+	/**
+	 * @brief A piece of the output. Either an offset into mEncoded, for Queue, or memory owned by someone else.
+	 * Offsets because mEncoded can move when it grows.
+	 */
+	struct Piece
+	{
+		const uint8_t* mExternal;
+		size_t mOffset;
+		size_t mSize;
+	};
+
+	std::vector<uint8_t> mEncoded;		//!< Frames made by Queue, control bytes and all. Capacity is kept between flushes.
+	std::vector<Piece> mPieces;			//!< In the order they are to be written.
+	std::vector<struct iovec> mIOVecs;	//!< Built by Flush, kept so it does not allocate every time.
+	size_t mFirstPiece = 0;				//!< Pieces before this have been written.
+	size_t mFirstPieceWritten = 0;		//!< How much of mFirstPiece has been written after a partial write.
+	size_t mQueuedBytes = 0;
+};
+
+/**
+ * @brief Scans pBuffer for complete frames and passes each payload to pFrame. No copying, the payload points into pBuffer.
+ * Bytes outside of a frame and frames broken by an unexpected control byte are skipped.
+ * @param pFrame Called with the 7 bit payload of each frame, return false to stop parsing.
+ * @return size_t How many bytes of pBuffer were used up. Anything after that is a frame that has not all arrived yet,
+ * keep it and call again once more data has been appended to it.
+ */
+size_t ParseFrames(const uint8_t* pBuffer,size_t pBufferSize,std::function<bool(const uint8_t* p7Bit,size_t p7BitSize)> pFrame);
+
+/**
+ * @brief Reads from a file descriptor into its own buffer and hands out the frames found using ParseFrames.
+ * The buffer is reused, partial frames are moved to the front ready for the next read.
+ */
+class FrameReader
+{
+public:
+	/**
+	 * @param pReadSize How much to ask for in each read.
+	 * @param pMaxFrameSize The biggest frame, start and end bytes included. A frame still going at this size is dropped and
+	 * reading picks up again at the next FRAME_START, so a stream that never ends a frame can't grow the buffer for ever.
+	 */
+	FrameReader(size_t pReadSize = 64 * 1024,size_t pMaxFrameSize = 1024 * 1024):mReadSize(pReadSize),mMaxFrameSize(pMaxFrameSize){}
+
+	/**
+	 * @brief Does one read and passes out all the complete frames it now has.
+	 * @return ssize_t The value returned by read. So 0 for end of file and -1 for an error, see errno.
+	 */
+	ssize_t Read(int pFileDescriptor,std::function<bool(const uint8_t* p7Bit,size_t p7BitSize)> pFrame);
+
+private:
+	const size_t mReadSize;
+	const size_t mMaxFrameSize;
+	std::vector<uint8_t> mBuffer;
+	size_t mUsed = 0;
+};
+
+/**
+ * @brief Runs file descriptor callbacks, timers, signals and posted work all on one thread. Built on epoll.
+ * All the timers share one timerfd and signals come in through a signalfd, so it's one epoll_wait for everything.
+ * Only Post and Stop can be called from other threads, everything else from the thread calling Run or before Run is called.
+ * Callbacks can add and remove anything, including themselves.
+ */
+class EventLoop
+{
+public:
+	typedef uint64_t TimerID;
+
+	EventLoop();
+	~EventLoop();
+
+	/**
+	 * @brief Calls pCallback when pFileDescriptor is ready.
+	 * @param pEvents The EPOLL flags wanted, EPOLLIN, EPOLLOUT, EPOLLET etc. The callback is passed the ones that happened.
+	 */
+	void AddFD(int pFileDescriptor,uint32_t pEvents,std::function<void(uint32_t pEvents)> pCallback);
+
+	/**
+	 * @brief Changes the events wanted for a file descriptor already added.
+	 */
+	void ModifyFD(int pFileDescriptor,uint32_t pEvents);
+
+	/**
+	 * @brief Stops watching the file descriptor, do this before closing it. Does not close it.
+	 */
+	void RemoveFD(int pFileDescriptor);
+
+	/**
+	 * @brief Calls pCallback once, pMilliseconds from now.
+	 */
+	TimerID AddTimer(int pMilliseconds,std::function<void()> pCallback);
+
+	/**
+	 * @brief Calls pCallback every pMilliseconds until cancelled.
+	 * Keeps to the rate asked for, if the loop falls more than one interval behind the missed calls are dropped not bunched up.
+	 */
+	TimerID AddRepeatingTimer(int pMilliseconds,std::function<void()> pCallback);
+
+	/**
+	 * @brief Safe to call with a timer that has already fired or been cancelled.
+	 */
+	void CancelTimer(TimerID pTimer);
+
+	/**
+	 * @brief Calls pCallback when the signal arrives, instead of it going to a signal handler.
+	 * The signal is blocked for the calling thread. Threads made before this still get it, so add signals before starting threads.
+	 */
+	void AddSignal(int pSignal,std::function<void(int pSignal)> pCallback);
+
+	/**
+	 * @brief Stops handling the signal and unblocks it.
+	 */
+	void RemoveSignal(int pSignal);
+
+	/**
+	 * @brief Runs pWork on the loops thread. Can be called from any thread.
+	 */
+	void Post(std::function<void()> pWork);
+
+	/**
+	 * @brief Handles events until Stop is called.
+	 */
+	void Run();
+
+	/**
+	 * @brief Waits up to pTimeoutMS, -1 for forever, and handles what comes in. For when you want to run your own loop.
+	 */
+	void RunOnce(int pTimeoutMS);
+
+	/**
+	 * @brief Makes Run return once it has finished what it's doing. Can be called from any thread.
+	 */
+	void Stop();
+
+private:
+	struct FDHandler
+	{
+		std::function<void(uint32_t pEvents)> mCallback;
+		uint32_t mGeneration;	//!< In the top of the epoll data so an event for a removed, then reused, file descriptor is ignored.
+	};
+
+	struct Timer
+	{
+		std::chrono::steady_clock::time_point mWhen;
+		std::chrono::milliseconds mInterval;	//!< Zero for one shot.
+		std::function<void()> mCallback;
+	};
+
+	TimerID AddTimer(std::chrono::milliseconds pDelay,std::chrono::milliseconds pInterval,std::function<void()> pCallback);
+	void RunTimers();
+	void ArmTimerFD();
+	void RunSignals();
+	void RunPosted();
+
+	const int mEpoll;
+	const int mWakeEvent;		//!< eventfd written by Post and Stop.
+	const int mTimerFD;
+	int mSignalFD = -1;			//!< Made when the first signal is added.
+	sigset_t mSignals;
+
+	std::unordered_map<int,std::shared_ptr<FDHandler>> mHandlers;	//!< shared_ptr so a handler can remove itself while running.
+	uint32_t mNextGeneration = 1;
+
+	std::map<TimerID,std::shared_ptr<Timer>> mTimers;				//!< Same again, a timer can cancel itself.
+	std::set<std::pair<std::chrono::steady_clock::time_point,TimerID>> mTimerQueue;	//!< Soonest first.
+	TimerID mNextTimerID = 1;
+
+	std::map<int,std::function<void(int pSignal)>> mSignalHandlers;
+
+	std::mutex mPostedMutex;
+	std::vector<std::function<void()>> mPosted;
+	std::atomic<bool> mKeepGoing{true};
+};
+
+/**
+ * @brief A non blocking TCP connection run by an EventLoop, edge triggered.
+ * The loop owns it until it closes, so you can let go of the pointer once the callbacks are set.
+ * Everything must be called on the loops thread.
+ */
+class TCPConnection : public std::enable_shared_from_this<TCPConnection>
+{
+public:
+	typedef std::shared_ptr<TCPConnection> Ptr;
+
+	/**
+	 * @brief Called with everything received that has not been used yet. The buffer is reused between calls.
+	 * @return size_t How many bytes were used. If some were used it's called again with what is left,
+	 * return zero to wait for more data, which will be added after the bytes not used.
+	 * If what is waiting reaches the maximum receive size, see SetMaxReceiveSize, the connection is closed with EMSGSIZE.
+	 */
+	typedef std::function<size_t(TCPConnection& pConnection,const uint8_t* pData,size_t pSize)> DataCallback;
+
+	/**
+	 * @brief Called once, when the connection has closed for whatever reason. pError is the errno, zero for a clean close.
+	 */
+	typedef std::function<void(TCPConnection& pConnection,int pError)> CloseCallback;
+
+	/**
+	 * @brief Starts a non blocking connect. pConnected is called once it has worked, if it fails pClosed is called with the error.
+	 */
+	static Ptr Connect(EventLoop& pLoop,uint32_t pIPv4,uint16_t pPort,std::function<void(TCPConnection& pConnection)> pConnected,DataCallback pData,CloseCallback pClosed);
+
+	~TCPConnection();
+
+	void SetDataCallback(DataCallback pData){mOnData = pData;}
+	void SetCloseCallback(CloseCallback pClosed){mOnClose = pClosed;}
+
+	/**
+	 * @brief The most received data the DataCallback can leave unused, 1MB by default.
+	 * Stops a peer that never sends the end of a message using up all the memory.
+	 */
+	void SetMaxReceiveSize(size_t pMaxSize){mMaxReceiveSize = pMaxSize;}
+
+	/**
+	 * @brief Copies the data into the send queue and sends what it can now.
+	 */
+	void Send(const void* pData,size_t pSize);
+
+	/**
+	 * @brief Same but takes the buffer, no copy.
+	 */
+	void Send(std::vector<uint8_t>&& pData);
+
+	/**
+	 * @brief Sends pSize bytes of the file from pOffset with sendfile, in order with anything else sent.
+	 * The file descriptor must stay open until it has all gone, see GetQueuedBytes.
+	 * sendfile can't be told MSG_NOSIGNAL, so if the other end has gone it raises SIGPIPE. Ignore SIGPIPE if you use this.
+	 */
+	void SendFile(int pFileDescriptor,off_t pOffset,size_t pSize);
+
+	/**
+	 * @brief Bytes waiting to be sent.
+	 */
+	size_t GetQueuedBytes()const{return mQueuedBytes;}
+
+	/**
+	 * @brief Closes the connection, after sending what is queued if pAfterSending.
+	 */
+	void Close(bool pAfterSending = true);
+
+	bool IsConnected()const{return mConnected;}
+	int GetFD()const{return mSocket;}
+	uint32_t GetPeerIPv4()const{return mPeerIPv4;}
+	uint16_t GetPeerPort()const{return mPeerPort;}
+
+private:
+	friend class TCPListener;
+
+	/**
+	 * @brief Queued data is either memory we own or part of a file.
+	 */
+	struct Piece
+	{
+		std::vector<uint8_t> mData;
+		int mFile = -1;
+		off_t mOffset = 0;
+		size_t mSize = 0;		//!< Bytes left to send.
+		size_t mSent = 0;		//!< How far into mData we are.
+	};
+
+	TCPConnection(EventLoop& pLoop,int pSocket,bool pConnected);
+	void Start();
+	void OnEvents(uint32_t pEvents);
+	void ReadAll();
+	void WriteAll();
+	void Finish(int pError);
+
+	EventLoop& mLoop;
+	int mSocket;
+	bool mConnected;
+	bool mClosing = false;				//!< Close after sending has been asked for.
+	uint32_t mPeerIPv4 = 0;
+	uint16_t mPeerPort = 0;
+
+	DataCallback mOnData;
+	CloseCallback mOnClose;
+	std::function<void(TCPConnection& pConnection)> mOnConnected;
+
+	std::vector<uint8_t> mReceived;		//!< Reused, grows as needed and stays that size.
+	size_t mReceivedSize = 0;
+	size_t mMaxReceiveSize = 1024 * 1024;
+	std::deque<Piece> mSendQueue;
+	size_t mQueuedBytes = 0;
+	std::vector<struct iovec> mIOVecs;	//!< Reused by WriteAll.
+};
+
+/**
+ * @brief Listens for TCP connections on an EventLoop and hands each new one to pAccepted.
+ * To accept on many threads give each thread its own EventLoop and TCPListener on the same port with pReusePort true,
+ * the kernel then shares the connections between them.
  */
-inline std::string IPv4ToString(uint32_t pIPv4)
+class TCPListener
 {
-	int a = (pIPv4&0x000000ff)>>0;
-	int b = (pIPv4&0x0000ff00)>>8;
-	int c = (pIPv4&0x00ff0000)>>16;
-	int d = (pIPv4&0xff000000)>>24;
+public:
+	/**
+	 * @param pPort Zero for any free port, see GetPort.
+	 * @param pAccepted Set the callbacks on the connection in here, before returning.
+	 */
+	TCPListener(EventLoop& pLoop,uint16_t pPort,std::function<void(TCPConnection::Ptr pConnection)> pAccepted,uint32_t pIPv4 = INADDR_ANY,bool pReusePort = false,int pBacklog = SOMAXCONN);
+	~TCPListener();
 
-	return std::to_string(a) + "." + std::to_string(b) + "." + std::to_string(c) + "." + std::to_string(d);
-}
+	uint16_t GetPort()const{return mPort;}
+
+private:
+	void AcceptAll();
+
+	EventLoop& mLoop;
+	int mSocket;
+	uint16_t mPort;
+	std::function<void(TCPConnection::Ptr pConnection)> mAccepted;
+};
 
 /**
- * @brief Encodes 8 bit data to a 7 bit data data stream. No data is lost, new buffer size will be bigger because of that.
- * Used for comunication protocals so that the most significant bit can be used for control bytes.
- * @param r7Bit A point to memory holding the converted data. You have to delete this after use with delete[].
- * @return size_t The size of the 7Bit data.
+ * @brief A non blocking UDP socket on an EventLoop. Datagrams are read into one reused buffer until there are no more.
  */
-size_t Encode7Bit(const uint8_t* p8Bit,size_t p8BitSize,uint8_t** r7Bit);
+class UDPSocket
+{
+public:
+	typedef std::function<void(UDPSocket& pSocket,uint32_t pFromIPv4,uint16_t pFromPort,const uint8_t* pData,size_t pSize)> ReceiveCallback;
+
+	/**
+	 * @param pPort Zero for any free port, see GetPort.
+	 */
+	UDPSocket(EventLoop& pLoop,uint16_t pPort,ReceiveCallback pReceived,uint32_t pIPv4 = INADDR_ANY,bool pReusePort = false);
+	~UDPSocket();
+
+	/**
+	 * @brief Sends one datagram.
+	 * @return false If it could not be sent now, see errno. EAGAIN means the send buffer is full.
+	 */
+	bool SendTo(uint32_t pIPv4,uint16_t pPort,const void* pData,size_t pSize);
+
+	uint16_t GetPort()const{return mPort;}
+	int GetFD()const{return mSocket;}
+
+private:
+	void ReadAll();
+
+	EventLoop& mLoop;
+	int mSocket;
+	uint16_t mPort;
+	ReceiveCallback mReceived;
+	std::vector<uint8_t> mBuffer;
+};
 
 /**
- * @brief Converts 7 bit input data into the original 8 bit data.
+ * @brief A serial port, or anything else termios, set up raw for the 7 bit protocol.
+ * Reads go into a ring buffer, as much as there is in one go, and writes are queued up and sent with one write call.
+ * So sending lots of small packets is one system call and not one each.
  */
-size_t Decode7Bit(const uint8_t* p7Bit,size_t p7BitSize,uint8_t** r8Bit);
+class SerialPort
+{
+public:
+	/**
+	 * @brief Opens the device, e.g. /dev/ttyUSB0, and sets it to raw 8N1 with no flow control. Throws if it can't.
+	 * @param pBaudRate As a number, 9600, 115200 etc.
+	 * @param pRingBufferSize Rounded up to a power of two.
+	 * @param pMaxFrameSize The biggest frame ReadFrames will keep waiting on, see FrameReader.
+	 */
+	SerialPort(const std::string& pDevice,int pBaudRate,size_t pRingBufferSize = 64 * 1024,size_t pMaxFrameSize = 1024 * 1024);
+
+	/**
+	 * @brief Same but for a file descriptor that is already open, like either side of a pty. It will be closed by the destructor.
+	 */
+	SerialPort(int pFileDescriptor,int pBaudRate,size_t pRingBufferSize = 64 * 1024,size_t pMaxFrameSize = 1024 * 1024);
+
+	~SerialPort();
+
+	/**
+	 * @brief Sets VMIN and VTIME. Both zero, the default, makes the port non blocking.
+	 * Anything else makes Fill block until pMinBytes have arrived or, once a byte has arrived, there is a gap of pTenthsOfSecond.
+	 * A bigger VMIN means fewer wake ups for streams of data, VTIME stops a short packet waiting forever for VMIN.
+	 */
+	void SetReadTiming(uint8_t pMinBytes,uint8_t pTenthsOfSecond);
+
+	/**
+	 * @brief Reads what has arrived into the ring buffer, until it is full or there is no more.
+	 * With SetReadTiming making it blocking only one read is done, as another would block again.
+	 * @return ssize_t The bytes read, 0 if there was nothing or the ring buffer is full, -1 on error, see errno.
+	 */
+	ssize_t Fill();
+
+	/**
+	 * @brief Waits up to pTimeoutMS for something to read, -1 for forever. Does not read it, call Fill.
+	 */
+	bool WaitForData(int pTimeoutMS);
+
+	/**
+	 * @brief Bytes in the ring buffer.
+	 */
+	size_t GetAvailable()const{return mHead - mTail;}
+
+	/**
+	 * @brief Takes up to pMaxSize bytes out of the ring buffer.
+	 */
+	size_t Read(uint8_t* rData,size_t pMaxSize);
+
+	/**
+	 * @brief Takes everything out of the ring buffer and passes out the 7 bit payload of each complete frame, see ParseFrames.
+	 * A frame that has not all arrived yet is kept for next time, unless it has reached pMaxFrameSize when it is dropped.
+	 */
+	size_t ReadFrames(std::function<bool(const uint8_t* p7Bit,size_t p7BitSize)> pFrame);
+
+	/**
+	 * @brief Adds raw bytes to the write queue.
+	 */
+	void Write(const uint8_t* pData,size_t pSize);
+
+	/**
+	 * @brief Encodes the 8 bit data and adds it to the write queue as a frame, FRAME_START, payload, FRAME_END.
+	 */
+	void WriteFrame(const uint8_t* p8Bit,size_t p8BitSize);
+
+	/**
+	 * @brief Writes as much of the queue as the port will take.
+	 * @return true It has all gone.
+	 * @return false Some is left, the port is full or there was an error, see errno. Call again to carry on.
+	 */
+	bool Flush();
+
+	/**
+	 * @brief Bytes waiting in the write queue.
+	 */
+	size_t GetQueuedBytes()const{return mWriteQueue.size() - mWriteOffset;}
+
+	int GetFD()const{return mFileDescriptor;}
+
+private:
+	void Setup(int pBaudRate,size_t pRingBufferSize);
+
+	int mFileDescriptor;
+	const size_t mMaxFrameSize;
+	bool mBlocking = false;
+
+	std::vector<uint8_t> mRing;
+	size_t mRingMask = 0;
+	size_t mHead = 0;				//!< Free running count of bytes put in the ring.
+	size_t mTail = 0;				//!< Free running count of bytes taken out.
+
+	std::vector<uint8_t> mFrames;	//!< Bytes taken out by ReadFrames that are part of a frame still coming in.
+
+	std::vector<uint8_t> mWriteQueue;
+	size_t mWriteOffset = 0;		//!< How much of mWriteQueue has been written.
+};
 
 };// namespace network
 
@@ -452,8 +1705,13 @@ private:
  * The reading and writing threads can be different.
  * The writing thread must not call ReadNext.
  * The reading thread must not call WriteNext.
- * Using volatile is to force the suppression of optimisations
- * that could otherwise occur on the counters that could break the lockless nature of the buffer.
+ * The read and write counts are atomics, the writer publishes with release and the reader picks up with acquire,
+ * so the item data is seen by the other thread before the count that says it is there. Works on ARM as well as x86.
+ * Each count is on its own cache line and each side keeps a copy of the other sides count, only reading the real one
+ * when the copy says the buffer is full or empty. So the two threads are not forever pulling the same cache line back and forth.
+ * ReadWait and WriteWait block, spinning for a bit and then sleeping on a futex. The other side only makes the wake
+ * system call when it sees someone is asleep. The side going to sleep pays for the memory barrier with membarrier,
+ * so ReadNext and WriteNext only do a normal load to check, no fence. Falls back to a fence if the kernel can't do it.
  */
 class LocklessRingBuffer
 {
@@ -462,19 +1720,27 @@ public:
      * @brief Allocates a buffer object.
      * 
      * @param pItemSizeof The size of each item being but into the buffer.
-     * @param pItemCount The number of items in the buffer.
+     * @param pItemCount The number of items in the buffer. Rounded up to a power of two, so there may be room for more.
      */
     LocklessRingBuffer(size_t pItemSizeof,size_t pItemCount);
 
     ~LocklessRingBuffer();
 
+    LocklessRingBuffer(const LocklessRingBuffer&) = delete;
+    LocklessRingBuffer& operator=(const LocklessRingBuffer&) = delete;
+
 	/**
 	 * @brief Will state if there is data to be read or not.
 	 * 
 	 * @return true No data to be read.
 	 * @return false There is data to read.
 	 */
-	bool Empty()const{return mCurrentReadPos == mNextWritePos;}
+	bool Empty()const{return mReadCount.load(std::memory_order_acquire) == mWriteCount.load(std::memory_order_acquire);}
+
+	/**
+	 * @brief The number of items it can hold, pItemCount rounded up to a power of two.
+	 */
+	size_t GetItemCount()const{return mItemCount;}
 	
 	/**
      * @brief Reads the next item that is in the buffer.
@@ -495,15 +1761,554 @@ public:
      */
     bool WriteNext(const void* pItem,size_t pBufferSize);
 
+    /**
+     * @brief Reads up to pMaxItems in one go, the reader count is only published once for the lot.
+     * Much quicker than ReadNext when passing lots of small items.
+     *
+     * @param rItems Where to put them, room for pMaxItems each GetItemSizeof() bytes, back to back.
+     * @param pMaxItems The most to read.
+     * @return size_t How many were read, zero if the buffer is empty.
+     */
+    size_t ReadBatch(void* rItems,size_t pMaxItems);
+
+    /**
+     * @brief Writes as many of pItems as there is room for, the write count is only published once for the lot.
+     *
+     * @param pItems The items, each GetItemSizeof() bytes, back to back.
+     * @param pNumItems How many there are.
+     * @return size_t How many were written, zero if the buffer is full. Write the rest later.
+     */
+    size_t WriteBatch(const void* pItems,size_t pNumItems);
+
+    size_t GetItemSizeof()const{return mItemSizeof;}
+
+    /**
+     * @brief Like ReadNext but if the buffer is empty waits for the writer to put something in it.
+     *
+     * @param pTimeoutMS How long to wait, -1 is forever.
+     * @return false Timed out, nothing read.
+     */
+    bool ReadWait(void* rItem,size_t pBufferSize,int pTimeoutMS = -1);
+
+    /**
+     * @brief Like WriteNext but if the buffer is full waits for the reader to make room.
+     *
+     * @param pTimeoutMS How long to wait, -1 is forever.
+     * @return false Timed out, nothing written.
+     */
+    bool WriteWait(const void* pItem,size_t pBufferSize,int pTimeoutMS = -1);
+
+private:
+    /**
+     * @brief Called after a count is published. The barrier pairs with the one the waiting side does after saying it's parked,
+     * so either we see it parked or it sees our new count. Never both missed.
+     * With membarrier the waiting side's barrier reaches over to us, so all we need is to stop the compiler moving things.
+     */
+    void WakeIfParked(std::atomic<uint32_t>& pParked)
+    {
+        if( mUseMembarrier )
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+        else
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if( pParked.load(std::memory_order_relaxed) != 0 )
+            Wake(pParked);
+    }
+    void Wake(std::atomic<uint32_t>& pParked);
+
+    /**
+     * @brief Copies items between the callers memory and the buffer, split in two where it wraps.
+     */
+    void CopyOut(size_t pFromCount,uint8_t* rItems,size_t pNumItems)const;
+    void CopyIn(size_t pToCount,const uint8_t* pItems,size_t pNumItems);
+
+    // Counts are free running, they are never wrapped, the index into the buffer is the count masked by mItemMask.
+    // Set up by the constructor and then only read, so fine to share a cache line.
+    uint8_t *mBuffer;
+    size_t mItemSizeof;
+    size_t mItemCount;
+    size_t mItemMask;
+    bool mUseMembarrier;
+
+    alignas(64) std::atomic<size_t> mReadCount;     //!< Items read, only written by the reader.
+    size_t mReadersWriteCount;                      //!< The readers copy of mWriteCount, only touched by the reader.
+    std::atomic<uint32_t> mWriterParked;            //!< Futex word, non zero when the writer is asleep in WriteWait. Next to what the reader writes as the reader checks it.
+
+    alignas(64) std::atomic<size_t> mWriteCount;    //!< Items written, only written by the writer.
+    size_t mWritersReadCount;                       //!< The writers copy of mReadCount, only touched by the writer.
+    std::atomic<uint32_t> mReaderParked;            //!< Futex word, non zero when the reader is asleep in ReadWait.
+};
+
+/**
+ * @brief Like LocklessRingBuffer but any number of threads can write and any number can read, all at the same time.
+ * Each item has a sequence number next to it that says if it's free to write, ready to read or still being used,
+ * so threads only fight over the read or write count with a compare and swap, never a lock.
+ * If you only have one writer and one reader use LocklessRingBuffer, it's quicker.
+ * Based on Dmitry Vyukov's bounded MPMC queue.
+ */
+class LocklessMPMCBuffer
+{
+public:
+    /**
+     * @brief Allocates a buffer object.
+     *
+     * @param pItemSizeof The size of each item being put into the buffer.
+     * @param pItemCount The number of items in the buffer. Rounded up to a power of two, and at least two, so there may be room for more.
+     */
+    LocklessMPMCBuffer(size_t pItemSizeof,size_t pItemCount);
+
+    ~LocklessMPMCBuffer();
+
+    LocklessMPMCBuffer(const LocklessMPMCBuffer&) = delete;
+    LocklessMPMCBuffer& operator=(const LocklessMPMCBuffer&) = delete;
+
+    /**
+     * @brief If there is nothing to read. Only a guide if other threads are busy with it.
+     */
+    bool Empty()const{return mReadCount.load(std::memory_order_acquire) == mWriteCount.load(std::memory_order_acquire);}
+
+    size_t GetItemCount()const{return mItemCount;}
+    size_t GetItemSizeof()const{return mItemSizeof;}
+
+    /**
+     * @brief Reads the next item that is in the buffer. Safe to call from many threads.
+     *
+     * @param rItem The memory store to write the data too.
+     * @param pBufferSize The size of the buffer we're writing too.
+     * @return true If data was read.
+     * @return false If the buffer is empty.
+     */
+    bool ReadNext(void* rItem,size_t pBufferSize);
+
+    /**
+     * @brief Writes an item to the buffer. Safe to call from many threads.
+     *
+     * @param pItem The item to write.
+     * @param pBufferSize The size of the buffer we're reading.
+     * @return true if there was room to write the item, false if the buffer is full.
+     */
+    bool WriteNext(const void* pItem,size_t pBufferSize);
+
 private:
-    volatile int mCurrentReadPos;//!< The current item READ index in the buffer. That is mBuffer + (mCurrentReadPos * mItemSizeof)    
-    volatile int mNextWritePos;//!< The current item WRITE index in the buffer. That is mBuffer + (mNextWritePos * mItemSizeof)
-    
+    // Each cell is the sequence number followed by the item, padded so the next sequence number is aligned.
+    std::atomic<size_t>* GetSequence(size_t pCount)const{return reinterpret_cast<std::atomic<size_t>*>(mBuffer + ((pCount & mItemMask) * mCellSizeof));}
+    uint8_t* GetItem(size_t pCount)const{return mBuffer + ((pCount & mItemMask) * mCellSizeof) + sizeof(std::atomic<size_t>);}
+
+    // Set up by the constructor and then only read, so fine to share a cache line.
     uint8_t *mBuffer;
     size_t mItemSizeof;
+    size_t mCellSizeof;
     size_t mItemCount;
+    size_t mItemMask;
+
+    alignas(64) std::atomic<size_t> mReadCount;     //!< The next item to be read, readers race for it with a compare and swap.
+    alignas(64) std::atomic<size_t> mWriteCount;    //!< The next item to be written, writers race for it with a compare and swap.
+};
+
+/**
+ * @brief A single producer, single consumer queue of N objects of type T. Same lockless scheme as LocklessRingBuffer,
+ * but the objects are constructed in place in the queue and moved out, so it's fine for std::string, std::unique_ptr etc.
+ * N must be a power of two. The storage is inside the object so a big queue wants to be made with new and not on the stack.
+ * The writing thread uses Emplace, TryPush, Reserve and Commit. The reading thread uses TryPop, Peek and Release.
+ */
+template<typename T,size_t N> class SpscQueue
+{
+    static_assert( N > 0 && (N & (N - 1)) == 0, "SpscQueue size must be a power of two" );
+
+public:
+    SpscQueue() = default;
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    ~SpscQueue()
+    {
+        // Destroy anything still in the queue, and anything reserved but not committed.
+        const size_t end = mWriteCount.load(std::memory_order_acquire) + (mReserved ? 1 : 0);
+        for( size_t n = mReadCount.load(std::memory_order_relaxed) ; n != end ; n++ )
+        {
+            Slot(n)->~T();
+        }
+    }
+
+    /**
+     * @brief Constructs the item in place at the back of the queue.
+     * @return false The queue is full, nothing was made.
+     */
+    template<typename... ARGS> bool Emplace(ARGS&&... pArgs)
+    {
+        if( Reserve(std::forward<ARGS>(pArgs)...) == nullptr )
+            return false;
+        Commit();
+        return true;
+    }
+
+    bool TryPush(T&& pItem){return Emplace(std::move(pItem));}
+    bool TryPush(const T& pItem){return Emplace(pItem);}
+
+    /**
+     * @brief Moves the item at the front of the queue into rItem.
+     * @return false The queue is empty.
+     */
+    bool TryPop(T& rItem)
+    {
+        T* item = Peek();
+        if( item == nullptr )
+            return false;
+        rItem = std::move(*item);
+        Release();
+        return true;
+    }
+
+    /**
+     * @brief Constructs an item in the queue, but does not let the reader see it, so it can be filled in where it is with no copy.
+     * Call Commit when it's ready. Calling Reserve again before Commit returns the same item, pArgs are then not used.
+     * Don't use Emplace or TryPush between Reserve and Commit.
+     * @return T* The item, nullptr if the queue is full.
+     */
+    template<typename... ARGS> T* Reserve(ARGS&&... pArgs)
+    {
+        const size_t writeCount = mWriteCount.load(std::memory_order_relaxed);
+        if( mReserved )
+            return Slot(writeCount);
+
+        if( writeCount - mWritersReadCount == N )
+        {
+            mWritersReadCount = mReadCount.load(std::memory_order_acquire);
+            if( writeCount - mWritersReadCount == N )
+                return nullptr;
+        }
+
+        T* item = new(mSlots[writeCount & (N - 1)].mBytes) T(std::forward<ARGS>(pArgs)...);
+        mReserved = true;
+        return item;
+    }
+
+    /**
+     * @brief Hands the item from Reserve to the reader.
+     */
+    void Commit()
+    {
+        if( mReserved == false )
+            TINYTOOLS_THROW("SpscQueue::Commit called without a Reserve");
+
+        mReserved = false;
+        mWriteCount.store(mWriteCount.load(std::memory_order_relaxed) + 1,std::memory_order_release);
+    }
+
+    /**
+     * @brief The item at the front of the queue, left in the queue so it can be used where it is. Call Release when done with it.
+     * @return T* nullptr if the queue is empty.
+     */
+    T* Peek()
+    {
+        const size_t readCount = mReadCount.load(std::memory_order_relaxed);
+        if( readCount == mReadersWriteCount )
+        {
+            mReadersWriteCount = mWriteCount.load(std::memory_order_acquire);
+            if( readCount == mReadersWriteCount )
+                return nullptr;
+        }
+        return Slot(readCount);
+    }
+
+    /**
+     * @brief Destroys the item Peek returned and frees its space for the writer.
+     */
+    void Release()
+    {
+        const size_t readCount = mReadCount.load(std::memory_order_relaxed);
+        Slot(readCount)->~T();
+        mReadCount.store(readCount + 1,std::memory_order_release);
+    }
+
+    bool Empty()const{return mReadCount.load(std::memory_order_acquire) == mWriteCount.load(std::memory_order_acquire);}
+
+    /**
+     * @brief How many are in it. Only a guide if the other thread is busy.
+     */
+    size_t Size()const{return mWriteCount.load(std::memory_order_acquire) - mReadCount.load(std::memory_order_acquire);}
+
+    static constexpr size_t Capacity(){return N;}
+
+private:
+    struct alignas(T) Storage
+    {
+        unsigned char mBytes[sizeof(T)];
+    };
+
+    T* Slot(size_t pCount){return std::launder(reinterpret_cast<T*>(mSlots[pCount & (N - 1)].mBytes));}
+
+    Storage mSlots[N];
+
+    alignas(64) std::atomic<size_t> mReadCount{0};  //!< Items read, only written by the reader.
+    size_t mReadersWriteCount = 0;                  //!< The readers copy of mWriteCount.
+
+    alignas(64) std::atomic<size_t> mWriteCount{0}; //!< Items written, only written by the writer.
+    size_t mWritersReadCount = 0;                   //!< The writers copy of mReadCount.
+    bool mReserved = false;                         //!< There is an item made by Reserve waiting for Commit.
+};
+
+
+/**
+ * @brief A single producer, single consumer ring buffer that lives in shared memory so two processes can use it.
+ * The producer makes it by name, the consumer attaches to it by name. Records are fixed size.
+ * Everything in the mapping is counts and offsets, no pointers, so it does not matter where each process maps it.
+ * Use Reserve and Commit to build a record where it is, and Peek and Release to read it where it is, for no copies at all.
+ * The consumer can tell if the producer has gone away, and if it went cleanly or crashed.
+ * If made with pUseEventFD the consumer gets an eventfd that goes readable when there is data, for epoll or EventLoop.
+ * That needs pidfd_getfd, if the kernel or permissions don't allow it GetEventFD returns -1 and ReadWait still works.
+ */
+class SharedRingBuffer
+{
+public:
+    enum ProducerState
+    {
+        PRODUCER_RUNNING,
+        PRODUCER_CLOSED,    //!< Went away cleanly, anything left can still be read.
+        PRODUCER_CRASHED    //!< Went away without closing, the last record may be half written but anything committed is good.
+    };
+
+    /**
+     * @brief Makes a new buffer as the producer. It is removed again when this is destroyed.
+     * One left with the same name by a producer that has gone is replaced. Throws if a producer that is still running has the name, or it is not a ring buffer.
+     *
+     * @param pName The name the consumer attaches with, as for shm_open. A '/' is added to the front if it does not have one.
+     * @param pItemSizeof The size of each record.
+     * @param pItemCount The number of records. Rounded up to a power of two.
+     * @param pUseEventFD Make an eventfd the consumer can wait on.
+     */
+    SharedRingBuffer(const std::string& pName,size_t pItemSizeof,size_t pItemCount,bool pUseEventFD = false);
+
+    /**
+     * @brief Attaches to a buffer a producer has made, as the consumer. Throws if it is not there.
+     */
+    SharedRingBuffer(const std::string& pName);
+
+    ~SharedRingBuffer();
+
+    SharedRingBuffer(const SharedRingBuffer&) = delete;
+    SharedRingBuffer& operator=(const SharedRingBuffer&) = delete;
+
+    /**
+     * @brief Unmaps the buffer. If the producer, marks it closed and removes the name. Called by the destructor.
+     * Reading or writing after this throws.
+     */
+    void Detach();
+
+    bool IsProducer()const{return mIsProducer;}
+    size_t GetItemSizeof()const{return mItemSizeof;}
+    size_t GetItemCount()const{return mItemMask + 1;}
+    bool Empty()const;
+
+    /**
+     * @brief Producer only. The next free record to write into, nullptr if the buffer is full. Call Commit when it's filled in.
+     * Calling it again before Commit gives the same record. Commit without a Reserve throws.
+     */
+    void* Reserve();
+    void Commit();
+
+    bool WriteNext(const void* pItem,size_t pBufferSize);
+    bool WriteWait(const void* pItem,size_t pBufferSize,int pTimeoutMS = -1);
+
+    /**
+     * @brief Consumer only. The next record to read, nullptr if the buffer is empty. Call Release when done with it.
+     * Release without a Peek that returned a record throws.
+     */
+    const void* Peek();
+    void Release();
+
+    bool ReadNext(void* rItem,size_t pBufferSize);
+
+    /**
+     * @brief Waits for a record. Also returns false, without waiting out pTimeoutMS, if the producer has gone and the buffer is empty.
+     */
+    bool ReadWait(void* rItem,size_t pBufferSize,int pTimeoutMS = -1);
+
+    /**
+     * @brief Consumer only. How the producer is doing.
+     */
+    ProducerState GetProducerState()const;
+
+    /**
+     * @brief Consumer only. Readable when there is data, -1 if not made with pUseEventFD or it could not be got.
+     * When it fires call ReadNext or Peek until they say empty, they deal with the eventfd and arm it again.
+     */
+    int GetEventFD()const{return mEventFD;}
+
+private:
+    struct Header;
+
+    void CheckAttached(const char* pFunction)const;
+    void Map(int pFD,size_t pSize);
+    void WakeReader();
+
+    std::string mName;
+    bool mIsProducer = false;
+    Header* mHeader = nullptr;
+    uint8_t* mItems = nullptr;
+    size_t mMappedSize = 0;
+    size_t mItemSizeof = 0;
+    size_t mItemMask = 0;
+    int mEventFD = -1;          //!< The producers eventfd, in the consumer the copy we got with pidfd_getfd.
+    int mProducerPIDFD = -1;    //!< Consumer only, readable when the producer process ends.
+    size_t mCachedCount = 0;    //!< The producers copy of the read count, or the consumers copy of the write count.
+    bool mReserved = false;     //!< There is a record from Reserve waiting for Commit.
+    bool mPeeked = false;       //!< There is a record from Peek waiting for Release.
+};
+
+/**
+ * @brief A pool of worker threads for fanning work out, per host scans, hashing lots of files, that sort of thing.
+ * Each worker has its own queue. Work submitted from a worker goes on its own queue, and a worker with nothing to do
+ * takes work off the other end of someone else's queue. So it keeps going when some jobs take much longer than others.
+ * The destructor, or Shutdown, finishes everything that has been submitted before the threads exit.
+ */
+class ThreadPool
+{
+public:
+    /**
+     * @brief Starts the worker threads.
+     *
+     * @param pNumThreads How many, zero for one per CPU we're allowed to run on.
+     * @param pPinThreads Pin each worker to one of the CPUs we're allowed to run on, in turn. Stops them being moved about and losing their cache.
+     */
+    ThreadPool(size_t pNumThreads = 0,bool pPinThreads = false);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * @brief Queues pFunc(pArgs...) to be run by a worker.
+     * @return std::future For the result, or the exception it threw.
+     */
+    template<typename FUNC,typename... ARGS> auto Submit(FUNC&& pFunc,ARGS&&... pArgs) -> std::future<std::invoke_result_t<std::decay_t<FUNC>&,std::decay_t<ARGS>...>>
+    {
+        // The call made is a stored copy of pFunc with stored copies of the arguments moved in, so the result type is worked out for that.
+        typedef std::invoke_result_t<std::decay_t<FUNC>&,std::decay_t<ARGS>...> RESULT;
+        // std::function has to be copyable and a packaged_task is not, hence the shared_ptr.
+        // The arguments are moved into the call, unlike std::bind, so move only ones like std::unique_ptr work.
+        auto task = std::make_shared<std::packaged_task<RESULT()>>(
+            [func = std::forward<FUNC>(pFunc),args = std::make_tuple(std::forward<ARGS>(pArgs)...)]() mutable -> RESULT
+            {
+                return std::apply(func,std::move(args));
+            });
+        std::future<RESULT> result = task->get_future();
+        Push([task](){(*task)();});
+        return result;
+    }
+
+    /**
+     * @brief Calls pWork with ranges that between them cover pBegin to pEnd, spread over the workers, and waits for them all.
+     * The calling thread does its share too, so it is fine to call from inside a task.
+     * If any throw, the first exception is thrown again from here once all the others are done.
+     *
+     * @param pChunkSize How many to do in each call, zero to pick one that gives each worker a few goes.
+     */
+    void ParallelFor(size_t pBegin,size_t pEnd,const std::function<void(size_t pBegin,size_t pEnd)>& pWork,size_t pChunkSize = 0);
+
+    /**
+     * @brief Runs everything that is queued, then stops the workers and waits for them. Submit will throw after this.
+     */
+    void Shutdown();
+
+    size_t GetNumThreads()const{return mWorkers.size();}
+
+private:
+    typedef std::function<void()> Task;
+
+    struct Worker
+    {
+        std::mutex mMutex;
+        std::deque<Task> mTasks;    //!< Owner pushes and pops at the back, thieves take from the front.
+        std::thread mThread;
+    };
+
+    void Push(Task&& pTask);
+    bool PopTask(size_t pWorker,Task& rTask);
+    void WorkerLoop(size_t pWorker);
+
+    std::vector<std::unique_ptr<Worker>> mWorkers;
+    std::atomic<size_t> mPending;       //!< Tasks queued and not yet taken.
+    std::atomic<size_t> mNextWorker;    //!< Round robin for work submitted from outside the pool.
+    std::mutex mSleepMutex;
+    std::condition_variable mSleeper;   //!< Idle workers wait on this for work or shutdown.
+    bool mStopping;
 };
 
+/**
+ * @brief Runs lots of periodic jobs on a few threads, instead of a SleepableThread, and a thread, for each.
+ * Intervals are in microseconds. FIXED_RATE runs on a fixed beat however long the work takes, if a run is so late it misses
+ * whole beats they are skipped, not run back to back to catch up. FIXED_DELAY waits the interval after each run finishes.
+ * Jitter adds a random delay up to that much to each run, so jobs added together don't all go off at once. For FIXED_RATE the
+ * jitter does not build up, the beat stays where it was.
+ * A job runs on one thread at a time, never two at once. As with SleepableThread the work must not throw.
+ */
+class TaskScheduler
+{
+public:
+    typedef uint64_t TaskID;
+
+    enum Mode
+    {
+        FIXED_RATE,     //!< Start every interval.
+        FIXED_DELAY     //!< Start an interval after the last run ended.
+    };
+
+    /**
+     * @brief Starts the threads that will run the jobs.
+     */
+    TaskScheduler(size_t pNumThreads = 1);
+    ~TaskScheduler();
+
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+    /**
+     * @brief Adds a job. It runs the first time straight away, or after a random part of pJitter, and then every pInterval.
+     * Can be called from inside a job.
+     * @return TaskID For Cancel.
+     */
+    TaskID Add(std::chrono::microseconds pInterval,std::function<void()> pWork,Mode pMode = FIXED_RATE,std::chrono::microseconds pJitter = std::chrono::microseconds(0));
+
+    /**
+     * @brief Stops a job. If it's running right now waits for it to finish, so once this returns it won't run again.
+     * A job can cancel its self, then it does not wait.
+     * @return false If there was no such job.
+     */
+    bool Cancel(TaskID pTask);
+
+    size_t GetNumTasks()const;
+
+    /**
+     * @brief Asks the threads to exit, waits for any running jobs to finish and the threads to go. Nothing runs after it returns.
+     */
+    void TellThreadsToExitAndWait();
+
+private:
+    struct Task
+    {
+        std::function<void()> mWork;
+        std::chrono::microseconds mInterval;
+        std::chrono::microseconds mJitter;
+        Mode mMode;
+        std::chrono::steady_clock::time_point mBeat;    //!< When it should run, before jitter. For FIXED_RATE this moves on one interval at a time.
+        std::thread::id mRunningOn;                     //!< Set while it's running.
+        bool mCancelled = false;
+    };
+
+    void WorkerLoop();
+    void Schedule(TaskID pID,Task& pTask);
+
+    mutable std::mutex mMutex;
+    std::condition_variable mWakeUp;        //!< Workers wait on this for the next job to be due.
+    std::condition_variable mTaskDone;      //!< Cancel waits on this for a running job to finish.
+    std::map<TaskID,std::shared_ptr<Task>> mTasks;
+    std::set<std::pair<std::chrono::steady_clock::time_point,TaskID>> mQueue;    //!< Soonest first, like EventLoop's timers.
+    std::vector<std::thread> mThreads;
+    std::minstd_rand mRandom;
+    TaskID mNextTaskID = 1;
+    bool mKeepGoing = true;
+};
 
 };//namespace threading{
 
@@ -0,0 +1,117 @@
+#!/usr/bin/seabang --debug
+
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <assert.h>
+
+#include "../TinyTools.h"
+#include "../TinyTools.cpp"
+
+using namespace tinytools::network;
+
+// Sends a load of frames down a pipe with FrameWriter and checks FrameReader gets them all back.
+int main(int argc, char *argv[])
+{
+    const int numFrames = 10000;
+
+    std::vector<std::vector<uint8_t>> messages;
+    for( int n = 0 ; n < numFrames ; n++ )
+    {
+        std::vector<uint8_t> message(rand()%300);
+        for( auto& b : message )
+        {
+            b = rand()&255;
+        }
+        messages.push_back(message);
+    }
+
+    int pipeFDs[2];
+    assert( pipe(pipeFDs) == 0 );
+
+    std::thread reader([&messages,&pipeFDs]()
+    {
+        FrameReader frameReader;
+        size_t next = 0;
+        std::vector<uint8_t> decoded;
+        while( frameReader.Read(pipeFDs[0],[&](const uint8_t* p7Bit,size_t p7BitSize)
+        {
+            Decode7Bit(p7Bit,p7BitSize,decoded);
+            assert( next < messages.size() );
+            assert( decoded == messages[next] );
+            next++;
+            return true;
+        }) > 0 ){}
+        assert( next == messages.size() );
+        std::cout << "Received " << next << " frames\n";
+    });
+
+    // Half through Queue, half already encoded through QueueEncoded.
+    FrameWriter writer;
+    std::vector<std::vector<uint8_t>> encoded(messages.size());
+    for( size_t n = 0 ; n < messages.size() ; n++ )
+    {
+        if( n&1 )
+        {
+            Encode7Bit(messages[n].data(),messages[n].size(),encoded[n]);
+            writer.QueueEncoded(encoded[n].data(),encoded[n].size());
+        }
+        else
+        {
+            writer.Queue(messages[n].data(),messages[n].size());
+        }
+
+        if( (n % 1000) == 999 )
+        {
+            assert( writer.Flush(pipeFDs[1]) );
+            assert( writer.GetQueuedBytes() == 0 );
+        }
+    }
+    assert( writer.Flush(pipeFDs[1]) );
+    close(pipeFDs[1]);
+    reader.join();
+    close(pipeFDs[0]);
+
+    // Junk before a frame, a broken frame and a partial frame at the end.
+    const uint8_t stream[] = {1,2,3,FRAME_START,10,11,FRAME_END,FRAME_START,20,0xff,FRAME_START,30,FRAME_END,99,FRAME_START,40};
+    std::vector<uint8_t> firstBytes;
+    const size_t used = ParseFrames(stream,sizeof(stream),[&firstBytes](const uint8_t* p7Bit,size_t p7BitSize)
+    {
+        firstBytes.push_back(p7Bit[0]);
+        return true;
+    });
+    assert( firstBytes == std::vector<uint8_t>({10,30}) );
+    assert( used == sizeof(stream) - 2 );
+
+    {// A frame that never ends is dropped at the size limit, and the reader picks up again at the next frame.
+        assert( pipe(pipeFDs) == 0 );
+        FrameReader smallReader(16,64);
+        std::vector<uint8_t> endless(1,FRAME_START);
+        endless.resize(1000,1);
+        endless.push_back(FRAME_END);// Ends in the end but far too late.
+        std::vector<uint8_t> good;
+        const uint8_t message[] = {1,2,3,4,5};
+        Encode7Bit(message,sizeof(message),good);
+        good.insert(good.begin(),FRAME_START);
+        good.push_back(FRAME_END);
+        assert( write(pipeFDs[1],endless.data(),endless.size()) == (ssize_t)endless.size() );
+        assert( write(pipeFDs[1],good.data(),good.size()) == (ssize_t)good.size() );
+        close(pipeFDs[1]);
+
+        int frames = 0;
+        std::vector<uint8_t> decoded;
+        while( smallReader.Read(pipeFDs[0],[&](const uint8_t* p7Bit,size_t p7BitSize)
+        {
+            Decode7Bit(p7Bit,p7BitSize,decoded);
+            assert( decoded == std::vector<uint8_t>(message,message + sizeof(message)) );
+            frames++;
+            return true;
+        }) > 0 ){}
+        close(pipeFDs[0]);
+        assert( frames == 1 );
+        std::cout << "Oversized frame dropped\n";
+    }
+
+    std::cout << "All good\n";
+    return EXIT_SUCCESS;
+}
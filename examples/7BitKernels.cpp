@@ -0,0 +1,120 @@
+#!/usr/bin/seabang --debug
+
+#include <iostream>
+#include <vector>
+#include <assert.h>
+
+#include "../TinyTools.h"
+#include "../TinyTools.cpp"
+
+using namespace tinytools::network;
+
+static const char* KernelName(CodecKernel pKernel)
+{
+    switch( pKernel )
+    {
+    case CodecKernel::SCALAR:   return "SCALAR";
+    case CodecKernel::BMI2:     return "BMI2";
+    case CodecKernel::SSE41:    return "SSE41";
+    case CodecKernel::AVX2:     return "AVX2";
+    }
+    return "?";
+}
+
+// Encodes and decodes with the scalar kernel and then the one passed, the output must be identical.
+static void TestKernel(CodecKernel pKernel,size_t pNumValues)
+{
+    std::vector<uint8_t> randomData;
+    for( size_t n = 0 ; n < pNumValues ; n++ )
+    {
+        randomData.push_back(rand()&255);
+    }
+
+    SetCodecKernel(CodecKernel::SCALAR);
+    uint8_t* scalar7 = nullptr;
+    const size_t scalar7Size = Encode7Bit(randomData.data(),randomData.size(),&scalar7);
+    uint8_t* scalar8 = nullptr;
+    const size_t scalar8Size = Decode7Bit(scalar7,scalar7Size,&scalar8);
+
+    assert( SetCodecKernel(pKernel) );
+    uint8_t* simd7 = nullptr;
+    const size_t simd7Size = Encode7Bit(randomData.data(),randomData.size(),&simd7);
+    uint8_t* simd8 = nullptr;
+    const size_t simd8Size = Decode7Bit(scalar7,scalar7Size,&simd8);
+
+    if( simd7Size != scalar7Size || memcmp(simd7,scalar7,scalar7Size) != 0 )
+    {
+        std::cerr << KernelName(pKernel) << " encode differs from scalar for " << pNumValues << " bytes\n";
+        assert(false);
+    }
+
+    if( simd8Size != scalar8Size || scalar8Size != pNumValues || memcmp(simd8,scalar8,scalar8Size) != 0 || memcmp(simd8,randomData.data(),pNumValues) != 0 )
+    {
+        std::cerr << KernelName(pKernel) << " decode differs from scalar for " << pNumValues << " bytes\n";
+        assert(false);
+    }
+
+    delete []scalar7;
+    delete []scalar8;
+    delete []simd7;
+    delete []simd8;
+}
+
+int main(int argc, char *argv[])
+{
+    const CodecKernel defaultKernel = GetCodecKernel();
+    std::cout << "Default kernel " << KernelName(defaultKernel) << "\n";
+
+    for( CodecKernel kernel : {CodecKernel::BMI2,CodecKernel::SSE41,CodecKernel::AVX2} )
+    {
+        if( IsCodecKernelSupported(kernel) == false )
+        {
+            std::cout << KernelName(kernel) << " not supported, skipped\n";
+            continue;
+        }
+
+        // Enough groups to go through the vector loops a few times, and every tail length after them.
+        for( size_t size = 1 ; size < 7 * 40 ; size++ )
+        {
+            TestKernel(kernel,size);
+        }
+        // And some big ones.
+        for( size_t size = 100000 ; size < 100007 ; size++ )
+        {
+            TestKernel(kernel,size);
+        }
+        std::cout << KernelName(kernel) << " matches scalar\n";
+    }
+
+    // CRC32C, check value from the spec, then split into pieces and through the fused codec.
+    // The codec kernel and the CRC instruction are set separately, so try the tables with the SIMD codec and the other way round.
+    for( bool hardware : {false,true} )
+    {
+        if( SetCrc32cHardware(hardware) == false )
+            continue;// No SSE4.2.
+
+        const CodecKernel kernel = hardware ? CodecKernel::SCALAR : defaultKernel;
+        SetCodecKernel(kernel);
+        assert( Crc32c("123456789",9) == 0xe3069283 );
+
+        std::vector<uint8_t> data(100003);
+        for( auto& b : data )
+        {
+            b = rand()&255;
+        }
+        const uint32_t whole = Crc32c(data.data(),data.size());
+        assert( Crc32c(data.data() + 1001,data.size() - 1001,Crc32c(data.data(),1001)) == whole );
+
+        std::vector<uint8_t> encoded(Encoded7BitSize(data.size()));
+        std::vector<uint8_t> decoded(data.size());
+        uint32_t encodeCrc = 0,decodeCrc = 0;
+        Encode7BitCrc32c(data.data(),data.size(),encoded.data(),encoded.size(),encodeCrc);
+        Decode7BitCrc32c(encoded.data(),encoded.size(),decoded.data(),decoded.size(),decodeCrc);
+        assert( encodeCrc == whole && decodeCrc == whole && decoded == data );
+        std::cout << "CRC32C good with " << (hardware ? "crc32 instruction" : "slice by 8") << " and " << KernelName(kernel) << "\n";
+    }
+
+    std::cout << "All good\n";
+
+    return EXIT_SUCCESS;
+}
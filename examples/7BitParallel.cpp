@@ -0,0 +1,61 @@
+#!/usr/bin/seabang --debug
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <assert.h>
+
+#include "../TinyTools.h"
+#include "../TinyTools.cpp"
+
+using namespace tinytools::network;
+
+// Shows how the parallel 7 bit codec scales with the number of threads.
+// Threshold is set to zero so even one thread goes through the parallel code.
+int main(int argc, char *argv[])
+{
+    const size_t payloadSize = 64 * 1024 * 1024 + 3;// Odd size so there is a tail.
+    const int loops = 10;
+
+    std::vector<uint8_t> payload(payloadSize);
+    for( auto& b : payload )
+    {
+        b = rand()&255;
+    }
+
+    std::vector<uint8_t> reference7;
+    Encode7Bit(payload.data(),payload.size(),reference7);
+
+    std::vector<uint8_t> encoded(Encoded7BitSize(payloadSize));
+    std::vector<uint8_t> decoded(payloadSize);
+
+    const size_t maxThreads = std::max(8u,std::thread::hardware_concurrency());
+    std::cout << "Payload " << payloadSize / (1024*1024) << "MB, hardware threads " << std::thread::hardware_concurrency() << "\n";
+    std::cout << "Threads   Encode MB/s   Decode MB/s\n";
+
+    for( size_t threads = 1 ; threads <= maxThreads ; threads++ )
+    {
+        const auto start = std::chrono::steady_clock::now();
+        for( int n = 0 ; n < loops ; n++ )
+        {
+            Encode7BitParallel(payload.data(),payload.size(),encoded.data(),encoded.size(),threads,0);
+        }
+        const auto encodeDone = std::chrono::steady_clock::now();
+        for( int n = 0 ; n < loops ; n++ )
+        {
+            Decode7BitParallel(encoded.data(),encoded.size(),decoded.data(),decoded.size(),threads,0);
+        }
+        const auto decodeDone = std::chrono::steady_clock::now();
+
+        assert( encoded == reference7 );
+        assert( decoded == payload );
+
+        const double MB = double(payloadSize * loops) / (1024.0 * 1024.0);
+        const double encodeSeconds = std::chrono::duration<double>(encodeDone - start).count();
+        const double decodeSeconds = std::chrono::duration<double>(decodeDone - encodeDone).count();
+
+        std::cout << std::setw(7) << threads << std::setw(14) << int(MB / encodeSeconds) << std::setw(14) << int(MB / decodeSeconds) << "\n";
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -48,12 +48,53 @@ static void TestBitPacking(int pNumValues)
         assert( out8[n] == randomData[n] );
     }
 
+    // The allocation free versions must give the same result.
+    std::vector<uint8_t> vec7,vec8;
+    assert( tinytools::network::Encode7Bit(randomData.data(),randomData.size(),vec7) == outSize );
+    assert( outSize == tinytools::network::Encoded7BitSize(randomData.size()) );
+    assert( memcmp(vec7.data(),out,outSize) == 0 );
+    assert( tinytools::network::Decode7Bit(vec7.data(),vec7.size(),vec8) == out8Size );
+    assert( out8Size == tinytools::network::Decoded7BitSize(outSize) );
+    assert( memcmp(vec8.data(),randomData.data(),out8Size) == 0 );
+
+    // Streaming in random sized chunks must also give the same bytes.
+    tinytools::network::SevenBitEncoder encoder;
+    tinytools::network::SevenBitDecoder decoder;
+    std::vector<uint8_t> stream7,stream8;
+    for( size_t n = 0 ; n < randomData.size() ; )
+    {
+        const size_t chunk = std::min(randomData.size() - n,(size_t)(rand()%20));
+        encoder.Feed(randomData.data() + n,chunk,stream7);
+        n += chunk;
+    }
+    encoder.Flush(stream7);
+    assert( stream7.size() == outSize && memcmp(stream7.data(),out,outSize) == 0 );
+
+    for( size_t n = 0 ; n < stream7.size() ; )
+    {
+        const size_t chunk = std::min(stream7.size() - n,(size_t)(rand()%20));
+        decoder.Feed(stream7.data() + n,chunk,stream8);
+        n += chunk;
+    }
+    decoder.Flush(stream8);
+    assert( stream8.size() == out8Size && memcmp(stream8.data(),randomData.data(),out8Size) == 0 );
+
     delete []out;
     delete []out8;
 }
 
 int main(int argc, char *argv[])
 {
+    // Sizes are constexpr so buffers can go on the stack.
+    static_assert( tinytools::network::Encoded7BitSize(7) == 8 );
+    static_assert( tinytools::network::Decoded7BitSize(8) == 7 );
+    uint8_t stack7[tinytools::network::Encoded7BitSize(3)];
+    uint8_t stack8[tinytools::network::Decoded7BitSize(sizeof(stack7))];
+    const uint8_t three[3] = {0xff,0x00,0xaa};
+    tinytools::network::Encode7Bit(three,3,stack7,sizeof(stack7));
+    assert( tinytools::network::Decode7Bit(stack7,sizeof(stack7),stack8,sizeof(stack8)) == 3 );
+    assert( memcmp(three,stack8,3) == 0 );
+
     // Run as two threads to ensure no threading issues.
 
     std::thread otherThread = std::thread([]()
@@ -0,0 +1,147 @@
+#!/usr/bin/seabang --debug
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <assert.h>
+
+#include "../TinyTools.h"
+#include "../TinyTools.cpp"
+
+using namespace tinytools::network;
+
+// Checks the base64 and hex kernels against the scalar code, then compares the speed of all the codecs on the same payloads.
+
+static std::vector<uint8_t> RandomData(size_t pSize)
+{
+    std::vector<uint8_t> data(pSize);
+    for( auto& b : data )
+    {
+        b = rand()&255;
+    }
+    return data;
+}
+
+static void CheckKernel(CodecKernel pKernel)
+{
+    for( size_t size = 0 ; size < 300 ; size++ )
+    {
+        const std::vector<uint8_t> data = RandomData(size);
+        for( Base64Alphabet alphabet : {Base64Alphabet::STANDARD,Base64Alphabet::URL_SAFE} )
+        {
+            std::string scalar,simd;
+            std::vector<uint8_t> decodedScalar,decodedSIMD;
+
+            SetCodecKernel(CodecKernel::SCALAR);
+            EncodeBase64(data.data(),data.size(),scalar,alphabet);
+            DecodeBase64(scalar.data(),scalar.size(),decodedScalar,alphabet);
+
+            SetCodecKernel(pKernel);
+            EncodeBase64(data.data(),data.size(),simd,alphabet);
+            DecodeBase64(scalar.data(),scalar.size(),decodedSIMD,alphabet);
+
+            assert( simd == scalar );
+            assert( decodedScalar == data && decodedSIMD == data );
+        }
+
+        std::string hexScalar,hexSIMD;
+        std::vector<uint8_t> decodedScalar,decodedSIMD;
+        SetCodecKernel(CodecKernel::SCALAR);
+        EncodeHex(data.data(),data.size(),hexScalar,size&1);
+        DecodeHex(hexScalar.data(),hexScalar.size(),decodedScalar);
+        SetCodecKernel(pKernel);
+        EncodeHex(data.data(),data.size(),hexSIMD,size&1);
+        DecodeHex(hexScalar.data(),hexScalar.size(),decodedSIMD);
+        assert( hexSIMD == hexScalar );
+        assert( decodedScalar == data && decodedSIMD == data );
+    }
+
+    // A bad character anywhere must be caught, including inside a SIMD block.
+    std::string text;
+    const std::vector<uint8_t> data = RandomData(200);
+    EncodeBase64(data.data(),data.size(),text);
+    for( size_t n = 0 ; n < text.size() - 2 ; n += 7 )
+    {
+        std::string bad = text;
+        bad[n] = '*';
+        std::vector<uint8_t> out;
+        bool threw = false;
+        try{DecodeBase64(bad.data(),bad.size(),out);}catch( std::runtime_error& ){threw = true;}
+        assert( threw );
+    }
+    EncodeHex(data.data(),data.size(),text);
+    for( size_t n = 0 ; n < text.size() ; n += 5 )
+    {
+        std::string bad = text;
+        bad[n] = 'g';
+        std::vector<uint8_t> out;
+        bool threw = false;
+        try{DecodeHex(bad.data(),bad.size(),out);}catch( std::runtime_error& ){threw = true;}
+        assert( threw );
+    }
+}
+
+template <typename CODEC> static double MBPerSecond(size_t pPayloadSize,CODEC pCodec)
+{
+    const size_t totalBytes = 256 * 1024 * 1024;
+    const size_t loops = std::max<size_t>(1,totalBytes / pPayloadSize);
+    const auto start = std::chrono::steady_clock::now();
+    for( size_t n = 0 ; n < loops ; n++ )
+    {
+        pCodec();
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return double(pPayloadSize * loops) / (1024.0 * 1024.0) / seconds;
+}
+
+int main(int argc, char *argv[])
+{
+    // RFC 4648 test vectors.
+    const char* vectors[][2] = {{"",""},{"f","Zg=="},{"fo","Zm8="},{"foo","Zm9v"},{"foob","Zm9vYg=="},{"fooba","Zm9vYmE="},{"foobar","Zm9vYmFy"}};
+    for( auto& v : vectors )
+    {
+        std::string text;
+        EncodeBase64((const uint8_t*)v[0],strlen(v[0]),text);
+        assert( text == v[1] );
+    }
+
+    const CodecKernel best = GetCodecKernel();
+    for( CodecKernel kernel : {CodecKernel::SSE41,CodecKernel::AVX2} )
+    {
+        if( IsCodecKernelSupported(kernel) )
+        {
+            CheckKernel(kernel);
+        }
+    }
+    std::cout << "Kernels match scalar\n";
+
+    std::cout << "Throughput in MB/s of 8 bit payload\n";
+    std::cout << "Kernel  Payload    7bit enc  7bit dec  b64 enc  b64 dec  url enc  url dec  hex enc  hex dec\n";
+    for( CodecKernel kernel : {CodecKernel::SCALAR,best} )
+    {
+        SetCodecKernel(kernel);
+        for( size_t payloadSize : {64,1024,64*1024,1024*1024} )
+        {
+            const std::vector<uint8_t> payload = RandomData(payloadSize);
+            std::vector<uint8_t> encoded7(Encoded7BitSize(payloadSize)),decoded(payloadSize);
+            std::string base64(EncodedBase64Size(payloadSize),0),url(EncodedBase64Size(payloadSize,Base64Alphabet::URL_SAFE),0),hex(EncodedHexSize(payloadSize),0);
+            Encode7Bit(payload.data(),payload.size(),encoded7.data(),encoded7.size());
+            EncodeBase64(payload.data(),payload.size(),base64);
+            EncodeBase64(payload.data(),payload.size(),url,Base64Alphabet::URL_SAFE);
+            EncodeHex(payload.data(),payload.size(),hex);
+
+            std::cout << std::setw(6) << (kernel == CodecKernel::SCALAR ? "scalar" : "SIMD") << std::setw(9) << payloadSize;
+            std::cout << std::setw(12) << int(MBPerSecond(payloadSize,[&](){Encode7Bit(payload.data(),payload.size(),encoded7.data(),encoded7.size());}));
+            std::cout << std::setw(10) << int(MBPerSecond(payloadSize,[&](){Decode7Bit(encoded7.data(),encoded7.size(),decoded.data(),decoded.size());}));
+            std::cout << std::setw(9) << int(MBPerSecond(payloadSize,[&](){EncodeBase64(payload.data(),payload.size(),&base64[0],base64.size());}));
+            std::cout << std::setw(9) << int(MBPerSecond(payloadSize,[&](){DecodeBase64(base64.data(),base64.size(),decoded.data(),decoded.size());}));
+            std::cout << std::setw(9) << int(MBPerSecond(payloadSize,[&](){EncodeBase64(payload.data(),payload.size(),&url[0],url.size(),Base64Alphabet::URL_SAFE);}));
+            std::cout << std::setw(9) << int(MBPerSecond(payloadSize,[&](){DecodeBase64(url.data(),url.size(),decoded.data(),decoded.size(),Base64Alphabet::URL_SAFE);}));
+            std::cout << std::setw(9) << int(MBPerSecond(payloadSize,[&](){EncodeHex(payload.data(),payload.size(),&hex[0],hex.size());}));
+            std::cout << std::setw(9) << int(MBPerSecond(payloadSize,[&](){DecodeHex(hex.data(),hex.size(),decoded.data(),decoded.size());}));
+            std::cout << "\n";
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,85 @@
+#!/usr/bin/seabang --debug
+
+#include <iostream>
+#include <thread>
+#include <assert.h>
+
+#include "../TinyTools.h"
+#include "../TinyTools.cpp"
+
+using namespace tinytools::network;
+
+// Puts a pipe, timers, a signal and work from another thread through one EventLoop.
+int main(int argc, char *argv[])
+{
+    EventLoop loop;
+
+    // Signals first, before there are other threads for it to go to.
+    int signals = 0;
+    loop.AddSignal(SIGUSR1,[&signals](int pSignal)
+    {
+        assert( pSignal == SIGUSR1 );
+        signals++;
+    });
+
+    // A pipe, written to by a timer.
+    int pipeFDs[2];
+    assert( pipe(pipeFDs) == 0 );
+    std::string received;
+    loop.AddFD(pipeFDs[0],EPOLLIN,[&](uint32_t pEvents)
+    {
+        char buffer[64];
+        const ssize_t got = read(pipeFDs[0],buffer,sizeof(buffer));
+        if( got > 0 )
+        {
+            received.append(buffer,got);
+        }
+        if( received.size() >= 5 )
+        {
+            loop.RemoveFD(pipeFDs[0]);// Removing itself while running.
+        }
+    });
+
+    // Repeating timer, writes a char each time and raises the signal.
+    int ticks = 0;
+    EventLoop::TimerID ticker = loop.AddRepeatingTimer(10,[&]()
+    {
+        ticks++;
+        assert( write(pipeFDs[1],"x",1) == 1 );
+        kill(getpid(),SIGUSR1);
+    });
+
+    // One shot that cancels the ticker, and one that gets cancelled before it fires.
+    bool cancelledFired = false;
+    const EventLoop::TimerID cancelled = loop.AddTimer(30,[&cancelledFired](){cancelledFired = true;});
+    loop.AddTimer(5,[&loop,cancelled](){loop.CancelTimer(cancelled);});
+    loop.AddTimer(105,[&loop,ticker](){loop.CancelTimer(ticker);});
+
+    // Work posted from another thread, the last one stops the loop after the timers are done.
+    std::thread poster([&loop]()
+    {
+        for( int n = 0 ; n < 1000 ; n++ )
+        {
+            loop.Post([](){});
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        loop.Post([&loop](){loop.Stop();});
+    });
+
+    const auto start = std::chrono::steady_clock::now();
+    loop.Run();
+    const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    poster.join();
+
+    std::cout << "Ran for " << ms << "ms, " << ticks << " ticks " << signals << " signals, received " << received << "\n";
+    assert( ticks >= 8 && ticks <= 10 );// Ticks are dropped if the loop is held up for more than an interval.
+    assert( signals > 0 && signals <= ticks );// Standard signals that arrive together are merged into one.
+    assert( received == "xxxxx" );
+    assert( cancelledFired == false );
+
+    close(pipeFDs[0]);
+    close(pipeFDs[1]);
+
+    std::cout << "All good\n";
+    return EXIT_SUCCESS;
+}
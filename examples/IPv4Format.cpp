@@ -0,0 +1,112 @@
+#!/usr/bin/seabang --debug
+
+#include <iostream>
+#include <vector>
+#include <random>
+#include <assert.h>
+
+#include "../TinyTools.h"
+#include "../TinyTools.cpp"
+
+using namespace tinytools::network;
+
+// How IPv4ToString used to do it, kept to benchmark against.
+static std::string OldIPv4ToString(uint32_t pIPv4)
+{
+    int a = (pIPv4&0x000000ff)>>0;
+    int b = (pIPv4&0x0000ff00)>>8;
+    int c = (pIPv4&0x00ff0000)>>16;
+    int d = (pIPv4&0xff000000)>>24;
+
+    return std::to_string(a) + "." + std::to_string(b) + "." + std::to_string(c) + "." + std::to_string(d);
+}
+
+template<typename WORK> static void Time(const char* pName,size_t pCount,WORK pWork)
+{
+    const auto start = std::chrono::steady_clock::now();
+    pWork();
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << pName << " " << (size_t)(pCount / seconds / 1e6) << " million per second\n";
+}
+
+// Checks formatting and parsing match inet_ntop and inet_pton, then times them against the old ways.
+int main(int argc, char *argv[])
+{
+    static_assert( MakeIP4V(192,168,1,1) == 0x0101a8c0 );
+    static_assert( MakeIP4V(255,255,255,255) == 0xffffffff );
+
+    std::mt19937 random(42);
+    const size_t count = 1000000;
+    std::vector<uint32_t> addresses(count);
+    for( auto& a : addresses )
+    {
+        // Mix up the octet sizes, a random 32 bit value is nearly always three digit octets.
+        a = MakeIP4V(random() >> (random()%8),random() >> (random()%8),random() >> (random()%8),random() >> (random()%8));
+    }
+
+    // Formatting, must be the same as inet_ntop.
+    for( auto a : addresses )
+    {
+        char expected[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET,&a,expected,sizeof(expected));
+        assert( IPv4ToString(a) == expected );
+    }
+    std::cout << "Formatting good\n";
+
+    // Parsing, must accept and reject the same as inet_pton.
+    const std::vector<std::string> odd =
+    {
+        "","1","1.2.3","1.2.3.4.","1.2.3.4.5",".1.2.3","1..2.3","01.2.3.4","1.2.3.04","0.0.0.0","255.255.255.255",
+        "256.1.1.1","1.1.1.256","1.1.1.1000","1.1.1.999","1.1.1.-1"," 1.1.1.1","1.1.1.1 ","1.1.1.1a","a.b.c.d","00.0.0.0"
+    };
+    std::vector<std::string> texts;
+    for( auto& t : odd ){texts.push_back(t);}
+    for( size_t n = 0 ; n < 100000 ; n++ )
+    {
+        texts.push_back(IPv4ToString(addresses[n]));
+        // And some broken ones made by changing a char.
+        std::string broken = texts.back();
+        broken[random()%broken.size()] = "0123456789./x"[random()%13];
+        texts.push_back(broken);
+    }
+    for( auto& t : texts )
+    {
+        uint32_t expected = 0;
+        const bool expectedOK = inet_pton(AF_INET,t.c_str(),&expected) == 1;
+        uint32_t parsed = 0;
+        assert( ParseIPv4(t,parsed) == expectedOK );
+        assert( expectedOK == false || parsed == expected );
+    }
+    std::cout << "Parsing good, " << texts.size() << " strings checked\n";
+
+    // Bulk versions.
+    std::vector<char> text(count * (IPV4_MAX_CHARS + 1));
+    const size_t textSize = IPv4ToChars(addresses.data(),count,text.data(),'\n');
+    std::vector<std::string_view> lines;
+    for( size_t start = 0, end ; start < textSize ; start = end + 1 )
+    {
+        end = std::string_view(text.data(),textSize).find('\n',start);
+        lines.emplace_back(text.data() + start,end - start);
+    }
+    std::vector<uint32_t> parsed(count);
+    assert( ParseIPv4(lines.data(),lines.size(),parsed.data()) == count );
+    assert( parsed == addresses );
+    std::cout << "Bulk good\n";
+
+    // Timing
+    size_t total = 0;
+    Time("Old IPv4ToString",count,[&](){for( auto a : addresses ){total += OldIPv4ToString(a).size();}});
+    Time("New IPv4ToString",count,[&](){for( auto a : addresses ){total += IPv4ToString(a).size();}});
+    Time("inet_ntop",count,[&](){for( auto a : addresses ){char b[INET_ADDRSTRLEN];total += inet_ntop(AF_INET,&a,b,sizeof(b)) != nullptr;}});
+    Time("IPv4ToChars",count,[&](){for( auto a : addresses ){char b[IPV4_MAX_CHARS];total += IPv4ToChars(a,b) - b;}});
+    Time("IPv4ToChars bulk",count,[&](){total += IPv4ToChars(addresses.data(),count,text.data());});
+
+    std::vector<std::string> strings;
+    for( auto l : lines ){strings.emplace_back(l);}
+    Time("inet_pton",count,[&](){for( auto& s : strings ){uint32_t a;total += inet_pton(AF_INET,s.c_str(),&a);}});
+    Time("ParseIPv4",count,[&](){for( auto l : lines ){uint32_t a;total += ParseIPv4(l,a);}});
+    Time("ParseIPv4 bulk",count,[&](){total += ParseIPv4(lines.data(),lines.size(),parsed.data());});
+
+    std::cout << "All good " << total << "\n";
+    return EXIT_SUCCESS;
+}
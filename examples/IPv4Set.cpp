@@ -0,0 +1,166 @@
+#!/usr/bin/seabang --debug
+
+#include <iostream>
+#include <vector>
+#include <set>
+#include <assert.h>
+
+#include "../TinyTools.h"
+#include "../TinyTools.cpp"
+
+using namespace tinytools::network;
+
+// Host order value to the network order the API takes.
+static uint32_t Net(uint32_t pHost){return htonl(pHost);}
+
+// Checks the set holds exactly the addresses in the reference std::set and that its ranges are sorted and don't touch.
+static void Check(const IPv4Set& pSet,const std::set<uint32_t>& pReference,uint32_t pBase)
+{
+    assert( pSet.GetCount() == pReference.size() );
+    const auto& ranges = pSet.GetRanges();
+    for( size_t n = 1 ; n < ranges.size() ; n++ )
+    {
+        assert( uint64_t(ranges[n-1].mLast) + 1 < ranges[n].mFirst );
+    }
+
+    auto ref = pReference.begin();
+    for( uint32_t address : pSet )
+    {
+        assert( ref != pReference.end() && ntohl(address) == *ref );
+        ref++;
+    }
+    assert( ref == pReference.end() );
+
+    for( uint32_t n = 0 ; n < 600 ; n++ )
+    {
+        assert( pSet.Contains(Net(pBase + n)) == (pReference.count(pBase + n) > 0) );
+    }
+}
+
+// A random range within 512 addresses of pBase.
+static IPv4Range RandomRange(uint32_t pBase)
+{
+    const uint32_t a = pBase + rand()%512;
+    const uint32_t b = a + rand()%(uint32_t)std::min<uint64_t>(40,uint64_t(0xffffffff) - a + 1);
+    return IPv4Range(Net(a),Net(b));
+}
+
+int main(int argc, char *argv[])
+{
+    {// CIDR
+        const IPv4Range r = IPv4Range::FromCIDR("10.0.0.0/12");
+        assert( r == IPv4Range(MakeIP4V(10,0,0,0),MakeIP4V(10,15,255,255)) );
+        assert( r.GetCount() == (1u<<20) );
+        assert( IPv4Range::FromCIDR(MakeIP4V(192,168,1,77),24) == IPv4Range::FromCIDR("192.168.1.0/24") );
+        assert( IPv4Range::FromCIDR("0.0.0.0/0").GetCount() == (uint64_t(1)<<32) );
+        assert( IPv4Range::FromCIDR("1.2.3.4").GetCount() == 1 );
+        assert( IPv4Range::FromCIDR("192.168.1.0/24").Hosts() == IPv4Range(MakeIP4V(192,168,1,1),MakeIP4V(192,168,1,254)) );
+        assert( IPv4Range::FromCIDR("192.168.1.0/31").Hosts().GetCount() == 2 );
+
+        for( const char* bad : {"10.0.0.0/33","10.0.0/8","10.0.0.0/","10.0.0.0/a","bob"} )
+        {
+            bool threw = false;
+            try{IPv4Range::FromCIDR(bad);}catch(std::runtime_error&){threw = true;}
+            assert( threw );
+        }
+
+        // Iterating a range that ends at the top of the address space must stop.
+        uint64_t count = 0;
+        for( uint32_t address : IPv4Range::FromCIDR("255.255.255.0/24") )
+        {
+            assert( (address>>24) == count );
+            count++;
+        }
+        assert( count == 256 );
+        std::cout << "CIDR good\n";
+    }
+
+    // Random adds and removes against a std::set, at the bottom, middle and top of the address space.
+    for( uint32_t base : {0u,0x0a000000u,0xffffffffu - 600} )
+    {
+        for( int pass = 0 ; pass < 200 ; pass++ )
+        {
+            IPv4Set set;
+            std::set<uint32_t> reference;
+            for( int op = 0 ; op < 30 ; op++ )
+            {
+                const IPv4Range range = RandomRange(base);
+                if( rand()%3 )
+                {
+                    set.Add(range);
+                    for( uint64_t a = range.mFirst ; a <= range.mLast ; a++ ){reference.insert((uint32_t)a);}
+                }
+                else
+                {
+                    set.Remove(range);
+                    for( uint64_t a = range.mFirst ; a <= range.mLast ; a++ ){reference.erase((uint32_t)a);}
+                }
+            }
+            Check(set,reference,base);
+
+            // Set union and subtraction.
+            IPv4Set other;
+            std::set<uint32_t> otherReference;
+            for( int op = 0 ; op < 10 ; op++ )
+            {
+                const IPv4Range range = RandomRange(base);
+                other.Add(range);
+                for( uint64_t a = range.mFirst ; a <= range.mLast ; a++ ){otherReference.insert((uint32_t)a);}
+            }
+
+            IPv4Set unionSet = set;
+            unionSet.Add(other);
+            std::set<uint32_t> unionReference = reference;
+            unionReference.insert(otherReference.begin(),otherReference.end());
+            Check(unionSet,unionReference,base);
+
+            IPv4Set subtractSet = set;
+            subtractSet.Remove(other);
+            std::set<uint32_t> subtractReference;
+            for( auto a : reference ){if( otherReference.count(a) == 0 ){subtractReference.insert(a);}}
+            Check(subtractSet,subtractReference,base);
+        }
+    }
+    std::cout << "Add, remove, union and subtract good\n";
+
+    {// 10.0.0.0/12 minus a few subnets, big but only a few ranges.
+        IPv4Set set(IPv4Range::FromCIDR("10.0.0.0/12"));
+        set.Remove(IPv4Range::FromCIDR("10.1.0.0/16"));
+        set.Remove(IPv4Range::FromCIDR("10.2.3.0/24"));
+        assert( set.GetRanges().size() == 3 );
+        assert( set.GetCount() == (1u<<20) - (1u<<16) - 256 );
+        assert( set.Contains(MakeIP4V(10,0,255,255)) );
+        assert( set.Contains(MakeIP4V(10,1,2,3)) == false );
+        assert( set.Contains(MakeIP4V(10,2,3,255)) == false );
+        assert( set.Contains(MakeIP4V(10,2,4,0)) );
+        assert( set.Contains(MakeIP4V(10,16,0,0)) == false );
+
+        uint64_t count = 0;
+        const auto start = std::chrono::steady_clock::now();
+        for( uint32_t address : set )
+        {
+            count += set.Contains(address);
+        }
+        const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+        assert( count == set.GetCount() );
+        std::cout << "Iterated and checked " << count << " addresses in " << ms << "ms\n";
+    }
+
+    {// Scanning a set, loopback has a name in the hosts file.
+        IPv4Set set(IPv4Range::FromCIDR("127.0.0.0/30"));
+        for( size_t inFlight : {1,4} )
+        {
+            bool foundLoopback = false;
+            ScanNetworkIPv4(set,inFlight,[&foundLoopback](const uint32_t pIPv4,const char* pHostName)
+            {
+                foundLoopback |= pIPv4 == MakeIP4V(127,0,0,1);
+                return true;
+            });
+            assert( foundLoopback );
+        }
+        std::cout << "Scan good\n";
+    }
+
+    std::cout << "All good\n";
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,54 @@
+#!/usr/bin/seabang --debug
+
+#include <iostream>
+#include <assert.h>
+
+#include "../TinyTools.h"
+#include "../TinyTools.cpp"
+
+using namespace tinytools::network;
+
+// Lists the interfaces and checks the cached local address agrees with GetLocalIP.
+int main(int argc, char *argv[])
+{
+    InterfaceMonitor& monitor = GetInterfaceMonitor();
+    const auto interfaces = monitor.GetInterfaces();
+
+    bool foundLoopback = false;
+    for( const auto& interface : *interfaces )
+    {
+        std::cout << interface.mIndex << ": " << interface.mName << (interface.IsUp() ? " up" : " down") << (interface.IsLoopback() ? " loopback" : "") << "\n";
+        for( const auto& address : interface.mAddresses )
+        {
+            std::cout << "    " << address.ToString() << "/" << address.mPrefixLength;
+            if( address.mIPv4Broadcast != 0 )
+            {
+                std::cout << " broadcast " << IPv4ToString(address.mIPv4Broadcast);
+            }
+            std::cout << "\n";
+            foundLoopback |= interface.IsLoopback() && address.mFamily == AF_INET && address.mIPv4 == MakeIP4V(127,0,0,1);
+        }
+    }
+    assert( foundLoopback );
+
+    std::cout << "Local IPv4 " << IPv4ToString(GetLocalIPv4()) << " GetLocalIP says " << GetLocalIP() << "\n";
+
+    // Once made, asking again is only an atomic load.
+    const int count = 10000000;
+    uint64_t total = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for( int n = 0 ; n < count ; n++ )
+    {
+        total += GetLocalIPv4();
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "GetLocalIPv4 " << (seconds * 1e9 / count) << "ns per call " << (total != 0) << "\n";
+
+    // A monitor that does not watch still has the same table.
+    InterfaceMonitor snapshot(false);
+    assert( snapshot.GetInterfaces()->size() == interfaces->size() );
+    assert( snapshot.GetIPv4() == monitor.GetIPv4() );
+
+    std::cout << "All good\n";
+    return EXIT_SUCCESS;
+}
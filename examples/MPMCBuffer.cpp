@@ -0,0 +1,137 @@
+#!/usr/bin/seabang --debug
+
+#include <iostream>
+#include <thread>
+#include <deque>
+#include <assert.h>
+
+#include "../TinyTools.h"
+#include "../TinyTools.cpp"
+
+using namespace tinytools::threading;
+
+struct Item
+{
+    uint32_t mProducer;
+    uint32_t mSequence;
+};
+
+// What we had before, a deque with a mutex round it. Same calls as LocklessMPMCBuffer so the test can use either.
+class MutexQueue
+{
+public:
+    MutexQueue(size_t pItemSizeof,size_t pItemCount):mMaxItems(pItemCount){}
+
+    bool WriteNext(const void* pItem,size_t pBufferSize)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if( mItems.size() == mMaxItems )
+            return false;
+        mItems.push_back(*(const Item*)pItem);
+        return true;
+    }
+
+    bool ReadNext(void* rItem,size_t pBufferSize)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if( mItems.empty() )
+            return false;
+        *(Item*)rItem = mItems.front();
+        mItems.pop_front();
+        return true;
+    }
+
+private:
+    const size_t mMaxItems;
+    std::mutex mMutex;
+    std::deque<Item> mItems;
+};
+
+// pThreads writers and pThreads readers. Each reader checks it sees each writers items in order, and between them all see every item once.
+template<typename QUEUE> double RunTest(int pThreads,uint32_t pItemsPerWriter)
+{
+    QUEUE queue(sizeof(Item),1024);
+    std::atomic<uint64_t> total{0};
+    std::atomic<uint64_t> read{0};
+    const uint64_t expected = uint64_t(pThreads) * pItemsPerWriter;
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for( int t = 0 ; t < pThreads ; t++ )
+    {
+        threads.emplace_back([&queue,t,pItemsPerWriter]()
+        {
+            for( uint32_t n = 0 ; n < pItemsPerWriter ; n++ )
+            {
+                const Item item = {uint32_t(t),n};
+                while( queue.WriteNext(&item,sizeof(item)) == false )
+                {
+                    std::this_thread::yield();
+                }
+            }
+        });
+
+        threads.emplace_back([&queue,&total,&read,pThreads,expected]()
+        {
+            std::vector<int64_t> last(pThreads,-1);
+            uint64_t sum = 0;
+            uint64_t count = 0;
+            while( read.load(std::memory_order_relaxed) < expected )
+            {
+                Item item;
+                if( queue.ReadNext(&item,sizeof(item)) == false )
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+                assert( int64_t(item.mSequence) > last[item.mProducer] );
+                last[item.mProducer] = item.mSequence;
+                sum += item.mSequence;
+                count++;
+                read++;
+            }
+            total += sum;
+        });
+    }
+    for( auto& t : threads ){t.join();}
+
+    assert( read == expected );
+    assert( total == uint64_t(pThreads) * (uint64_t(pItemsPerWriter) * (pItemsPerWriter - 1) / 2) );
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char *argv[])
+{
+    LocklessMPMCBuffer small(sizeof(Item),3);
+    assert( small.GetItemCount() == 4 );
+    Item item = {0,0};
+    for( uint32_t n = 0 ; n < 4 ; n++ ){item.mSequence = n;assert( small.WriteNext(&item,sizeof(item)) );}
+    assert( small.WriteNext(&item,sizeof(item)) == false );// Full
+    for( uint32_t n = 0 ; n < 4 ; n++ ){assert( small.ReadNext(&item,sizeof(item)) && item.mSequence == n );}
+    assert( small.ReadNext(&item,sizeof(item)) == false );// Empty
+    assert( small.Empty() );
+
+    // Zero or one still gives two cells, one cell would let a second write overwrite the unread item.
+    for( size_t count = 0 ; count < 2 ; count++ )
+    {
+        LocklessMPMCBuffer tiny(sizeof(Item),count);
+        assert( tiny.GetItemCount() == 2 );
+        for( uint32_t n = 0 ; n < 2 ; n++ ){item.mSequence = n;assert( tiny.WriteNext(&item,sizeof(item)) );}
+        assert( tiny.WriteNext(&item,sizeof(item)) == false );// Full
+        for( uint32_t n = 0 ; n < 2 ; n++ ){assert( tiny.ReadNext(&item,sizeof(item)) && item.mSequence == n );}
+        assert( tiny.ReadNext(&item,sizeof(item)) == false );// Empty
+    }
+
+    const int maxThreads = std::max(4u,std::thread::hardware_concurrency());
+    const uint32_t itemsPerWriter = 200000;
+    for( int threads = 1 ; threads <= maxThreads ; threads *= 2 )
+    {
+        const double mutex = RunTest<MutexQueue>(threads,itemsPerWriter);
+        const double lockless = RunTest<LocklessMPMCBuffer>(threads,itemsPerWriter);
+        const double count = double(threads) * itemsPerWriter;
+        std::cout << threads << " writers, " << threads << " readers: mutex " << (count / mutex / 1e6) << " million a second, lockless " << (count / lockless / 1e6) << " million a second\n";
+    }
+
+    std::cout << "All good\n";
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,68 @@
+#!/usr/bin/seabang --debug
+
+#include <iostream>
+#include <set>
+#include <assert.h>
+
+#include "../TinyTools.h"
+#include "../TinyTools.cpp"
+
+using namespace tinytools::network;
+
+// Finds the hosts on each local network from the kernels neighbour table, probing them first.
+int main(int argc, char *argv[])
+{
+    const auto start = std::chrono::steady_clock::now();
+    const auto neighbours = ReadNeighbourTable();
+    const auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Read " << neighbours.size() << " neighbours in " << us << "us\n";
+
+    // The netlink table and /proc/net/arp should agree on what is alive. Only if nothing changes in between, so just a warning.
+    std::set<uint32_t> fromNetlink,fromProc;
+    for( const auto& n : neighbours ){if( n.IsAlive() ){fromNetlink.insert(n.mIPv4);}}
+    std::ifstream arp("/proc/net/arp");
+    std::string line;
+    std::getline(arp,line);
+    while( arp >> line )
+    {
+        uint32_t IPv4;
+        if( ParseIPv4(line,IPv4) )
+        {
+            std::string type,flags;
+            arp >> type >> flags;
+            if( strtoul(flags.c_str(),nullptr,16) & ATF_COM ){fromProc.insert(IPv4);}
+        }
+        std::getline(arp,line);
+    }
+    if( fromNetlink != fromProc )
+    {
+        std::cout << "Warning, netlink and /proc/net/arp disagree. The table may have changed between reads.\n";
+    }
+
+    // Scan every IPv4 network we're on, the smaller ones anyway.
+    const auto interfaces = GetInterfaceMonitor().GetInterfaces();
+    for( const auto& interface : *interfaces )
+    {
+        for( const auto& address : interface.mAddresses )
+        {
+            if( interface.IsUp() && interface.IsLoopback() == false && address.mFamily == AF_INET && address.mPrefixLength >= 22 )
+            {
+                const IPv4Range network = IPv4Range::FromCIDR(address.mIPv4,address.mPrefixLength).Hosts();
+                std::cout << interface.mName << " " << IPv4ToString(*network.begin()) << " to " << IPv4ToString(htonl(network.mLast)) << "\n";
+
+                int found = 0;
+                ScanNeighboursIPv4(network,250,true,[&found,network](const uint32_t pIPv4,const char* pHostName)
+                {
+                    assert( network.Contains(pIPv4) );
+                    std::cout << "    " << IPv4ToString(pIPv4) << " " << pHostName << "\n";
+                    found++;
+                    return true;
+                });
+                std::cout << "    " << found << " found\n";
+            }
+        }
+    }
+
+    std::cout << "All good\n";
+    return EXIT_SUCCESS;
+}
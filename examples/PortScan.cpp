@@ -0,0 +1,109 @@
+#!/usr/bin/seabang --debug
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <assert.h>
+
+#include "../TinyTools.h"
+#include "../TinyTools.cpp"
+
+using namespace tinytools::network;
+
+// Binds to an ephemeral port on loopback and returns the socket and port, listens if asked to.
+static int OpenLoopbackPort(bool pListen,uint16_t& rPort)
+{
+    const int s = socket(AF_INET,SOCK_STREAM,0);
+    assert( s >= 0 );
+    sockaddr_in address;
+    memset(&address,0,sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    assert( bind(s,(sockaddr*)&address,sizeof(address)) == 0 );
+    if( pListen )
+    {
+        assert( listen(s,16) == 0 );
+    }
+    socklen_t size = sizeof(address);
+    assert( getsockname(s,(sockaddr*)&address,&size) == 0 );
+    rPort = ntohs(address.sin_port);
+    return s;
+}
+
+// Opens some ports on loopback, finds some closed ones and checks ScanPorts tells them apart.
+int main(int argc, char *argv[])
+{
+    const uint32_t loopback = htonl(INADDR_LOOPBACK);
+
+    std::vector<int> listening;
+    std::map<uint16_t,bool> expected;
+    for( int n = 0 ; n < 8 ; n++ )
+    {
+        uint16_t port;
+        listening.push_back(OpenLoopbackPort(true,port));
+        expected[port] = true;
+    }
+
+    // Bound but not listening, connects get refused.
+    std::vector<int> closed;
+    for( int n = 0 ; n < 24 ; n++ )
+    {
+        uint16_t port;
+        closed.push_back(OpenLoopbackPort(false,port));
+        expected[port] = false;
+    }
+
+    std::vector<PortProbe> probes;
+    for( auto p : expected )
+    {
+        probes.push_back({loopback,p.first});
+    }
+
+    for( size_t maxInFlight : {1,3,64} )
+    {
+        std::map<uint16_t,bool> found;
+        ScanPorts(probes,500,maxInFlight,[&found](const PortProbe& pProbe,bool pOpen)
+        {
+            assert( found.count(pProbe.mPort) == 0 );
+            found[pProbe.mPort] = pOpen;
+            return true;
+        });
+        assert( found == expected );
+        std::cout << "Max in flight " << maxInFlight << " found all " << found.size() << " ports correctly\n";
+    }
+
+    // Returning false stops the scan.
+    int calls = 0;
+    ScanPorts(probes,500,4,[&calls](const PortProbe& pProbe,bool pOpen)
+    {
+        calls++;
+        return calls < 5;
+    });
+    assert( calls == 5 );
+    std::cout << "Scan stopped early after " << calls << " results\n";
+
+    // A throw from the callback comes out of the scan with the sockets and epoll closed, the lowest free fd is the same after as before.
+    const int freeFD = dup(0);
+    close(freeFD);
+    bool caught = false;
+    try
+    {
+        ScanPorts(probes,500,16,[](const PortProbe& pProbe,bool pOpen)->bool
+        {
+            throw std::runtime_error("Stop");
+        });
+    }
+    catch( std::runtime_error& )
+    {
+        caught = true;
+    }
+    const int freeFDAfter = dup(0);
+    close(freeFDAfter);
+    assert( caught && freeFDAfter == freeFD );
+
+    for( int s : listening ){close(s);}
+    for( int s : closed ){close(s);}
+
+    std::cout << "All good\n";
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,93 @@
+#!/usr/bin/seabang --debug
+
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <assert.h>
+
+#include "../TinyTools.h"
+#include "../TinyTools.cpp"
+
+using namespace tinytools::network;
+
+// Looks up loopback names and addresses through ResolverCache, these come from the hosts file so work with no network.
+int main(int argc, char *argv[])
+{
+    const uint32_t loopback = MakeIP4V(127,0,0,1);
+    const std::string loopbackName = GetNameFromIPv4(loopback);
+
+    {// Hits, misses and expiry.
+        ResolverCache cache(std::chrono::milliseconds(200),std::chrono::milliseconds(100),4);
+
+        assert( cache.GetIPv4FromName("localhost") == loopback );
+        assert( cache.GetIPv4FromName("localhost") == loopback );
+        assert( cache.GetMisses() == 1 && cache.GetHits() == 1 );
+
+        assert( cache.GetNameFromIPv4(loopback) == loopbackName );
+        assert( cache.GetNameFromIPv4(loopback) == loopbackName );
+        assert( cache.GetMisses() == 2 && cache.GetHits() == 2 );
+
+        // Not found is cached too.
+        assert( cache.GetIPv4FromName("no.such.host.invalid") == 0 );
+        assert( cache.GetIPv4FromName("no.such.host.invalid") == 0 );
+        assert( cache.GetMisses() == 3 && cache.GetHits() == 3 );
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(250));
+        assert( cache.GetIPv4FromName("localhost") == loopback );
+        assert( cache.GetMisses() == 4 );
+        std::cout << "Hits, misses and TTL good\n";
+
+        // Size limit, least recently used goes first.
+        for( uint8_t n = 1 ; n <= 10 ; n++ )
+        {
+            cache.GetNameFromIPv4(MakeIP4V(127,0,0,n));
+        }
+        assert( cache.GetSize() <= 4 + 2 );
+        const uint64_t misses = cache.GetMisses();
+        cache.GetNameFromIPv4(MakeIP4V(127,0,0,10));
+        assert( cache.GetMisses() == misses );
+        cache.GetNameFromIPv4(MakeIP4V(127,0,0,1));
+        assert( cache.GetMisses() == misses + 1 );
+        std::cout << "Size limit good\n";
+
+        cache.Clear();
+        assert( cache.GetSize() == 0 );
+    }
+
+    {// Background refresh, after the first lookup nothing waits for the resolver.
+        ResolverCache cache(std::chrono::milliseconds(50),std::chrono::milliseconds(50),16,true);
+        assert( cache.GetIPv4FromName("localhost") == loopback );
+        for( int n = 0 ; n < 10 ; n++ )
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(30));
+            assert( cache.GetIPv4FromName("localhost") == loopback );
+            assert( cache.GetNameFromIPv4(loopback) == loopbackName );
+        }
+        assert( cache.GetMisses() == 2 );
+        std::cout << "Background refresh good, " << cache.GetHits() << " hits\n";
+    }
+
+    {// Lots of threads at once.
+        ResolverCache cache(std::chrono::milliseconds(20),std::chrono::milliseconds(20),8,true);
+        std::vector<std::thread> threads;
+        for( int t = 0 ; t < 8 ; t++ )
+        {
+            threads.emplace_back([&cache,t,loopback]()
+            {
+                for( int n = 0 ; n < 2000 ; n++ )
+                {
+                    cache.GetNameFromIPv4(MakeIP4V(127,0,0,(uint8_t)(1 + (n + t) % 12)));
+                    assert( cache.GetIPv4FromName("localhost") == loopback );
+                }
+            });
+        }
+        for( auto& t : threads )
+        {
+            t.join();
+        }
+        std::cout << "Threaded, " << cache.GetHits() << " hits " << cache.GetMisses() << " misses\n";
+    }
+
+    std::cout << "All good\n";
+    return EXIT_SUCCESS;
+}
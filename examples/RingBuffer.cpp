@@ -0,0 +1,158 @@
+#!/usr/bin/seabang --debug
+
+#include <iostream>
+#include <thread>
+#include <assert.h>
+
+#include "../TinyTools.h"
+#include "../TinyTools.cpp"
+
+using namespace tinytools::threading;
+
+struct Item
+{
+    uint64_t mSequence;
+    uint64_t mCheck;
+};
+
+// Pin to a core so the numbers don't jump about as the scheduler moves us.
+static void PinToCPU(std::thread::native_handle_type pThread,int pCPU)
+{
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(pCPU % std::thread::hardware_concurrency(),&cpus);
+    pthread_setaffinity_np(pThread,sizeof(cpus),&cpus);
+}
+
+// One thread writes numbered items, another reads them and checks none are lost, repeated or out of order.
+// pBatchSize of zero uses ReadNext and WriteNext. Returns the seconds taken.
+static double RunTest(uint64_t pCount,size_t pBatchSize)
+{
+    LocklessRingBuffer buffer(sizeof(Item),1024);
+
+    PinToCPU(pthread_self(),0);
+    const auto start = std::chrono::steady_clock::now();
+    std::thread writer([&buffer,pCount,pBatchSize]()
+    {
+        if( pBatchSize == 0 )
+        {
+            for( uint64_t n = 0 ; n < pCount ; n++ )
+            {
+                const Item item = {n,n * 0x9e3779b97f4a7c15ULL};
+                while( buffer.WriteNext(&item,sizeof(item)) == false )
+                {
+                    std::this_thread::yield();
+                }
+            }
+            return;
+        }
+
+        std::vector<Item> items(pBatchSize);
+        for( uint64_t n = 0 ; n < pCount ; )
+        {
+            const size_t numItems = std::min<uint64_t>(pBatchSize,pCount - n);
+            for( size_t i = 0 ; i < numItems ; i++ )
+            {
+                items[i] = {n + i,(n + i) * 0x9e3779b97f4a7c15ULL};
+            }
+
+            for( size_t written = 0 ; written < numItems ; )
+            {
+                const size_t w = buffer.WriteBatch(items.data() + written,numItems - written);
+                if( w == 0 )
+                    std::this_thread::yield();
+                written += w;
+            }
+            n += numItems;
+        }
+    });
+    PinToCPU(writer.native_handle(),1);
+
+    std::vector<Item> items(pBatchSize ? pBatchSize : 1);
+    for( uint64_t n = 0 ; n < pCount ; )
+    {
+        size_t numItems;
+        if( pBatchSize == 0 )
+            numItems = buffer.ReadNext(items.data(),sizeof(Item)) ? 1 : 0;
+        else
+            numItems = buffer.ReadBatch(items.data(),pBatchSize);
+
+        if( numItems == 0 )
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        for( size_t i = 0 ; i < numItems ; i++, n++ )
+        {
+            assert( items[i].mSequence == n && items[i].mCheck == n * 0x9e3779b97f4a7c15ULL );
+        }
+    }
+    writer.join();
+    assert( buffer.Empty() );
+
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char *argv[])
+{
+    static_assert( alignof(LocklessRingBuffer) == 64 );
+
+    LocklessRingBuffer small(sizeof(Item),5);
+    assert( small.GetItemCount() == 8 );
+    Item item = {0,0};
+    for( int n = 0 ; n < 8 ; n++ ){assert( small.WriteNext(&item,sizeof(item)) );}
+    assert( small.WriteNext(&item,sizeof(item)) == false );// Full
+    for( int n = 0 ; n < 8 ; n++ ){assert( small.ReadNext(&item,sizeof(item)) );}
+    assert( small.ReadNext(&item,sizeof(item)) == false );// Empty
+    assert( small.Empty() );
+
+    // Batches that wrap round the end of the buffer.
+    Item items[8];
+    for( int n = 0 ; n < 6 ; n++ ){items[n] = {uint64_t(n),0};}
+    assert( small.WriteBatch(items,6) == 6 );
+    assert( small.ReadBatch(items,5) == 5 );
+    for( int n = 0 ; n < 8 ; n++ ){items[n] = {uint64_t(n + 6),0};}
+    assert( small.WriteBatch(items,8) == 7 );// Only room for 7, split over the end.
+    assert( small.ReadBatch(items,8) == 8 );
+    for( int n = 0 ; n < 8 ; n++ ){assert( items[n].mSequence == uint64_t(n + 5) );}
+    assert( small.ReadBatch(items,8) == 0 && small.Empty() );
+
+    // Blocking calls time out when nothing happens.
+    auto waitStart = std::chrono::steady_clock::now();
+    assert( small.ReadWait(&item,sizeof(item),20) == false );
+    assert( std::chrono::steady_clock::now() - waitStart >= std::chrono::milliseconds(20) );
+    for( int n = 0 ; n < 8 ; n++ ){assert( small.WriteNext(&item,sizeof(item)) );}
+    waitStart = std::chrono::steady_clock::now();
+    assert( small.WriteWait(&item,sizeof(item),20) == false );
+    assert( std::chrono::steady_clock::now() - waitStart >= std::chrono::milliseconds(20) );
+    assert( small.ReadBatch(items,8) == 8 );
+
+    // And wake up when the other side does something, with the writer going slow now and then so the reader has to sleep.
+    std::thread slowWriter([&small]()
+    {
+        for( uint64_t n = 0 ; n < 1000 ; n++ )
+        {
+            const Item item = {n,0};
+            assert( small.WriteWait(&item,sizeof(item)) );
+            if( n % 100 == 0 )
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+    });
+    for( uint64_t n = 0 ; n < 1000 ; n++ )
+    {
+        assert( small.ReadWait(&item,sizeof(item),1000) && item.mSequence == n );
+        if( n % 250 == 0 )// Now the writer waits on us.
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    slowWriter.join();
+    assert( small.Empty() );
+
+    const uint64_t count = 20000000;
+    const double single = RunTest(count,0);
+    const double batched = RunTest(count,64);
+    std::cout << "Single items " << (count / single / 1e6) << " million a second, batches of 64 " << (count / batched / 1e6) << " million a second\n";
+
+    std::cout << "All good\n";
+    return EXIT_SUCCESS;
+}
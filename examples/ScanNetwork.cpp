@@ -0,0 +1,77 @@
+#!/usr/bin/seabang --debug
+
+#include <iostream>
+#include <set>
+#include <assert.h>
+
+#include "../TinyTools.h"
+#include "../TinyTools.cpp"
+
+using namespace tinytools::network;
+
+int main(int argc, char *argv[])
+{
+    // Loopback has a name in the hosts file, the rest of 127.0.0.x usually does not.
+    const uint32_t from = MakeIP4V(127,0,0,1);
+    const uint32_t to = MakeIP4V(127,0,0,16);
+
+    std::set<uint32_t> oneAtATime;
+    ScanNetworkIPv4(from,to,[&oneAtATime](const uint32_t pIPv4,const char* pHostName)
+    {
+        oneAtATime.insert(pIPv4);
+        return true;
+    });
+    assert( oneAtATime.count(MakeIP4V(127,0,0,1)) == 1 );
+
+    // Same answers with the lookups in flight together, just maybe in a different order.
+    for( size_t inFlight : {2,4,32} )
+    {
+        std::set<uint32_t> together;
+        ScanNetworkIPv4(from,to,inFlight,[&together](const uint32_t pIPv4,const char* pHostName)
+        {
+            assert( ntohl(pIPv4) >= ntohl(from) && ntohl(pIPv4) <= ntohl(to) );
+            together.insert(pIPv4);
+            return true;
+        });
+        assert( together == oneAtATime );
+    }
+    std::cout << "Found " << oneAtATime.size() << " named devices from 127.0.0.1 to 127.0.0.16\n";
+
+    // Returning false stops the scan.
+    int calls = 0;
+    ScanNetworkIPv4(from,to,4,[&calls](const uint32_t pIPv4,const char* pHostName)
+    {
+        calls++;
+        return false;
+    });
+    assert( calls == 1 );
+
+    // A throw from the callback comes out of the scan, the workers are joined first.
+    bool caught = false;
+    try
+    {
+        ScanNetworkIPv4(from,to,4,[](const uint32_t pIPv4,const char* pHostName)->bool
+        {
+            throw std::runtime_error("Stop");
+        });
+    }
+    catch( std::runtime_error& )
+    {
+        caught = true;
+    }
+    assert( caught );
+
+    // Across subnets, 127.0.1.x and 127.0.2.x, the .0 and .255 addresses are skipped like the single threaded version.
+    std::set<uint32_t> across;
+    ScanNetworkIPv4(MakeIP4V(127,0,1,250),MakeIP4V(127,0,2,4),8,[&across](const uint32_t pIPv4,const char* pHostName)
+    {
+        const uint32_t d = ntohl(pIPv4) & 0xff;
+        assert( d >= 1 && d <= 254 );
+        across.insert(pIPv4);
+        return true;
+    });
+    std::cout << "Found " << across.size() << " named devices across two subnets\n";
+
+    std::cout << "All good\n";
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,145 @@
+#!/usr/bin/seabang --debug
+
+#include <iostream>
+#include <vector>
+#include <assert.h>
+
+#include "../TinyTools.h"
+#include "../TinyTools.cpp"
+
+using namespace tinytools::network;
+
+// Sends frames both ways over a pty pair, the master side stands in for the microcontroller.
+int main(int argc, char *argv[])
+{
+    const int master = posix_openpt(O_RDWR|O_NOCTTY);
+    assert( master >= 0 );
+    assert( grantpt(master) == 0 && unlockpt(master) == 0 );
+    const std::string slaveName = ptsname(master);
+
+    SerialPort device(master,115200);
+    SerialPort port(slaveName,115200);
+    std::cout << "pty " << slaveName << "\n";
+
+    // Lots of small packets, queued and then sent with as few writes as the pty will take.
+    const int numFrames = 20000;
+    std::vector<std::vector<uint8_t>> messages;
+    for( int n = 0 ; n < numFrames ; n++ )
+    {
+        std::vector<uint8_t> message(1 + rand()%60);
+        for( auto& b : message ){b = rand()&255;}
+        messages.push_back(message);
+    }
+
+    for( auto& m : messages )
+    {
+        port.WriteFrame(m.data(),m.size());
+    }
+    std::cout << "Queued " << port.GetQueuedBytes() << " bytes\n";
+
+    // Both ends are non blocking so the one thread can push and pull.
+    int received = 0;
+    int writes = 0;
+    const auto start = std::chrono::steady_clock::now();
+    while( received < numFrames && std::chrono::steady_clock::now() - start < std::chrono::seconds(10) )
+    {
+        if( port.GetQueuedBytes() > 0 )
+        {
+            port.Flush();
+            writes++;
+        }
+
+        device.WaitForData(10);
+        assert( device.Fill() >= 0 );
+        device.ReadFrames([&](const uint8_t* p7Bit,size_t p7BitSize)
+        {
+            std::vector<uint8_t> decoded;
+            Decode7Bit(p7Bit,p7BitSize,decoded);
+            assert( decoded == messages[received] );
+            received++;
+            return true;
+        });
+    }
+    assert( received == numFrames );
+    std::cout << "Received " << received << " frames with " << writes << " flushes\n";
+
+    // And back the other way, raw bytes this time with a blocking read using VMIN.
+    port.SetReadTiming(16,5);
+    const uint8_t reply[16] = {1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16};
+    device.Write(reply,sizeof(reply));
+    assert( device.Flush() );
+    while( port.GetAvailable() < sizeof(reply) )
+    {
+        assert( port.Fill() > 0 );
+    }
+    uint8_t got[16];
+    assert( port.Read(got,sizeof(got)) == sizeof(got) );
+    assert( memcmp(got,reply,sizeof(reply)) == 0 );
+
+    // VTIME stops a short packet waiting for all of VMIN.
+    device.Write(reply,4);
+    assert( device.Flush() );
+    const auto shortStart = std::chrono::steady_clock::now();
+    size_t shortGot = 0;
+    while( shortGot < 4 )
+    {
+        shortGot += port.Fill();
+    }
+    std::cout << "Short packet took " << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - shortStart).count() << "ms\n";
+    assert( port.Read(got,sizeof(got)) == 4 );
+
+    // The ring buffer wraps.
+    port.SetReadTiming(0,0);
+    std::vector<uint8_t> stream(200000);
+    for( size_t n = 0 ; n < stream.size() ; n++ ){stream[n] = (uint8_t)(n * 7);}
+    device.Write(stream.data(),stream.size());
+    std::vector<uint8_t> back;
+    while( back.size() < stream.size() )
+    {
+        device.Flush();
+        port.WaitForData(10);
+        port.Fill();
+        uint8_t buffer[1000];
+        const size_t n = port.Read(buffer,sizeof(buffer));
+        back.insert(back.end(),buffer,buffer + n);
+    }
+    assert( back == stream );
+    std::cout << "Streamed " << back.size() << " bytes through the ring buffer\n";
+
+    {// A frame that never ends is dropped at pMaxFrameSize, then the next good frame comes through.
+        const int smallMaster = posix_openpt(O_RDWR|O_NOCTTY);
+        assert( smallMaster >= 0 && grantpt(smallMaster) == 0 && unlockpt(smallMaster) == 0 );
+        SerialPort small(smallMaster,115200,256,64);
+        SerialPort sender(std::string(ptsname(smallMaster)),115200);
+
+        std::vector<uint8_t> endless(1,FRAME_START);
+        endless.resize(2000,1);
+        sender.Write(endless.data(),endless.size());
+        const uint8_t end = FRAME_END;
+        sender.Write(&end,1);
+        const uint8_t message[] = {9,8,7};
+        sender.WriteFrame(message,sizeof(message));
+
+        int frames = 0;
+        const auto smallStart = std::chrono::steady_clock::now();
+        while( frames == 0 && std::chrono::steady_clock::now() - smallStart < std::chrono::seconds(5) )
+        {
+            sender.Flush();
+            small.WaitForData(10);
+            small.Fill();
+            small.ReadFrames([&](const uint8_t* p7Bit,size_t p7BitSize)
+            {
+                std::vector<uint8_t> decoded;
+                Decode7Bit(p7Bit,p7BitSize,decoded);
+                assert( decoded == std::vector<uint8_t>(message,message + sizeof(message)) );
+                frames++;
+                return true;
+            });
+        }
+        assert( frames == 1 );
+        std::cout << "Oversized frame dropped\n";
+    }
+
+    std::cout << "All good\n";
+    return EXIT_SUCCESS;
+}
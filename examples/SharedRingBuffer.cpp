@@ -0,0 +1,178 @@
+#!/usr/bin/seabang --debug
+
+#include <iostream>
+#include <thread>
+#include <poll.h>
+#include <sys/wait.h>
+#include <assert.h>
+
+#include "../TinyTools.h"
+#include "../TinyTools.cpp"
+
+using namespace tinytools::threading;
+
+struct Record
+{
+    uint64_t mSequence;
+    uint64_t mCheck;
+    char mText[48];
+};
+
+static const uint64_t COUNT = 1000000;
+
+// The consumer, in its own process. Waits on the eventfd and reads records where they are with Peek.
+static int Consumer(const std::string& pName)
+{
+    SharedRingBuffer buffer(pName);
+    if( buffer.IsProducer() || buffer.GetItemSizeof() != sizeof(Record) || buffer.GetEventFD() < 0 )
+        return 1;
+
+    uint64_t next = 0;
+    while( next < COUNT )
+    {
+        const Record* record;
+        while( (record = (const Record*)buffer.Peek()) != nullptr )
+        {
+            if( record->mSequence != next || record->mCheck != next * 0x9e3779b97f4a7c15ULL || strcmp(record->mText,"record") != 0 )
+                return 2;
+            buffer.Release();
+            next++;
+        }
+
+        struct pollfd wait = {buffer.GetEventFD(),POLLIN,0};
+        if( next < COUNT && poll(&wait,1,5000) != 1 )
+            return 3;// Should have been woken.
+    }
+
+    // Producer closes when it's done, we should see that and not a crash.
+    Record record;
+    if( buffer.ReadWait(&record,sizeof(record),5000) || buffer.GetProducerState() != SharedRingBuffer::PRODUCER_CLOSED )
+        return 4;
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    const std::string name = "tinytools_example_" + std::to_string(getpid());
+
+    try
+    {
+        SharedRingBuffer("tinytools_example_not_there");
+        assert( false );
+    }
+    catch(const std::exception& e){}
+
+    {// A name in use by a running producer is not taken over, and misuse throws rather than corrupting the counts.
+        SharedRingBuffer buffer(name,sizeof(Record),4);
+        bool threw = false;
+        try{SharedRingBuffer second(name,sizeof(Record),4);}
+        catch(const std::exception& e){threw = true;}
+        assert( threw );
+
+        threw = false;
+        try{buffer.Commit();}
+        catch(const std::exception& e){threw = true;}
+        assert( threw && buffer.Empty() );
+
+        SharedRingBuffer consumer(name);
+        threw = false;
+        try{consumer.Release();}
+        catch(const std::exception& e){threw = true;}
+        assert( threw );
+
+        buffer.Detach();
+        threw = false;
+        try{buffer.Reserve();}
+        catch(const std::exception& e){threw = true;}
+        assert( threw );
+    }
+
+    {// Producer here, consumer in a child process that attaches by name.
+        auto buffer = std::make_unique<SharedRingBuffer>(name,sizeof(Record),256,true);
+        assert( buffer->IsProducer() && buffer->GetItemCount() == 256 );
+
+        const pid_t child = fork();
+        if( child == 0 )
+        {
+            _exit(Consumer(name));
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        for( uint64_t n = 0 ; n < COUNT ; n++ )
+        {
+            if( n % 2 )
+            {// Build it in place.
+                Record* record;
+                while( (record = (Record*)buffer->Reserve()) == nullptr )
+                {
+                    std::this_thread::yield();
+                }
+                record->mSequence = n;
+                record->mCheck = n * 0x9e3779b97f4a7c15ULL;
+                strcpy(record->mText,"record");
+                buffer->Commit();
+            }
+            else
+            {
+                Record record = {n,n * 0x9e3779b97f4a7c15ULL,"record"};
+                assert( buffer->WriteWait(&record,sizeof(record),5000) );
+            }
+        }
+        buffer.reset();// Detach, the consumer reads what's left.
+
+        int status;
+        assert( waitpid(child,&status,0) == child );
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Consumer exit code " << WEXITSTATUS(status) << ", " << COUNT << " records between processes in " << seconds << "s, " << (COUNT / seconds / 1e6) << " million a second\n";
+        assert( WIFEXITED(status) && WEXITSTATUS(status) == 0 );
+    }
+
+    {// Producer in a child that dies without closing.
+        const pid_t child = fork();
+        if( child == 0 )
+        {
+            SharedRingBuffer buffer(name,sizeof(Record),16);
+            for( uint64_t n = 0 ; n < 10 ; n++ )
+            {
+                Record record = {n,0,"crash"};
+                buffer.WriteNext(&record,sizeof(record));
+            }
+            kill(getpid(),SIGKILL);
+        }
+
+        std::unique_ptr<SharedRingBuffer> buffer;
+        while( buffer == nullptr )
+        {
+            try
+            {
+                buffer = std::make_unique<SharedRingBuffer>(name);
+            }
+            catch(const std::exception& e)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+
+        // Everything it committed is still there.
+        Record record;
+        for( uint64_t n = 0 ; n < 10 ; n++ )
+        {
+            assert( buffer->ReadWait(&record,sizeof(record),5000) && record.mSequence == n );
+        }
+
+        // Then we find out it's gone, rather than waiting for ever.
+        assert( buffer->ReadWait(&record,sizeof(record)) == false );
+        assert( buffer->GetProducerState() == SharedRingBuffer::PRODUCER_CRASHED );
+
+        int status;
+        assert( waitpid(child,&status,0) == child && WIFSIGNALED(status) );
+
+        // It never got to clean up, a new producer can take the name over.
+        SharedRingBuffer replacement(name,sizeof(Record),16);
+        assert( replacement.Empty() );
+    }
+
+    std::cout << "All good\n";
+    return EXIT_SUCCESS;
+}
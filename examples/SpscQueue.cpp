@@ -0,0 +1,96 @@
+#!/usr/bin/seabang --debug
+
+#include <iostream>
+#include <thread>
+#include <assert.h>
+
+#include "../TinyTools.h"
+#include "../TinyTools.cpp"
+
+using namespace tinytools::threading;
+
+// Counts how many are alive so we can see the queue destroys what it makes.
+struct Counted
+{
+    static int sAlive;
+    std::string mText;
+    Counted(const std::string& pText = ""):mText(pText){sAlive++;}
+    Counted(Counted&& pOther):mText(std::move(pOther.mText)){sAlive++;}
+    Counted& operator=(Counted&& pOther){mText = std::move(pOther.mText);return *this;}
+    ~Counted(){sAlive--;}
+};
+int Counted::sAlive = 0;
+
+struct Frame
+{
+    uint64_t mSequence;
+    uint8_t mData[4096];
+};
+
+int main(int argc, char *argv[])
+{
+    {// Full, empty and clean up.
+        SpscQueue<Counted,4> queue;
+        assert( queue.Empty() && queue.Capacity() == 4 );
+        for( int n = 0 ; n < 4 ; n++ ){assert( queue.Emplace("item " + std::to_string(n)) );}
+        assert( queue.Emplace("one too many") == false );
+        assert( queue.Size() == 4 && Counted::sAlive == 4 );
+
+        Counted out;
+        assert( queue.TryPop(out) && out.mText == "item 0" );
+        assert( queue.Peek()->mText == "item 1" );
+        queue.Release();
+        assert( queue.Size() == 2 );
+
+        assert( queue.Reserve("reserved") != nullptr );
+        assert( queue.Reserve()->mText == "reserved" );// Same one again.
+        assert( queue.Size() == 2 );// Not seen yet.
+        queue.Commit();
+        assert( queue.Size() == 3 );
+        assert( queue.Reserve("not committed") );
+    }
+    assert( Counted::sAlive == 0 );
+
+    {// Move only type.
+        SpscQueue<std::unique_ptr<int>,2> queue;
+        assert( queue.TryPush(std::make_unique<int>(42)) );
+        std::unique_ptr<int> out;
+        assert( queue.TryPop(out) && *out == 42 );
+        assert( queue.TryPop(out) == false );
+    }
+
+    // One thread writes big frames in place with Reserve, the other reads them where they are with Peek.
+    const uint64_t COUNT = 2000000;
+    auto queue = std::make_unique<SpscQueue<Frame,64>>();
+    const auto start = std::chrono::steady_clock::now();
+
+    std::thread writer([&queue,COUNT]()
+    {
+        for( uint64_t n = 0 ; n < COUNT ; n++ )
+        {
+            Frame* frame;
+            while( (frame = queue->Reserve()) == nullptr ){std::this_thread::yield();}
+            frame->mSequence = n;
+            frame->mData[0] = uint8_t(n);
+            frame->mData[sizeof(frame->mData)-1] = uint8_t(n >> 8);
+            queue->Commit();
+        }
+    });
+
+    for( uint64_t n = 0 ; n < COUNT ; n++ )
+    {
+        const Frame* frame;
+        while( (frame = queue->Peek()) == nullptr ){std::this_thread::yield();}
+        assert( frame->mSequence == n );
+        assert( frame->mData[0] == uint8_t(n) && frame->mData[sizeof(frame->mData)-1] == uint8_t(n >> 8) );
+        queue->Release();
+    }
+    writer.join();
+    assert( queue->Empty() );
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << COUNT << " frames of " << sizeof(Frame) << " bytes in " << seconds << "s, " << uint64_t(COUNT / seconds) << " frames a second\n";
+
+    std::cout << "All good\n";
+    return EXIT_SUCCESS;
+}
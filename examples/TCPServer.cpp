@@ -0,0 +1,221 @@
+#!/usr/bin/seabang --debug
+
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <assert.h>
+
+#include "../TinyTools.h"
+#include "../TinyTools.cpp"
+
+using namespace tinytools::network;
+
+// A tiny metrics server and clients for it, all on one EventLoop.
+// Each request is a line, "memory" gets the memory usage back, "file" gets a file with sendfile, "big" gets a lot of data.
+int main(int argc, char *argv[])
+{
+    signal(SIGPIPE,SIG_IGN);
+    EventLoop loop;
+    const uint32_t loopback = MakeIP4V(127,0,0,1);
+
+    // A file to send.
+    char fileName[] = "/tmp/TCPServerXXXXXX";
+    const int file = mkstemp(fileName);
+    assert( file >= 0 );
+    unlink(fileName);
+    std::string fileContent;
+    for( int n = 0 ; n < 100000 ; n++ ){fileContent += char('a' + n % 26);}
+    assert( write(file,fileContent.data(),fileContent.size()) == (ssize_t)fileContent.size() );
+
+    const size_t bigSize = 8 * 1024 * 1024;
+    int serverConnections = 0;
+    int serverTooBig = 0;
+
+    TCPListener listener(loop,0,[&](TCPConnection::Ptr pConnection)
+    {
+        serverConnections++;
+        pConnection->SetMaxReceiveSize(64 * 1024);// No request line is this long.
+        pConnection->SetCloseCallback([&serverTooBig](TCPConnection& pConnection,int pError)
+        {
+            serverTooBig += pError == EMSGSIZE;
+        });
+        pConnection->SetDataCallback([&](TCPConnection& pConnection,const uint8_t* pData,size_t pSize)
+        {
+            const char* end = (const char*)memchr(pData,'\n',pSize);
+            if( end == nullptr )
+                return (size_t)0;// Wait for the rest of the line.
+
+            const std::string request((const char*)pData,end - (const char*)pData);
+            if( request == "memory" )
+            {
+                size_t used,available,total,swap;
+                tinytools::system::GetMemoryUsage(used,available,total,swap);
+                const std::string reply = "used " + std::to_string(used) + " total " + std::to_string(total) + "\n";
+                pConnection.Send(reply.data(),reply.size());
+            }
+            else if( request == "file" )
+            {
+                pConnection.Send("file ",5);
+                pConnection.SendFile(file,0,fileContent.size());
+                pConnection.Send("\n",1);
+            }
+            else if( request == "big" )
+            {
+                // Lots of small sends, these get batched into one write.
+                for( size_t n = 0 ; n < bigSize ; n += 1024 )
+                {
+                    std::vector<uint8_t> block(1024,(uint8_t)(n / 1024));
+                    pConnection.Send(std::move(block));
+                }
+                pConnection.Close();// After it has all gone.
+            }
+            return (end - (const char*)pData) + (size_t)1;
+        });
+    },loopback);
+
+    std::cout << "Listening on port " << listener.GetPort() << "\n";
+
+    // Client, asks for the memory and then the file on one connection.
+    std::string reply;
+    bool clientClosed = false;
+    TCPConnection::Connect(loop,loopback,listener.GetPort(),
+        [](TCPConnection& pConnection)
+        {
+            pConnection.Send("memory\nfile\n",12);
+        },
+        [&reply](TCPConnection& pConnection,const uint8_t* pData,size_t pSize)
+        {
+            reply.append((const char*)pData,pSize);
+            if( std::count(reply.begin(),reply.end(),'\n') == 2 )
+            {
+                pConnection.Close(false);
+            }
+            return pSize;
+        },
+        [&clientClosed](TCPConnection& pConnection,int pError)
+        {
+            assert( pError == 0 );
+            clientClosed = true;
+        });
+
+    // Second client, gets the big reply and the server closes it.
+    size_t bigReceived = 0;
+    bool bigOK = true;
+    TCPConnection::Connect(loop,loopback,listener.GetPort(),
+        [](TCPConnection& pConnection){pConnection.Send("big\n",4);},
+        [&](TCPConnection& pConnection,const uint8_t* pData,size_t pSize)
+        {
+            for( size_t n = 0 ; n < pSize ; n++ )
+            {
+                bigOK &= pData[n] == (uint8_t)((bigReceived + n) / 1024);
+            }
+            bigReceived += pSize;
+            return pSize;
+        },
+        [&](TCPConnection& pConnection,int pError){assert( pError == 0 );});
+
+    // Third client sends the request and then shuts down its sending side, the server must still send all of the reply.
+    std::atomic<size_t> halfClosedReceived{0};
+    std::atomic<bool> halfClosedDone{false};
+    std::thread halfClosed([&]()
+    {
+        const int s = socket(AF_INET,SOCK_STREAM,0);
+        const int small = 4096;// A small receive window so the server still has some queued when it sees our end close.
+        setsockopt(s,SOL_SOCKET,SO_RCVBUF,&small,sizeof(small));
+        sockaddr_in address;
+        memset(&address,0,sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = loopback;
+        address.sin_port = htons(listener.GetPort());
+        assert( connect(s,(sockaddr*)&address,sizeof(address)) == 0 );
+        assert( send(s,"big\n",4,0) == 4 );
+        assert( shutdown(s,SHUT_WR) == 0 );
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        std::vector<uint8_t> buffer(64 * 1024);
+        ssize_t got;
+        while( (got = recv(s,buffer.data(),buffer.size(),0)) > 0 )
+        {
+            halfClosedReceived += got;
+        }
+        close(s);
+        halfClosedDone = true;
+    });
+
+    // Fourth client never ends its line, the server gives up on it at the maximum receive size.
+    bool tooBigClosed = false;
+    TCPConnection::Connect(loop,loopback,listener.GetPort(),
+        [](TCPConnection& pConnection)
+        {
+            std::vector<uint8_t> noNewLine(100 * 1024,'x');
+            pConnection.Send(std::move(noNewLine));
+        },
+        [](TCPConnection& pConnection,const uint8_t* pData,size_t pSize){return pSize;},
+        [&tooBigClosed](TCPConnection& pConnection,int pError){tooBigClosed = true;});
+
+    // A connect that fails.
+    int refusedError = 0;
+    {
+        // Bind to get a free port then close it, so nothing is there.
+        const int s = socket(AF_INET,SOCK_STREAM,0);
+        sockaddr_in address;
+        memset(&address,0,sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = loopback;
+        socklen_t size = sizeof(address);
+        assert( bind(s,(sockaddr*)&address,sizeof(address)) == 0 && getsockname(s,(sockaddr*)&address,&size) == 0 );
+        close(s);
+        const uint16_t closedPort = ntohs(address.sin_port);
+        TCPConnection::Connect(loop,loopback,closedPort,
+            [](TCPConnection& pConnection){assert(false);},
+            nullptr,
+            [&refusedError](TCPConnection& pConnection,int pError){refusedError = pError;});
+    }
+
+    // UDP echo.
+    std::string udpReply;
+    UDPSocket udpServer(loop,0,[](UDPSocket& pSocket,uint32_t pFromIPv4,uint16_t pFromPort,const uint8_t* pData,size_t pSize)
+    {
+        pSocket.SendTo(pFromIPv4,pFromPort,pData,pSize);
+    },loopback);
+    UDPSocket udpClient(loop,0,[&udpReply](UDPSocket& pSocket,uint32_t pFromIPv4,uint16_t pFromPort,const uint8_t* pData,size_t pSize)
+    {
+        udpReply.assign((const char*)pData,pSize);
+    },loopback);
+    assert( udpClient.SendTo(loopback,udpServer.GetPort(),"ping",4) );
+
+    // Without pReusePort a second UDP socket can't take the same port.
+    bool sharedPort = true;
+    try
+    {
+        UDPSocket second(loop,udpServer.GetPort(),nullptr,loopback);
+    }
+    catch(const std::exception& e)
+    {
+        sharedPort = false;
+    }
+    assert( sharedPort == false );
+
+    // Run until everything is done, or give up after a while.
+    const auto start = std::chrono::steady_clock::now();
+    while( (clientClosed == false || bigReceived < bigSize || refusedError == 0 || udpReply.size() == 0 || halfClosedDone == false || tooBigClosed == false) &&
+            std::chrono::steady_clock::now() - start < std::chrono::seconds(10) )
+    {
+        loop.RunOnce(100);
+    }
+
+    std::cout << "Reply: " << reply.substr(0,reply.find('\n')) << "\n";
+    assert( reply.find("used ") == 0 );
+    assert( reply.substr(reply.find('\n') + 1) == "file " + fileContent + "\n" );
+    assert( bigReceived == bigSize && bigOK );
+    assert( refusedError == ECONNREFUSED );
+    assert( udpReply == "ping" );
+    assert( serverConnections == 4 );
+    halfClosed.join();
+    assert( halfClosedReceived == bigSize );
+    assert( serverTooBig == 1 );
+    std::cout << "Received " << bigReceived << " bytes, " << halfClosedReceived << " after a half close, refused with " << strerror(refusedError) << ", UDP " << udpReply << "\n";
+
+    close(file);
+    std::cout << "All good\n";
+    return EXIT_SUCCESS;
+}
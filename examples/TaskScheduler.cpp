@@ -0,0 +1,110 @@
+#!/usr/bin/seabang --debug
+
+#include <iostream>
+#include <thread>
+#include <assert.h>
+
+#include "../TinyTools.h"
+#include "../TinyTools.cpp"
+
+using namespace tinytools::threading;
+using namespace std::chrono_literals;
+
+int main(int argc, char *argv[])
+{
+    {// Fixed rate keeps to the beat even though the work takes a while, fixed delay does not.
+        TaskScheduler scheduler(2);
+        std::atomic<int> rateRuns{0},delayRuns{0};
+        const auto start = std::chrono::steady_clock::now();
+        std::chrono::steady_clock::time_point lastRateRun;
+        scheduler.Add(10ms,[&](){lastRateRun = std::chrono::steady_clock::now();rateRuns++;std::this_thread::sleep_for(4ms);},TaskScheduler::FIXED_RATE);
+        scheduler.Add(10ms,[&](){delayRuns++;std::this_thread::sleep_for(4ms);},TaskScheduler::FIXED_DELAY);
+        std::this_thread::sleep_for(205ms);
+        scheduler.TellThreadsToExitAndWait();
+
+        // Runs at 0,10..200 for fixed rate, 0,14..196 for fixed delay.
+        const auto drift = std::chrono::duration_cast<std::chrono::microseconds>(lastRateRun - start - (rateRuns - 1) * 10ms).count();
+        std::cout << "Fixed rate " << rateRuns << " runs, last one " << drift << "us off the beat. Fixed delay " << delayRuns << " runs\n";
+        assert( rateRuns >= 19 && rateRuns <= 21 );
+        assert( delayRuns >= 12 && delayRuns <= 15 );
+
+        // Nothing runs after it's been told to exit.
+        const int runs = rateRuns + delayRuns;
+        std::this_thread::sleep_for(30ms);
+        assert( rateRuns + delayRuns == runs );
+    }
+
+    {// Better than a millisecond.
+        TaskScheduler scheduler;
+        std::atomic<int> runs{0};
+        scheduler.Add(500us,[&runs](){runs++;});
+        std::this_thread::sleep_for(100ms);
+        scheduler.TellThreadsToExitAndWait();
+        std::cout << "500us interval ran " << runs << " times in 100ms\n";
+        assert( runs >= 150 && runs <= 201 );
+    }
+
+    {// Work that takes longer than the interval skips the beats it missed, it does not run back to back to catch up.
+        TaskScheduler scheduler;
+        std::vector<std::chrono::steady_clock::time_point> starts;
+        scheduler.Add(10ms,[&starts](){starts.push_back(std::chrono::steady_clock::now());std::this_thread::sleep_for(25ms);});
+        std::this_thread::sleep_for(100ms);
+        scheduler.TellThreadsToExitAndWait();
+        assert( starts.size() >= 3 && starts.size() <= 4 );
+        for( size_t n = 1 ; n < starts.size() ; n++ )
+        {
+            assert( starts[n] - starts[n-1] >= 25ms );
+        }
+    }
+
+    {// Cancel, from outside while it's running, and from inside.
+        TaskScheduler scheduler(2);
+        std::atomic<bool> inside{false};
+        std::atomic<int> slowRuns{0},selfRuns{0};
+        const auto slow = scheduler.Add(1ms,[&](){inside = true;std::this_thread::sleep_for(20ms);slowRuns++;inside = false;});
+        TaskScheduler::TaskID self = 0;
+        std::mutex selfMutex;
+        {
+            std::lock_guard<std::mutex> lock(selfMutex);
+            self = scheduler.Add(1ms,[&](){std::lock_guard<std::mutex> lock(selfMutex);if( ++selfRuns == 3 ){assert( scheduler.Cancel(self) );}});
+        }
+        assert( scheduler.GetNumTasks() == 2 );
+
+        while( inside == false ){std::this_thread::sleep_for(1ms);}
+        assert( scheduler.Cancel(slow) );
+        assert( inside == false );// Waited for it to finish.
+        assert( scheduler.Cancel(slow) == false );
+
+        std::this_thread::sleep_for(50ms);
+        const int runs = slowRuns;
+        assert( selfRuns == 3 && scheduler.GetNumTasks() == 0 );
+        std::this_thread::sleep_for(20ms);
+        assert( slowRuns == runs );
+    }
+
+    {// Lots of jobs on a couple of threads, with jitter to spread them out.
+        TaskScheduler scheduler(2);
+        std::vector<std::atomic<int>> runs(40);
+        for( auto& r : runs )
+        {
+            scheduler.Add(20ms,[&r](){r++;},TaskScheduler::FIXED_RATE,5ms);
+        }
+        std::this_thread::sleep_for(105ms);
+        scheduler.TellThreadsToExitAndWait();
+        for( auto& r : runs )
+        {
+            assert( r >= 4 && r <= 6 );
+        }
+    }
+
+    try
+    {
+        TaskScheduler scheduler;
+        scheduler.Add(0ms,[](){});
+        assert( false );
+    }
+    catch(const std::runtime_error& e){}
+
+    std::cout << "All good\n";
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,129 @@
+#!/usr/bin/seabang --debug
+
+#include <iostream>
+#include <thread>
+#include <numeric>
+#include <assert.h>
+
+#include "../TinyTools.h"
+#include "../TinyTools.cpp"
+
+using namespace tinytools::threading;
+
+// Submit passes the function its own copies of the arguments, so one wanting an int& is turned away by Submit's signature
+// and not by an error deep inside the pool.
+template<typename FUNC,typename = void> struct CanSubmitWithInt : std::false_type{};
+template<typename FUNC> struct CanSubmitWithInt<FUNC,std::void_t<decltype(std::declval<ThreadPool&>().Submit(std::declval<FUNC>(),1))>> : std::true_type{};
+static_assert( CanSubmitWithInt<int(*)(int)>::value && CanSubmitWithInt<int(*)(const int&)>::value && CanSubmitWithInt<int(*)(int&)>::value == false );
+
+int main(int argc, char *argv[])
+{
+    {// Results and exceptions come back through the future.
+        ThreadPool pool(4);
+        assert( pool.GetNumThreads() == 4 );
+
+        auto sum = pool.Submit([](int a,int b){return a + b;},2,3);
+        auto text = pool.Submit([](){return std::string("hello");});
+        auto fails = pool.Submit([](){throw std::runtime_error("oops");});
+        auto moved = pool.Submit([](std::unique_ptr<int> p){return *p * 2;},std::make_unique<int>(21));// Move only arguments are fine.
+        assert( sum.get() == 5 );
+        assert( text.get() == "hello" );
+        assert( moved.get() == 42 );
+        try
+        {
+            fails.get();
+            assert( false );
+        }
+        catch(const std::runtime_error& e)
+        {
+            assert( std::string(e.what()) == "oops" );
+        }
+
+        // Tasks can submit tasks, and wait on them, without locking up the pool.
+        auto outer = pool.Submit([&pool]()
+        {
+            std::vector<std::future<int>> inner;
+            for( int n = 0 ; n < 100 ; n++ )
+            {
+                inner.push_back(pool.Submit([n](){return n;}));
+            }
+            int total = 0;
+            for( auto& f : inner ){total += f.get();}
+            return total;
+        });
+        assert( outer.get() == 4950 );
+    }
+
+    {// ParallelFor covers every index once, from outside and from inside a task.
+        ThreadPool pool(0,true);
+        std::vector<uint32_t> hits(1000003,0);
+        pool.ParallelFor(0,hits.size(),[&hits](size_t pBegin,size_t pEnd)
+        {
+            for( size_t n = pBegin ; n < pEnd ; n++ ){hits[n]++;}
+        });
+        assert( std::all_of(hits.begin(),hits.end(),[](uint32_t h){return h == 1;}) );
+
+        auto nested = pool.Submit([&pool,&hits]()
+        {
+            pool.ParallelFor(10,hits.size(),[&hits](size_t pBegin,size_t pEnd)
+            {
+                for( size_t n = pBegin ; n < pEnd ; n++ ){hits[n]++;}
+            },1000);
+        });
+        nested.get();
+        assert( hits[9] == 1 && hits[10] == 2 && hits.back() == 2 );
+
+        std::atomic<int> calls{0};
+        try
+        {
+            pool.ParallelFor(0,100,[&calls](size_t pBegin,size_t pEnd)
+            {
+                calls++;
+                if( pBegin == 50 )
+                    throw std::runtime_error("chunk 50");
+            },10);
+            assert( false );
+        }
+        catch(const std::runtime_error& e)
+        {
+            assert( std::string(e.what()) == "chunk 50" );
+        }
+        assert( calls == 10 );// The others still ran.
+    }
+
+    {// One very slow job does not hold up the rest, the other workers steal them.
+        ThreadPool pool(4);
+        std::atomic<int> done{0};
+        const auto start = std::chrono::steady_clock::now();
+        std::vector<std::future<void>> jobs;
+        jobs.push_back(pool.Submit([](){std::this_thread::sleep_for(std::chrono::milliseconds(200));}));
+        for( int n = 0 ; n < 400 ; n++ )
+        {
+            jobs.push_back(pool.Submit([&done](){std::this_thread::sleep_for(std::chrono::microseconds(500));done++;}));
+        }
+        for( auto& j : jobs ){j.get();}
+        assert( done == 400 );
+        std::cout << "1 slow job and 400 quick ones on 4 threads took " << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << "s\n";
+    }
+
+    {// Shutdown runs everything that was queued first, then won't take any more.
+        ThreadPool pool(2);
+        std::atomic<int> done{0};
+        for( int n = 0 ; n < 1000 ; n++ )
+        {
+            pool.Submit([&done](){done++;});
+        }
+        pool.Shutdown();
+        assert( done == 1000 );
+
+        try
+        {
+            pool.Submit([](){});
+            assert( false );
+        }
+        catch(const std::runtime_error& e){}
+    }
+
+    std::cout << "All good\n";
+    return EXIT_SUCCESS;
+}
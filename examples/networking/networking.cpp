@@ -1,6 +1,7 @@
 
 #include <iostream>
 #include <array>
+#include <vector>
 
 #include "TinyTools.h"
 
@@ -55,19 +56,26 @@ int main(int argc, char *argv[])
     {
         std::cout << IPv4ToString(pIPv4) << " == " << pHostName << " ";
 
-        bool firstHit = true;
+        std::vector<PortProbe> probes;
         for( auto p : ports )
         {
-            if( IsPortOpen(pIPv4,p) )
+            probes.push_back({pIPv4,p});
+        }
+
+        bool firstHit = true;
+        ScanPorts(probes,1000,probes.size(),[&firstHit](const PortProbe& pProbe,bool pOpen)
+        {
+            if( pOpen )
             {
                 if( firstHit )
                 {
                     firstHit = false;
                     std::cout << "Port scan: ";
                 }
-                std::cout << p << " ";
+                std::cout << pProbe.mPort << " ";
             }
-        }
+            return true;
+        });
 
         if( firstHit )
         {